@@ -40,6 +40,9 @@ ARDrone::ARDrone(const char *ardrone_addr)
     // Sequence number
     seq = 0;
 
+    // Clock
+    clock = Clock::monotonic();
+
     // Camera image
     img = NULL;
 
@@ -48,29 +51,63 @@ ARDrone::ARDrone(const char *ardrone_addr)
 
     // Navdata
     memset(&navdata, 0, sizeof(navdata));
+    memset(navdataBuffer, 0, sizeof(navdataBuffer));
+    navdataVersion = 0;
+    navdataTime = 0.0;
+
+    // Navdata options (nobody subscribed yet)
+    memset(navdataSubscribers, 0, sizeof(navdataSubscribers));
+    navdataOptions = 0;
+    navdataSize = 0;
+    pthread_mutex_init(&mutexNavdataOptions, NULL);
 
     // Configurations
     memset(&config, 0, sizeof(config));
 
+    // Cache (disabled)
+    cacheDir[0] = '\0';
+    threadCache = NULL;
+
     // Video
-    pFormatCtx  = NULL;
+    skipVideo   = false;
+    rejectedVideoTime = false;
     pCodecCtx   = NULL;
     pFrame      = NULL;
-    pFrameBGR   = NULL;
     bufferBGR   = NULL;
-    pConvertCtx = NULL;
+    newImage    = false;
+    sequenceVideo = 0;
+    lowLatencyVideo = true;
+    memset(&statsVideo, 0, sizeof(statsVideo));
+
+    // Setpoint
+    setpointFlag = 0;
+    memset(setpoint, 0, sizeof(setpoint));
+    mutexSetpoint = NULL;
+    mutexConfig   = NULL;
+    commandPeriod = 1.0 / ARDRONE_COMMAND_RATE;
+
+    // Event loop (not started)
+    timerCommand  = -1;
+    timerNavdata  = -1;
+    readerNavdata = -1;
+    readerVideoSocket = -1;
+    timerPeriod   = 0.0;
+    eventCPU      = -1;
 
     // Thread for AT command
     threadCommand = NULL;
-    mutexCommand  = NULL;
 
     // Thread for Navdata
     threadNavdata = NULL;
-    mutexNavdata  = NULL;
 
     // Thread for Video
     threadVideo = NULL;
+    stopVideo   = false;
     mutexVideo  = NULL;
+    condVideo   = NULL;
+    mutexImage  = NULL;
+    waitingVideo = 0;
+    closingVideo = false;
 
     // Open if the IP address was specified
     if (ardrone_addr != NULL) {
@@ -86,6 +123,8 @@ ARDrone::~ARDrone()
 {
     // See you
     close();
+
+    pthread_mutex_destroy(&mutexNavdataOptions);
 }
 
 // --------------------------------------------------------------------------
@@ -105,27 +144,61 @@ int ARDrone::open(const char *ardrone_addr)
     // Save IP address
     strncpy(ip, ardrone_addr, 16);
 
-    // Get version information
-    if (!getVersionInfo()) return 0;
-    std::cout << "AR.Drone Ver. " << version.major << "." << version.minor << "." << version.revision << "." << std::endl;
+    // Measure the time of each phase
+    double start = clock->now(), t = start;
+    double tVersion, tCommand, tNavdata, tConfig, tConfigGet = 0.0;
+
+    // Get version information, from the cache if this AR.Drone was connected before
+    bool cached = loadCache();
+    if (!cached && !getVersionInfo()) return 0;
+    std::cout << "AR.Drone Ver. " << version.major << "." << version.minor << "." << version.revision << "." << (cached ? " (cached)" : "") << std::endl;
+    tVersion = clock->now() - t; t += tVersion;
+
+    // One thread for the sockets, otherwise a thread each
+    initEvents();
 
     // Initialize AT command
     if (!initCommand()) return 0;
+    tCommand = clock->now() - t; t += tCommand;
 
     // Blink LEDs
     setLED(ARDRONE_LED_ANIM_BLINK_GREEN);
 
     // Initialize Navdata
     if (!initNavdata()) return 0;
+    tNavdata = clock->now() - t; t += tNavdata;
 
-    // Initialize Video
-    if (!initVideo()) return 0;
+    // Set configurations
+    if (!initConfig()) return 0;
+    tConfig = clock->now() - t; t += tConfig;
 
-    // Wait for updating the status
-    //msleep(500);
+    // Initialize Video, it only depends on the video settings above,
+    // so the stream is probed while the configurations are received
+    InitTask video = {this, 0, 0.0};
+    pthread_t threadInitVideo;
+    bool parallel = (pthread_create(&threadInitVideo, NULL, runInitVideo, &video) == 0);
+    if (!parallel) runInitVideo(&video);
 
     // Get configurations
-    if (!getConfig()) return 0;
+    int result = 1;
+    if (!cached) {
+        result = getConfig();
+        if (result) saveCache();
+        tConfigGet = clock->now() - t;
+    }
+    // Check the cache in the background
+    else {
+        threadCache = new pthread_t;
+        if (pthread_create(threadCache, NULL, runCache, this) != 0) {
+            CVDRONE_ERROR("pthread_create() was failed. (%s, %d)\n", __FILE__, __LINE__);
+            delete threadCache;
+            threadCache = NULL;
+        }
+    }
+
+    // Wait for the video
+    if (parallel) pthread_join(threadInitVideo, NULL);
+    if (!result || !video.result) return 0;
 
     // Stop LED animation
     setLED(ARDRONE_LED_ANIM_STANDARD);
@@ -134,6 +207,12 @@ int ARDrone::open(const char *ardrone_addr)
     resetWatchDog();
     resetEmergency();
 
+    std::cout << "AR.Drone connected in " << clock->now() - start << " s"
+              << " (version " << tVersion << " s, command " << tCommand << " s, navdata " << tNavdata
+              << " s, settings " << tConfig << " s, video " << video.time << " s";
+    if (!cached) std::cout << " || configurations " << tConfigGet << " s";
+    std::cout << ")." << std::endl;
+
     return 1;
 }
 
@@ -154,12 +233,22 @@ int ARDrone::update(void)
 // --------------------------------------------------------------------------
 void ARDrone::close(void)
 {
+    // Wait for the check of the cache
+    if (threadCache) {
+        pthread_join(*threadCache, NULL);
+        delete threadCache;
+        threadCache = NULL;
+    }
+
     // Stop AR.Drone
     if (!onGround()) landing();
 
     // Stop LED animation
     setLED(ARDRONE_LED_ANIM_STANDARD);
 
+    // Stop the event loop, the remaining commands are sent below
+    finalizeEvents();
+
     // Finalize video
     finalizeVideo();
 
@@ -169,3 +258,87 @@ void ARDrone::close(void)
     // Finalize AT command
     finalizeCommand();
 }
+
+// --------------------------------------------------------------------------
+//! @brief   Set the clock used for timestamps and by the sleeping threads.
+//! @param   clock Pointer to the clock, NULL for the monotonic clock
+//! @note    Set it before open(), a virtual clock allows faster than real time runs.
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::setClock(Clock *clock)
+{
+    this->clock = clock ? clock : Clock::monotonic();
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Get the clock used for timestamps and by the sleeping threads.
+//! @return  Pointer to the clock
+// --------------------------------------------------------------------------
+Clock* ARDrone::getClock(void)
+{
+    return clock;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Set the CPU the thread serving the sockets runs on.
+//! @param   cpu Number of the CPU, -1 for any
+//! @note    It can be set before or after open().
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::setEventCPU(int cpu)
+{
+    eventCPU = cpu;
+    loopEvents.setCPU(cpu);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Enable or disable the low latency decoding of the AR.Drone 2.0 video.
+//! @param   enable Low delay flag and slice threads of the decoder if true,
+//!          the defaults of FFmpeg if false
+//! @note    Set it before open().
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::setLowLatencyVideo(bool enable)
+{
+    lowLatencyVideo = enable;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Start the thread serving the sockets of AT command, Navdata and video.
+//! @note    The timers of the loop are on the monotonic clock. With another
+//!          clock (or without epoll) every socket gets its own thread.
+//! @return  Result of initialization
+//! @retval  1 Success
+//! @retval  0 Failure (threads are used)
+// --------------------------------------------------------------------------
+int ARDrone::initEvents(void)
+{
+    // Only the monotonic clock can be waited for with timerfd
+    if (clock != Clock::monotonic()) return 0;
+    if (!loopEvents.open()) return 0;
+
+    // Sending AT commands and requesting Navdata again
+    timerCommand = loopEvents.addTimer(onCommandTimer, this);
+    timerNavdata = loopEvents.addTimer(onNavdataTimer, this);
+    loopEvents.setCPU(eventCPU);
+    if (timerCommand < 0 || timerNavdata < 0 || !loopEvents.start()) {
+        finalizeEvents();
+        return 0;
+    }
+
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Stop the thread serving the sockets.
+//! @note    It stops between two events, a handler is never interrupted.
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::finalizeEvents(void)
+{
+    loopEvents.close();
+    timerCommand  = -1;
+    timerNavdata  = -1;
+    readerNavdata = -1;
+    readerVideoSocket = -1;
+}
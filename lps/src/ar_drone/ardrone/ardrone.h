@@ -67,6 +67,18 @@ extern "C" {
 // POSIX threads
 #include <pthread.h>
 
+// Atomic operations
+#include <atomic>
+
+// Clock
+#include "clock.h"
+
+// AT command encoder
+#include "atencoder.h"
+
+// Navdata decoder
+#include "navdecoder.h"
+
 // Win32 <-> GCC
 #ifdef _WIN32
 #include <windows.h>
@@ -78,9 +90,11 @@ extern "C" {
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/ioctl.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <time.h>
 typedef int SOCKET;
 #define INVALID_SOCKET (-1)
 #define SOCKET_ERROR   (-1)
@@ -105,7 +119,22 @@ inline void msleep(unsigned long ms) {
 #define ARDRONE_PRINTF_PORT         (5558)
 #define ARDRONE_CONTROL_PORT        (5559)          // Port for configuration
 #define ARDRONE_DEFAULT_ADDR        "192.168.1.1"   // Default IP address of AR.Drone
-#define ARDRONE_NAVDATA_HEADER      (0x55667788)    // Header of Navdata
+#define ARDRONE_AT_QUEUE_SIZE       (64)            // Number of AT commands that can wait for the sender
+#define ARDRONE_AT_DATAGRAM_SIZE    (1024)          // Maximum size of an AT command datagram
+#define ARDRONE_COMMAND_RATE        (50.0)          // Default rate of the setpoint stream [Hz]
+#define ARDRONE_KEEPALIVE           (0.1)           // Interval of watchdog resets and repeated setpoints [s]
+#define ARDRONE_CONFIG_TIMEOUT      (0.25)          // Time to wait for the acknowledgement of a configuration [s]
+#define ARDRONE_CONFIG_RETRIES      (3)             // Number of attempts to send a configuration
+#define ARDRONE_NAVDATA_TIMEOUT     (0.1)           // Time without Navdata until it is requested again [s]
+#define ARDRONE_NAVDATA_HISTORY     (256)           // Number of Navdata samples kept (1.28 s at 200 Hz)
+#define ARDRONE_NAVDATA_BATCH       (8)             // Most Navdata packets received at once
+#define ARDRONE_CLOCK_WINDOW        (1.0)           // Period the packet with the least delay is taken from [s]
+#define ARDRONE_CLOCK_WINDOWS       (30)            // Number of periods the clock skew is fitted over
+#define ARDRONE_EVENT_SOURCES       (8)             // Most sockets and timers of the event loop
+#define ARDRONE_VIDEO_BUFFERS       (4)             // Frames of the PaVE reader, a frame stays valid for 3 more reads
+#define ARDRONE_VIDEO_TIMEOUT       (2.0)           // Time to wait for the first frame of the video [s]
+#define ARDRONE_VIDEO_MAX_DELAY     (0.25)          // Age of a frame the decoder skips ahead to the next I-frame at [s]
+#define ARDRONE_VIDEO_MAX_QUEUED    (65536)         // Bytes waiting in the socket the decoder skips ahead at
 
 // Math definitions
 #ifndef NULL
@@ -204,41 +233,6 @@ enum ARDRONE_STATE_MASK {
     ARDRONE_EMERGENCY_MASK      = 1U << 31  // Emergency landing         : (0) No emergency, (1) Emergency
 };
 
-// Navdata tags
-enum ARDRONE_NAVDATA_TAG {
-    ARDRONE_NAVDATA_DEMO_TAG            =  0,
-    ARDRONE_NAVDATA_TIME_TAG            =  1,
-    ARDRONE_NAVDATA_RAW_MEASURES_TAG    =  2,
-    ARDRONE_NAVDATA_PHYS_MEASURES_TAG   =  3,
-    ARDRONE_NAVDATA_GYROS_OFFSETS_TAG   =  4,
-    ARDRONE_NAVDATA_EULER_ANGLES_TAG    =  5,
-    ARDRONE_NAVDATA_REFERENCES_TAG      =  6,
-    ARDRONE_NAVDATA_TRIMS_TAG           =  7,
-    ARDRONE_NAVDATA_RC_REFERENCES_TAG   =  8,
-    ARDRONE_NAVDATA_PWM_TAG             =  9,
-    ARDRONE_NAVDATA_ALTITUDE_TAG        = 10,
-    ARDRONE_NAVDATA_VISION_RAW_TAG      = 11,
-    ARDRONE_NAVDATA_VISION_OF_TAG       = 12,
-    ARDRONE_NAVDATA_VISION_TAG          = 13,
-    ARDRONE_NAVDATA_VISION_PERF_TAG     = 14,
-    ARDRONE_NAVDATA_TRACKERS_SEND_TAG   = 15,
-    ARDRONE_NAVDATA_VISION_DETECT_TAG   = 16,
-    ARDRONE_NAVDATA_WATCHDOG_TAG        = 17,
-    ARDRONE_NAVDATA_IPHONE_ANGLES_TAG   = 18,
-    ARDRONE_NAVDATA_ADC_DATA_FRAME_TAG  = 18,
-    ARDRONE_NAVDATA_VIDEO_STREAM_TAG    = 19,
-    ARDRONE_NAVDATA_GAME_TAG            = 20,       // AR.Drone 1.7.4
-    ARDRONE_NAVDATA_PRESSURE_RAW_TAG    = 21,       // AR.Drone 2.0
-    ARDRONE_NAVDATA_MAGNETO_TAG         = 22,       // AR.Drone 2.0
-    ARDRONE_NAVDATA_WIND_TAG            = 23,       // AR.Drone 2.0
-    ARDRONE_NAVDATA_KALMAN_PRESSURE_TAG = 24,       // AR.Drone 2.0
-    ARDRONE_NAVDATA_HDVIDEO_STREAM_TAG  = 25,       // AR.Drone 2.0
-    ARDRONE_NAVDATA_WIFI_TAG            = 26,       // AR.Drone 2.0
-    ARDRONE_NAVDATA_ZIMMU3000_TAG       = 27,       // AR.Drone 2.0
-    ARDRONE_NAVDATA_GPS_TAG             = 27,       // AR.Drone 2.4.1
-    ARDRONE_NAVDATA_CKS_TAG             = 0xFFFF
-};
-
 // Flight animation IDs
 enum ARDRONE_ANIMATION_ID {
     ARDRONE_ANIM_PHI_M30_DEG             =  0,
@@ -299,12 +293,143 @@ public:
     int  send2(void *data, size_t size);    // Send data
     int  sendf(const char *str, ...);       // Send with format
     int  receive(void *data, size_t size);  // Receive data
+    int  receiveSome(void *data, size_t size); // Receive what is there (-1 if closed)
+    int  available(void);                   // Number of bytes waiting
+    int  setNonBlocking(bool enable);       // Return from receive at once if nothing is there
+    SOCKET getSocket(void) const;           // Descriptor for an event loop
     void close(void);                       // Finalize
 private:
     SOCKET sock;                            // Socket
     sockaddr_in server_addr, client_addr;   // Server/Client IP adrress
 };
 
+// Frame types of PaVE
+enum ARDRONE_FRAME_TYPE {
+    ARDRONE_FRAME_UNKNOWN = 0,
+    ARDRONE_FRAME_IDR     = 1,              // Instantaneous decoder refresh
+    ARDRONE_FRAME_I       = 2,
+    ARDRONE_FRAME_P       = 3,
+    ARDRONE_FRAME_HEADERS = 4               // SPS and PPS only
+};
+
+// PaVE header (Parrot Video Encapsulation) in front of every frame of the AR.Drone 2.0
+#pragma pack(push, 1)
+struct ARDRONE_PAVE_HEADER {
+    uint8_t  signature[4];                  // "PaVE"
+    uint8_t  version;
+    uint8_t  video_codec;                   // 4: H.264
+    uint16_t header_size;                   // Size of this header [bytes]
+    uint32_t payload_size;                  // Size of the frame [bytes]
+    uint16_t encoded_stream_width;          // Size of the H.264 stream (e.g. 640x368)
+    uint16_t encoded_stream_height;
+    uint16_t display_width;                 // Size of the image (e.g. 640x360)
+    uint16_t display_height;
+    uint32_t frame_number;
+    uint32_t timestamp;                     // Time of the AR.Drone [ms]
+    uint8_t  total_chunks;
+    uint8_t  chunk_index;
+    uint8_t  frame_type;                    // ARDRONE_FRAME_TYPE
+    uint8_t  control;
+    uint32_t stream_byte_position_lw;
+    uint32_t stream_byte_position_uw;
+    uint16_t stream_id;
+    uint8_t  total_slices;
+    uint8_t  slice_index;
+    uint8_t  header1_size;
+    uint8_t  header2_size;
+    uint8_t  reserved2[2];
+    uint32_t advertised_size;
+    uint8_t  reserved3[12];
+};
+#pragma pack(pop)
+
+// Frame read by the PaVE reader
+struct ARDRONE_VIDEO_PACKET {
+    uint8_t      *data;                     // H.264 frame, padded for the decoder
+    int          size;                      // Size of the frame [bytes]
+    int          capacity;                  // Size of the buffer [bytes]
+    unsigned int number;                    // Frame number
+    int          type;                      // ARDRONE_FRAME_TYPE
+    int          width, height;             // Size of the image [px]
+    double       drone;                     // Time of the AR.Drone [s], since it booted until put on the clock of Navdata
+    double       received;                  // Time the last byte was received [s] (clock of ARDrone)
+    double       time;                      // Time it was captured [s] (clock of ARDrone), set by the user
+};
+
+// PaVE reader class (the AR.Drone 2.0 video stream, one frame at a time into pooled buffers)
+class PaVEReader {
+public:
+    PaVEReader();                                                       // Constructor
+    virtual ~PaVEReader();                                              // Destructor
+    int  open(const char *addr, int port, Clock *clock);                // Connect and wait for the first frame
+    int  read(ARDRONE_VIDEO_PACKET **packet);                           // Next whole frame (0 if not yet, -1 if closed)
+    int  queued(void);                                                  // Bytes waiting in the socket
+    int  setNonBlocking(bool enable);                                   // read() returns 0 at once if nothing is there
+    SOCKET getSocket(void) const;                                       // Descriptor for an event loop
+    int  width(void) const;                                             // Size of the image of the first frame [px]
+    int  height(void) const;
+    void close(void);                                                   // Finalize
+private:
+    TCPSocket sock;
+    Clock  *clock;
+    ARDRONE_VIDEO_PACKET pool[ARDRONE_VIDEO_BUFFERS];
+    int    next;                            // Buffer of the frame being read
+    ARDRONE_PAVE_HEADER header;
+    int    headerFilled;                    // Bytes of the header read
+    int    headerSkip;                      // Bytes of a longer header still to skip
+    int    payloadFilled;                   // Bytes of the frame read
+    ARDRONE_VIDEO_PACKET *first;            // Frame open() waited for, not returned yet
+    int    imageWidth, imageHeight;         // Size of the images of the first frame
+};
+
+// Handler of an event
+typedef void (*EventHandler)(void *args);
+
+// Event loop class (one thread serves the sockets and timers, Linux only)
+class EventLoop {
+public:
+    EventLoop();                                                        // Constructor
+    virtual ~EventLoop();                                               // Destructor
+    int  open(void);                                                    // Initialize
+    int  addReader(SOCKET sock, EventHandler handler, void *args);      // Call the handler when the socket can be read
+    int  remove(int index);                                             // Stop watching a socket (waits for its handler)
+    int  addTimer(EventHandler handler, void *args);                    // Create a timer, returns its number (-1 on failure)
+    int  setTimer(int timer, double time, double period);               // Arm a timer at a time of the monotonic clock
+    int  start(void);                                                   // Run the loop in a thread
+    int  setCPU(int cpu);                                               // Pin the thread to a CPU (-1 for any)
+    bool running(void) const;                                           // Check whether the thread runs
+    void stop(void);                                                    // Stop the thread between two events
+    void close(void);                                                   // Finalize
+private:
+    struct Source {
+        int fd;                             // Socket, timer or -1 (free)
+        bool timer;                         // Expirations have to be read
+        EventHandler handler;
+        void *args;
+    };
+    Source sources[ARDRONE_EVENT_SOURCES];  // Sockets and timers
+    int numSources;
+    pthread_mutex_t mutexSources;           // Held while the handlers run (recursive)
+    int epoll, wakeup;                      // Descriptors of epoll and of the eventfd that stops the loop
+    std::atomic<bool> quit;
+    pthread_t *thread;
+    int cpu;                                // CPU the thread is pinned to (-1 for any)
+    int  add(int fd, bool timer, EventHandler handler, void *args);     // Watch a descriptor
+    void loop(void);                                                    // Thread function
+    static void *run(void *args) {
+        reinterpret_cast<EventLoop*>(args)->loop();
+        return NULL;
+    }
+};
+
+// Datagram of a batch
+struct UDPMessage {
+    void   *data;                           // Buffer
+    size_t size;                            // Size of the buffer
+    int    length;                          // Number of received bytes
+    double time;                            // Time the kernel received it (CLOCK_MONOTONIC) [s], negative if unknown
+};
+
 // UDP Class
 class UDPSocket {
 public:
@@ -314,520 +439,98 @@ public:
     int  send2(void *data, size_t size);    // Send data
     int  sendf(const char *str, ...);       // Send with format
     int  receive(void *data, size_t size);  // Receive data
+    int  receive(UDPMessage *messages, int count); // Receive the waiting datagrams with their times
+    int  setTimeout(double timeout);        // Set the timeout of receive
+    int  setNonBlocking(bool enable);       // Return from receive at once if nothing is there
+    int  enableTimestamps(void);            // Let the kernel stamp the received datagrams
+    SOCKET getSocket(void) const;           // Descriptor for an event loop
     void close(void);                       // Finalize
 private:
     SOCKET sock;                            // Socket
     sockaddr_in server_addr, client_addr;   // Server/Client IP adrress
 };
 
-// Navdata
-#pragma pack(push, 1)
-struct ARDRONE_NAVDATA {
-    // 3x3 matrix
-    struct matrix33_t { 
-        float m11, m12, m13;
-        float m21, m22, m23;
-        float m31, m32, m33;
-    };
-
-    // 3x1 vector
-    union vector31_t {
-        float v[3];
-        struct {
-            float x;
-            float y;
-            float z;
-        };
+// AT command queue class (many producers, one sender)
+class ATCommandQueue {
+public:
+    ATCommandQueue();                                                   // Constructor
+    virtual ~ATCommandQueue();                                          // Destructor
+    int    push(const char *name, const char *args, ...);               // Enqueue a command
+    int    pushPCMD(int flag, float roll, float pitch, float gaz, float yaw); // Enqueue a progressive command
+    int    pushREF(int bits);                                           // Enqueue take off / landing / emergency
+    int    pushCOMWDG(void);                                            // Enqueue a watchdog reset
+    int    pushConfig(const char *key, const char *value, bool ids);    // Enqueue a configuration
+    size_t pack(char *datagram, size_t size, std::atomic<unsigned int> *seq); // Dequeue commands into a datagram
+private:
+    struct Entry {
+        std::atomic<size_t> turn;           // Position the slot is free (== pos) or written (== pos + 1) for
+        ATCommand command;                  // Command without sequence number
     };
+    Entry entries[ARDRONE_AT_QUEUE_SIZE];   // Ring buffer
+    std::atomic<size_t> head;               // Next position to write
+    size_t tail;                            // Next position to send (only used by the sender)
+    size_t reserve(int count);              // Reserve consecutive slots
+    ATCommand* slot(size_t pos);            // Command of a reserved slot
+    void   commit(size_t pos, int count);   // Hand written slots to the sender
+};
 
-    // 2x1 vector
-    union vector21_t {
-        float v[2];
-        struct {
-            float x;
-            float y;
-        };
-    };
+// Navdata sample of the history, in the units of the getters
+struct ARDRONE_NAVDATA_SAMPLE {
+    double       time;              // Time it was measured [s] (clock of ARDrone)
+    double       received;          // Time it was received [s] (clock of ARDrone)
+    unsigned int sequence;          // Sequence number of the packet
+    unsigned int state;             // ARDRONE_STATE_MASK bits
+    double       roll, pitch, yaw;  // Attitude [rad]
+    double       altitude;          // Altitude [m]
+    double       vx, vy, vz;        // Velocity [m/s]
+};
 
-    // Velocities
-    struct velocities_t {
-        float x;
-        float y;
-        float z;
+// Navdata history class (one writer, readers never block it)
+class NavdataHistory {
+public:
+    NavdataHistory();                                                   // Constructor
+    virtual ~NavdataHistory();                                          // Destructor
+    void push(const ARDRONE_NAVDATA_SAMPLE &sample);                    // Append a sample (only the Navdata thread)
+    int  at(double time, ARDRONE_NAVDATA_SAMPLE *sample) const;         // Interpolate the sample at a time
+    int  window(double from, double to, ARDRONE_NAVDATA_SAMPLE *samples, int max) const; // Samples of a period
+    void clear(void);                                                   // Forget all samples
+private:
+    struct Slot {
+        std::atomic<unsigned int> version;  // Odd while the slot is written
+        size_t index;                       // Number of the sample in the slot
+        ARDRONE_NAVDATA_SAMPLE sample;
     };
+    Slot slots[ARDRONE_NAVDATA_HISTORY];    // Ring buffer
+    std::atomic<size_t> count;              // Number of samples pushed
+    int  read(size_t index, ARDRONE_NAVDATA_SAMPLE *sample) const;      // Copy a sample that was not overwritten
+};
 
-    // Screen point
-    struct screen_point_t {
-        int x;
-        int y;
+// Synchronisation of the clock of the AR.Drone (one writer, readers never block it)
+class DroneClockSync {
+public:
+    DroneClockSync();                                                   // Constructor
+    virtual ~DroneClockSync();                                          // Destructor
+    double update(unsigned int stamp, double local);                    // Add a NAVDATA_TIME stamp and the time it was received
+    int    map(double drone, double *local) const;                      // Time of the AR.Drone to local time
+    double unwrap(double uptime) const;                                 // Time since the AR.Drone booted to the time of update()
+    void   clear(void);                                                 // Forget everything (the AR.Drone restarted)
+private:
+    struct Point {
+        double drone;                       // Time of the AR.Drone [s]
+        double offset;                      // Local time - time of the AR.Drone [s]
     };
-
-    // Header
-    unsigned int header;
-    unsigned int ardrone_state;
-    unsigned int sequence;
-    unsigned int vision_defined;
-
-    // Demo
-    struct NAVDATA_DEMO {
-        unsigned short tag;
-        unsigned short size;
-        unsigned int   ctrl_state;
-        unsigned int   vbat_flying_percentage;
-        float          theta;
-        float          phi;
-        float          psi;
-        int            altitude;
-        float          vx;
-        float          vy;
-        float          vz;
-        unsigned int   num_frames;                // Don't use
-        matrix33_t     detection_camera_rot;      // Don't use
-        vector31_t     detection_camera_trans;    // Don't use
-        unsigned int   detection_tag_index;       // Don't use
-        unsigned int   detection_camera_type;     // Don't use
-        matrix33_t     drone_camera_rot;          // Don't use
-        vector31_t     drone_camera_trans;        // Don't use
-    } demo;
-
-    // Timestamp
-    struct NAVDATA_TIME {
-        unsigned short tag;
-        unsigned short size;
-        unsigned int   time;
-    } time;
-
-    // Raw measurements
-    struct NAVDATA_RAW_MEASURES {
-        unsigned short tag;
-        unsigned short size;
-        unsigned short raw_accs[3];         // filtered accelerometers
-        short          raw_gyros[3];        // filtered gyrometers
-        short          raw_gyros_110[2];    // gyrometers  x/y 110 deg/s
-        unsigned int   vbat_raw;            // battery voltage raw (mV)
-        unsigned short us_debut_echo;
-        unsigned short us_fin_echo;
-        unsigned short us_association_echo;
-        unsigned short us_distance_echo;
-        unsigned short us_courbe_temps;
-        unsigned short us_courbe_valeur;
-        unsigned short us_courbe_ref;
-        unsigned short flag_echo_ini;
-        //unsigned short frame_number;
-        unsigned short nb_echo;
-        unsigned int   sum_echo;
-        int            alt_temp_raw;
-        short          gradient;
-    } raw_measures;
-
-    // Physical measurements
-    struct NAVDATA_PHYS_MEASURES {
-        unsigned short tag;
-        unsigned short size;
-        float          accs_temp;
-        unsigned short gyro_temp;
-        float          phys_accs[3];
-        float          phys_gyros[3];
-        unsigned int   alim3V3;         // 3.3 volt alim       [LSB]
-        unsigned int   vrefEpson;       // ref volt Epson gyro [LSB]
-        unsigned int   vrefIDG;         // ref volt IDG gyro   [LSB]
-    } phys_measures;
-
-    // Gyros offsets
-    struct NAVDATA_GYROS_OFFSETS {
-        unsigned short tag;
-        unsigned short size;
-        float          offset_g[3];
-    } gyros_offsets;
-
-    // Euler angles
-    struct NAVDATA_EULER_ANGLES {
-        unsigned short tag;
-        unsigned short size;
-        float          theta_a;
-        float          phi_a;
-    } euler_angles;
-
-    // References
-    struct NAVDATA_REFERENCES {
-        unsigned short tag;
-        unsigned short size;
-        int            ref_theta;
-        int            ref_phi;
-        int            ref_theta_I;
-        int            ref_phi_I;
-        int            ref_pitch;
-        int            ref_roll;
-        int            ref_yaw;
-        int            ref_psi;
-        float          vx_ref;
-        float          vy_ref;
-        float          theta_mod;
-        float          phi_mod;
-        float          k_v_x;
-        float          k_v_y;
-        unsigned int   k_mode;
-        float          ui_time;
-        float          ui_theta;
-        float          ui_phi;
-        float          ui_psi;
-        float          ui_psi_accuracy;
-        int            ui_seq;
-    } references;
-
-    // Trims
-    struct NAVDATA_TRIMS {
-        unsigned short tag;
-        unsigned short size;
-        float          angular_rates_trim_r;
-        float          euler_angles_trim_theta;
-        float          euler_angles_trim_phi;
-    } trims;
-
-    // RC references
-    struct NAVDATA_RC_REFERENCES {
-        unsigned short tag;
-        unsigned short size;
-        int            rc_ref_pitch;
-        int            rc_ref_roll;
-        int            rc_ref_yaw;
-        int            rc_ref_gaz;
-        int            rc_ref_ag;
-    } rc_references;
-
-    // PWM
-    struct NAVDATA_PWM {
-        unsigned short tag;
-        unsigned short size;
-        unsigned char  motor1;
-        unsigned char  motor2;
-        unsigned char  motor3;
-        unsigned char  motor4;
-        unsigned char  sat_motor1;
-        unsigned char  sat_motor2;
-        unsigned char  sat_motor3;
-        unsigned char  sat_motor4;
-        float          gaz_feed_forward;
-        float          gaz_altitude;
-        float          altitude_integral;
-        float          vz_ref;
-        int            u_pitch;
-        int            u_roll;
-        int            u_yaw;
-        float          yaw_u_I;
-        int            u_pitch_planif;
-        int            u_roll_planif;
-        int            u_yaw_planif;
-        float          u_gaz_planif;
-        unsigned short current_motor1;
-        unsigned short current_motor2;
-        unsigned short current_motor3;
-        unsigned short current_motor4;
-        float          altitude_prop;
-        float          altitude_der;
-    } pwm;
-
-    // Altitude
-    struct NAVDATA_ALTITUDE {
-        unsigned short tag;
-        unsigned short size;
-        int            altitude_vision;
-        float          altitude_vz;
-        int            altitude_ref;
-        int            altitude_raw;
-        float          obs_accZ;
-        float          obs_alt;
-        vector31_t     obs_x;
-        unsigned int   obs_state;
-        vector21_t     est_vb;
-        unsigned int   est_state;
-    } altitude;
-
-    // Vision (raw)
-    struct NAVDATA_VISION_RAW {
-        unsigned short tag;
-        unsigned short size;
-        float          vision_tx_raw;
-        float          vision_ty_raw;
-        float          vision_tz_raw;
-    } vision_raw;
-
-    // Vision (offset?)
-    struct NAVDATA_VISION_OF {
-        unsigned short tag;
-        unsigned short size;
-        float          of_dx[5];
-        float          of_dy[5];
-    } vision_of;
-
-    // Vision
-    struct NAVDATA_VISION {
-        unsigned short tag;
-        unsigned short size;
-        unsigned int   vision_state;
-        int            vision_misc;
-        float          vision_phi_trim;
-        float          vision_phi_ref_prop;
-        float          vision_theta_trim;
-        float          vision_theta_ref_prop;
-        int            new_raw_picture;
-        float          theta_capture;
-        float          phi_capture;
-        float          psi_capture;
-        int            altitude_capture;
-        unsigned int   time_capture;    // time in TSECDEC format (see config.h)
-        velocities_t   body_v;
-        float          delta_phi;
-        float          delta_theta;
-        float          delta_psi;
-        unsigned int   gold_defined;
-        unsigned int   gold_reset;
-        float          gold_x;
-        float          gold_y;
-    } vision;
-
-    // Vision performances
-    struct NAVDATA_VISION_PERF {
-        unsigned short tag;
-        unsigned short size;
-        float          time_szo;
-        float          time_corners;
-        float          time_compute;
-        float          time_tracking;
-        float          time_trans;
-        float          time_update;
-        float          time_custom[20];
-    } vision_perf;
-
-    // Trackers
-    struct NAVDATA_TRACKERS_SEND {
-        unsigned short tag;
-        unsigned short size;
-        int            locked[30];
-        screen_point_t point[30];
-    } trackers_send;
-
-    // Vision detection
-    struct NAVDATA_VISION_DETECT {
-        unsigned short tag;
-        unsigned short size;
-        unsigned int   nb_detected;
-        unsigned int   type[4];
-        unsigned int   xc[4];
-        unsigned int   yc[4];
-        unsigned int   width[4];
-        unsigned int   height[4];
-        unsigned int   dist[4];
-        float          orientation_angle[4];
-        matrix33_t     rotation[4];
-        vector31_t     translation[4];
-        unsigned int   camera_source[4];
-    } vision_detect;
-
-    // Watchdog
-    struct NAVDATA_WATCHDOG {
-        unsigned short tag;
-        unsigned short size;
-        int            watchdog;
-    } watchdog;
-
-    // ADC data
-    struct NAVDATA_ADC_DATA_FRAME {
-        unsigned short tag;
-        unsigned short size;
-        unsigned int   version;
-        unsigned char  data_frame[32];
-    } adc_data_frame;
-
-    // Video stream
-    struct NAVDATA_VIDEO_STREAM {
-        unsigned short tag;
-        unsigned short size;
-        unsigned char  quant;               // quantizer reference used to encode frame [1:31]
-        unsigned int   frame_size;          // frame size (bytes)
-        unsigned int   frame_number;        // frame index
-        unsigned int   atcmd_ref_seq;       // atmcd ref sequence number
-        unsigned int   atcmd_mean_ref_gap;  // mean time between two consecutive atcmd_ref (ms)
-        float          atcmd_var_ref_gap;
-        unsigned int   atcmd_ref_quality;   // estimator of atcmd link quality
-
-        // drone2
-        unsigned int   out_bitrate;         // measured out throughput from the video tcp socket
-        unsigned int   desired_bitrate;     // last frame size generated by the video encoder
-        int            data1;
-        int            data2;
-        int            data3;
-        int            data4;
-        int            data5;
-        unsigned int   tcp_queue_level;
-        unsigned int   fifo_queue_level;
-    } video_stream;
-
-    // Games
-    struct NAVDATA_GAMES {
-        unsigned short tag;
-        unsigned short size;
-        unsigned int   double_tap_counter;
-        unsigned int   finish_line_counter;
-    } games;
-
-    // Preassure (raw)
-    struct NAVDATA_PRESSURE_RAW {
-        unsigned short tag;
-        unsigned short size;
-        unsigned int   up;
-        unsigned short ut;
-        unsigned int   temperature_meas;
-        unsigned int   pression_meas;
-    } pressure_raw;
-
-    // Magneto
-    struct NAVDATA_MAGNETO {
-        unsigned short tag;
-        unsigned short size;
-        short          mx;
-        short          my;
-        short          mz;
-        vector31_t     magneto_raw;             // magneto in the body frame, in mG
-        vector31_t     magneto_rectified;
-        vector31_t     magneto_offset;
-        float          heading_unwrapped;
-        float          heading_gyro_unwrapped;
-        float          heading_fusion_unwrapped;
-        char           magneto_calibration_ok;
-        unsigned int   magneto_state;
-        float          magneto_radius;
-        float          error_mean;
-        float          error_var;
-        float          tmp1, tmp2;              // dummy ?
-    } magneto;
-
-    // Wind
-    struct NAVDATA_WIND {
-        unsigned short tag;
-        unsigned short size;
-        float          wind_speed;              // estimated wind speed [m/s]
-        float          wind_angle;              // estimated wind direction in North-East frame [rad] e.g. if wind_angle is pi/4, wind is from South-West to North-East
-        float          wind_compensation_theta;
-        float          wind_compensation_phi;
-        float          state_x1;
-        float          state_x2;
-        float          state_x3;
-        float          state_x4;
-        float          state_x5;
-        float          state_x6;
-        float          magneto_debug1;
-        float          magneto_debug2;
-        float          magneto_debug3;
-    } wind;
-
-    // Kalman filter
-    struct NAVDATA_KALMAN_PRESSURE {
-        unsigned short tag;
-        unsigned short size;
-        float          offset_pressure;
-        float          est_z;
-        float          est_zdot;
-        float          est_bias_PWM;
-        float          est_biais_pression;
-        float          offset_US;
-        float          prediction_US;
-        float          cov_alt;
-        float          cov_PWM;
-        float          cov_vitesse;
-        bool           bool_effet_sol;
-        float          somme_inno;
-        bool           flag_rejet_US;
-        float          u_multisinus;
-        float          gaz_altitude;
-        bool           flag_multisinus;
-        bool           flag_multisinus_debut;
-    } kalman_pressure;
-
-    // HD video stream
-    struct NAVDATA_HDVIDEO_STREAM {
-        unsigned short tag;
-        unsigned short size;
-        unsigned int   hdvideo_state;
-        unsigned int   storage_fifo_nb_packets;
-        unsigned int   storage_fifo_size;
-        unsigned int   usbkey_size;           // USB key in kbytes - 0 if no key present
-        unsigned int   usbkey_freespace;      // USB key free space in kbytes - 0 if no key present
-        unsigned int   frame_number;          // 'frame_number' PaVE field of the frame starting to be encoded for the HD stream
-        unsigned int   usbkey_remaining_time; // time in seconds
-    } hdvideo_stream;
-
-    // WiFi
-    struct NAVDATA_WIFI {
-        unsigned short tag;
-        unsigned short size;
-        unsigned int   link_quality;
-    } wifi;
-
-    // Zimmu 3000
-    struct NAVDATA_ZIMMU_3000 {
-        unsigned short tag;
-        unsigned short size;
-        int            vzimmuLSB;
-        float          vzfind;
-    } zimmu_3000;
-
-    // GPS (for AR.Drone 2.4.1, or later)
-    // From https://github.com/paparazzi/paparazzi/blob/master/sw/airborne/boards/ardrone/at_com.h
-    struct NAVDATA_GPS {
-        unsigned short tag;                  /*!< Navdata block ('option') identifier */
-        unsigned short size;                 /*!< set this to the size of this structure */
-        double         lat;                  /*!< Latitude */
-        double         lon;                  /*!< Longitude */
-        double         elevation;            /*!< Elevation */
-        double         hdop;                 /*!< hdop */
-        int            data_available;       /*!< When there is data available */
-        unsigned char  unk_0[8];
-        double         lat0;                 /*!< Latitude ??? */
-        double         lon0;                 /*!< Longitude ??? */
-        double         lat_fuse;             /*!< Latitude fused */
-        double         lon_fuse;             /*!< Longitude fused */
-        unsigned int   gps_state;            /*!< State of the GPS, still need to figure out */
-        unsigned char  unk_1[40];
-        double         vdop;                 /*!< vdop */
-        double         pdop;                 /*!< pdop */
-        float          speed;                /*!< speed */
-        unsigned int   last_frame_timestamp; /*!< Timestamp from the last frame */
-        float          degree;               /*!< Degree */
-        float          degree_mag;           /*!< Degree of the magnetic */
-        unsigned char  unk_2[16];
-        struct {
-            unsigned char sat;
-            unsigned char cn0;
-        } channels[12];
-        int             gps_plugged;         /*!< When the gps is plugged */
-        unsigned char   unk_3[108];
-        double          gps_time;            /*!< The gps time of week */
-        unsigned short  week;                /*!< The gps week */
-        unsigned char   gps_fix;             /*!< The gps fix */
-        unsigned char   num_sattelites;      /*!< Number of sattelites */
-        unsigned char   unk_4[24];
-        double          ned_vel_c0;          /*!< NED velocity */
-        double          ned_vel_c1;          /*!< NED velocity */
-        double          ned_vel_c2;          /*!< NED velocity */
-        double          pos_accur_c0;        /*!< Position accuracy */
-        double          pos_accur_c1;        /*!< Position accuracy */
-        double          pos_accur_c2;        /*!< Position accuracy */
-        float           speed_acur;          /*!< Speed accuracy */
-        float           time_acur;           /*!< Time accuracy */
-        unsigned char   unk_5[72];
-        float           temprature;
-        float           pressure;
-    } gps;
-
-    // Check sum
-    struct NAVDATA_CKS {
-        unsigned short tag;
-        unsigned short size;
-        unsigned int   cks;
-    } cks;
+    Point  points[ARDRONE_CLOCK_WINDOWS];   // Smallest offset of the past periods
+    int    numPoints, nextPoint;
+    Point  current;                         // Smallest offset of the current period
+    double start;                           // Time of the AR.Drone the current period started [s]
+    double last;                            // Previous stamp [s], negative if none
+    unsigned int wraps;                     // Number of times the seconds wrapped
+    std::atomic<double> latest;             // Latest time of the AR.Drone [s], negative if none
+    std::atomic<unsigned int> version;      // Odd while the fit is written
+    double center, offset, skew;            // Local = drone + offset + skew * (drone - center)
+    bool   valid;
+    void   fit(void);                       // Fit the offsets and publish the line
 };
-#pragma pack(pop)
 
 // Configurations
 struct ARDRONE_CONFIG {
@@ -1034,6 +737,50 @@ private:
     IplImage *image;
 };
 
+// Statistics of the video since open()
+struct ARDRONE_VIDEO_STATS {
+    unsigned int decoded;           // Frames decoded
+    unsigned int dropped;           // Frames replaced by a newer one before they were fetched
+    unsigned int fetched;           // Frames fetched by getImage() or getFrame()
+    unsigned int skipped;           // Frames not decoded to catch up with the AR.Drone
+    double       decode;            // Mean time from receiving a frame to decoding it [s]
+    double       latency;           // Mean time from receiving a frame to fetching it [s]
+    double       latencyMax;        // Longest time from receiving a frame to fetching it [s]
+};
+
+// Decoded video frame, shares the buffers of the decoder (reference counted, never changed)
+class ARDRONE_FRAME {
+public:
+    ARDRONE_FRAME();                                                    // Constructor
+    ARDRONE_FRAME(const ARDRONE_FRAME &other);                          // Another reference
+    ARDRONE_FRAME& operator = (const ARDRONE_FRAME &other);             // Another reference
+    virtual ~ARDRONE_FRAME();                                           // Destructor
+    bool    empty(void) const;                                          // Check whether there is a frame
+    int     width(void) const;                                          // Width [px]
+    int     height(void) const;                                         // Height [px] without the padding of H.264
+    double  time(void) const;                                           // Time it was captured [s] (clock of ARDrone)
+    double  received(void) const;                                       // Time it was received [s] (clock of ARDrone)
+    double  droneTime(void) const;                                      // Time of the AR.Drone [s], negative if unknown
+    unsigned int number(void) const;                                    // Frame number of the AR.Drone
+    int     type(void) const;                                           // ARDRONE_FRAME_TYPE
+    unsigned int sequence(void) const;                                  // Counted by ARDrone, a newer frame has a larger one
+    cv::Mat gray(void) const;                                           // Luminance, the Y plane of the decoder is not copied
+    cv::Mat bgr(void) const;                                            // Converted to BGR
+    void    bgr(cv::Mat &image) const;                                  // Converted to BGR into an image
+    int     assign(const AVFrame *frame, const ARDRONE_VIDEO_PACKET *packet); // Reference a decoded frame
+    int     copy(const uint8_t *bgr, int width, int height, double time); // Copy a BGR image (AR.Drone 1.0)
+    void    release(void);                                              // Drop the reference
+private:
+    AVFrame *frame;                         // Reference to the buffers
+    double  stamp;                          // Time it was captured [s]
+    double  receivedTime;                   // Time it was received [s]
+    double  drone;                          // Time of the AR.Drone [s]
+    unsigned int frameNumber;
+    int     frameType;
+    unsigned int frameSequence;
+    friend class ARDrone;
+};
+
 // AR.Drone class
 class ARDrone {
 public:
@@ -1054,6 +801,17 @@ public:
     virtual ARDRONE_IMAGE getImage(void);
     virtual ARDrone& operator >> (cv::Mat &image);
     virtual bool willGetNewImage(void);
+    virtual double getImageTime(void);
+
+    // Get the latest frame without copying it, e.g. its Y plane for detection.
+    // Every caller holds its own reference, unlike the image of getImage() shared by all
+    virtual int getFrame(ARDRONE_FRAME *frame);
+
+    // Wait for a frame newer than the given one instead of polling willGetNewImage()
+    virtual int waitForFrame(ARDRONE_FRAME *frame, double timeout);
+
+    // Frames decoded, dropped and their latency
+    virtual int getVideoStats(ARDRONE_VIDEO_STATS *stats);
 
     // Get AR.Drone's firmware version
     virtual int getVersion(int *major = NULL, int *minor = NULL, int *revision = NULL);
@@ -1069,6 +827,19 @@ public:
     // Battery charge [%]
     virtual int getBatteryPercentage(void);
 
+    // Navdata options to receive (ARDRONE_NAVDATA_OPTION masks, all if nobody subscribed)
+    virtual int subscribeNavdata(unsigned int options);
+    virtual int unsubscribeNavdata(unsigned int options);
+    virtual unsigned int getNavdataOptions(void);
+
+    // Navdata of the past, e.g. at the capture time of an image
+    virtual int getNavdataAt(double time, ARDRONE_NAVDATA_SAMPLE *sample);
+    virtual int getNavdataWindow(double from, double to, ARDRONE_NAVDATA_SAMPLE *samples, int max);
+
+    // Time of the clock of the AR.Drone on the clock of ARDrone
+    virtual int fromDroneTime(double drone, double *local);
+    virtual int fromDroneUptime(double uptime, double *drone, double *local);
+
     // Take off / Landing / Emergency
     virtual void takeoff(void);
     virtual void landing(void);
@@ -1094,81 +865,192 @@ public:
     virtual void setVideoRecord(bool activate);     // Video recording (only for AR.Drone 2.0)
     virtual void setOutdoorMode(bool activate);     // Outdoor mode (experimental)
 
+    // Rate the latest setpoint is sent at (30-50 Hz)
+    virtual void setCommandRate(double rate);
+
+    // Directory to cache version information and configurations in ("" to disable)
+    virtual void setCacheDirectory(const char *dir);
+
+    // Clock used by the threads (monotonic clock by default)
+    virtual void setClock(Clock *clock);
+    virtual Clock* getClock(void);
+
+    // CPU the thread serving the sockets runs on (-1 for any)
+    virtual void setEventCPU(int cpu);
+
+    // Low delay and slice threads for the AR.Drone 2.0 video (enabled by default)
+    virtual void setLowLatencyVideo(bool enable);
+
 protected:
     // IP address
     char ip[16];
 
-    // Sequence number
-    unsigned long int seq;
+    // Sequence number (assigned by the sender thread)
+    std::atomic<unsigned int> seq;
+
+    // Clock
+    Clock *clock;
 
     // Camera image
     IplImage *img;
 
     // Sockets
     UDPSocket sockCommand;
+    ATCommandQueue queueCommand;
     UDPSocket sockNavdata;
     UDPSocket sockVideo;
 
+    // One thread for AT command, Navdata and the video of AR.Drone 2.0 (on the monotonic clock of Linux)
+    EventLoop loopEvents;
+    int timerCommand, timerNavdata, readerNavdata, readerVideoSocket;
+    double timerPeriod;
+    int eventCPU;
+    static void onCommandTimer(void *args);
+    static void onNavdataTimer(void *args);
+    static void onNavdataReceived(void *args);
+    static void onVideoReceived(void *args);
+
     // Version information
     ARDRONE_VERSION version;
 
-    // Navigation data
-    ARDRONE_NAVDATA navdata;
+    // Navigation data, published by the receiver with a sequence lock
+    ARDRONE_NAVDATA_PACKET navdata;
+    ARDRONE_NAVDATA_PACKET navdataBuffer[ARDRONE_NAVDATA_BATCH];
+    std::atomic<unsigned int> navdataVersion;
+    unsigned int beginNavdata(void) const;
+    bool retryNavdata(unsigned int version) const;
+    void publishNavdata(const ARDRONE_NAVDATA_PACKET *packet);
+
+    // History of Navdata
+    NavdataHistory historyNavdata;
+    double navdataTime;
+    virtual void recordNavdata(const ARDRONE_NAVDATA_PACKET *packet, double received);
+
+    // Clock of the AR.Drone
+    DroneClockSync syncClock;
+
+    // Subscriptions of Navdata options
+    int navdataSubscribers[ARDRONE_NAVDATA_NUM_TAGS];
+    unsigned int navdataOptions;
+    unsigned int navdataSize;
+    pthread_mutex_t mutexNavdataOptions;
+    virtual int negotiateNavdata(void);
 
     // Configurations
     ARDRONE_CONFIG config;
 
+    // Cache of version information and configurations
+    char cacheDir[256];
+    virtual int loadCache(void);
+    virtual int saveCache(const ARDRONE_VERSION *info = NULL, const ARDRONE_CONFIG *configs = NULL);
+    virtual int cacheKey(const ARDRONE_CONFIG *configs, char *key, size_t size);
+
     // Video
-    AVFormatContext *pFormatCtx;
+    PaVEReader      readerVideo;
+    bool            skipVideo;          // Behind the AR.Drone, waiting for an I-frame
+    bool            rejectedVideoTime;  // The time stamps of the video did not fit the clock of Navdata
     AVCodecContext  *pCodecCtx;
-    AVFrame         *pFrame, *pFrameBGR;
+    AVFrame         *pFrame;
     uint8_t         *bufferBGR;
-    SwsContext      *pConvertCtx;
+    ARDRONE_FRAME   frameVideo;
+    unsigned int    sequenceVideo;      // Number of frames decoded
     bool            newImage;
+    bool            lowLatencyVideo;
+    ARDRONE_VIDEO_STATS statsVideo;     // Sums of the times until getVideoStats()
+
+    // Setpoint (stored by move3D, sent by the thread for AT command)
+    int   setpointFlag;
+    float setpoint[4];
+    pthread_mutex_t *mutexSetpoint;
+
+    // Configurations are sent one at a time
+    pthread_mutex_t *mutexConfig;
+    std::atomic<double> commandPeriod;
+
+    // Last sent setpoint (only used by the sender)
+    int    sentFlag;
+    float  sentSetpoint[4];
+    bool   sentFlying;
+    double keepalive;
+    virtual void updateCommand(double now);
 
     // Thread for AT command
     pthread_t *threadCommand;
-    pthread_mutex_t *mutexCommand;
     virtual void loopCommand(void);
     static void *runCommand(void *args) {
         reinterpret_cast<ARDrone*>(args)->loopCommand();
         return NULL;
     }
 
+    // Thread for checking the cache
+    pthread_t *threadCache;
+    virtual void loopCache(void);
+    static void *runCache(void *args) {
+        reinterpret_cast<ARDrone*>(args)->loopCache();
+        return NULL;
+    }
+
     // Thread for Navdata
     pthread_t *threadNavdata;
-    pthread_mutex_t *mutexNavdata;
     virtual void loopNavdata(void);
     static void *runNavdata(void *args) {
         reinterpret_cast<ARDrone*>(args)->loopNavdata();
         return NULL;
     }
 
-    // Thread for Video
+    // Thread for Video (if it is not read in the event loop)
     pthread_t *threadVideo;
+    std::atomic<bool> stopVideo;        // Asks the thread to return, the sockets time out every 100 ms
     pthread_mutex_t *mutexVideo;
+    pthread_cond_t  *condVideo;         // Signalled with every new frame
+    pthread_mutex_t *mutexImage;        // The IplImage of getImage() is converted by one caller at a time
+    int  waitingVideo;                  // Threads in waitForFrame()
+    bool closingVideo;
     virtual void loopVideo(void);
     static void *runVideo(void *args) {
         reinterpret_cast<ARDrone*>(args)->loopVideo();
         return NULL;
     }
 
+    // Thread for initializing video while the configurations are received
+    struct InitTask {
+        ARDrone *drone;
+        int result;
+        double time;
+    };
+    static void *runInitVideo(void *args) {
+        InitTask *task = reinterpret_cast<InitTask*>(args);
+        double start = task->drone->clock->now();
+        task->result = task->drone->initVideo();
+        task->time = task->drone->clock->now() - start;
+        return NULL;
+    }
+
     // Initialize (internal)
+    virtual int initEvents(void);
     virtual int initCommand(void);
+    virtual int initConfig(void);
     virtual int initNavdata(void);
     virtual int initVideo(void);
 
     // Get informations (internal)
-    virtual int getVersionInfo(void);
+    virtual int getVersionInfo(ARDRONE_VERSION *info = NULL);
     virtual int getNavdata(void);
     virtual int getVideo(void);
-    virtual int getConfig(void);
+    virtual int decodeVideo(AVPacket *packet, const ARDRONE_VIDEO_PACKET *frame);
+    virtual void publishVideo(const ARDRONE_VIDEO_PACKET *frame);
+    virtual void fetchVideo(void);
+    virtual int getConfig(ARDRONE_CONFIG *configs = NULL);
 
     // Send commands (internal)
+    virtual int  setConfig(const char *key, const char *format, ...);
+    virtual int  waitState(unsigned int mask, bool set, double timeout);
+    virtual int  sendCommands(void);
     virtual void resetWatchDog(void);
     virtual void resetEmergency(void);
 
     // Finalize (internal)
+    virtual void finalizeEvents(void);
     virtual void finalizeCommand(void);
     virtual void finalizeNavdata(void);
     virtual void finalizeVideo(void);
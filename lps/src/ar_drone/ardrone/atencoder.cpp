@@ -0,0 +1,282 @@
+// -------------------------------------------------------------------------
+// CV Drone (= OpenCV + AR.Drone)
+// Copyright(C) 2016 puku0x
+// https://github.com/puku0x/cvdrone
+//
+// This source file is part of CV Drone library.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of EITHER:
+// (1) The GNU Lesser General Public License as published by the Free
+//     Software Foundation; either version 2.1 of the License, or (at
+//     your option) any later version. The text of the GNU Lesser
+//     General Public License is included with this library in the
+//     file cvdrone-license-LGPL.txt.
+// (2) The BSD-style license that is included with this library in
+//     the file cvdrone-license-BSD.txt.
+// 
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files
+// cvdrone-license-LGPL.txt and cvdrone-license-BSD.txt for more details.
+//
+//! @file   atencoder.cpp
+//! @brief  Encoder of AT commands
+//
+// -------------------------------------------------------------------------
+
+#include "atencoder.h"
+
+// --------------------------------------------------------------------------
+// ATEncoder::ATEncoder(Buffer, Size of buffer)
+// Description : Constructor of ATEncoder class.
+// --------------------------------------------------------------------------
+ATEncoder::ATEncoder(char *buffer, size_t size)
+{
+    this->buffer = buffer;
+    capacity = size;
+    length = 0;
+    overflow = false;
+}
+
+// --------------------------------------------------------------------------
+// ATEncoder::size()
+// Description  : Size of the encoded commands.
+// Return value : Number of bytes
+// --------------------------------------------------------------------------
+size_t ATEncoder::size(void)
+{
+    return length;
+}
+
+// --------------------------------------------------------------------------
+// ATEncoder::clear()
+// Description : Start a new datagram in the same buffer.
+// --------------------------------------------------------------------------
+void ATEncoder::clear(void)
+{
+    length = 0;
+    overflow = false;
+}
+
+// --------------------------------------------------------------------------
+// ATEncoder::string(String)
+// Description : Append a string.
+// --------------------------------------------------------------------------
+void ATEncoder::string(const char *str)
+{
+    size_t n = strlen(str);
+    if (length + n > capacity) { overflow = true; return; }
+    memcpy(buffer + length, str, n);
+    length += n;
+}
+
+// --------------------------------------------------------------------------
+// ATEncoder::unsignedInteger(Value)
+// Description : Append an unsigned decimal number.
+// --------------------------------------------------------------------------
+void ATEncoder::unsignedInteger(unsigned int value)
+{
+    // Two digits per division
+    static const char pairs[201] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    // Digits from the back
+    char digits[10];
+    int n = 10;
+    while (value >= 100) {
+        unsigned int i = (value % 100) * 2;
+        value /= 100;
+        digits[--n] = pairs[i + 1];
+        digits[--n] = pairs[i];
+    }
+    if (value >= 10) {
+        digits[--n] = pairs[value * 2 + 1];
+        digits[--n] = pairs[value * 2];
+    }
+    else digits[--n] = (char)('0' + value);
+
+    size_t count = 10 - n;
+    if (length + count > capacity) { overflow = true; return; }
+    memcpy(buffer + length, digits + n, count);
+    length += count;
+}
+
+// --------------------------------------------------------------------------
+// ATEncoder::integer(Value)
+// Description : Append a signed decimal number.
+// --------------------------------------------------------------------------
+void ATEncoder::integer(int value)
+{
+    if (value < 0) {
+        literal("-");
+        unsignedInteger(0U - (unsigned int)value);
+    }
+    else unsignedInteger((unsigned int)value);
+}
+
+// --------------------------------------------------------------------------
+// ATEncoder::begin()
+// Description  : Start a command.
+// Return value : Position of the command
+// --------------------------------------------------------------------------
+size_t ATEncoder::begin(void)
+{
+    overflow = false;
+    return length;
+}
+
+// --------------------------------------------------------------------------
+// ATEncoder::end(Position of the command)
+// Description  : Finish a command, it is removed again if it did not fit.
+// Return value : SUCCESS: 1  FAILURE (full): 0
+// --------------------------------------------------------------------------
+int ATEncoder::end(size_t start)
+{
+    literal("\r");
+    if (overflow) {
+        length = start;
+        overflow = false;
+        return 0;
+    }
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+// ATEncoder::pcmd(Sequence number, Flag, Roll, Pitch, Gaz, Yaw)
+// Description  : AT*PCMD, the floats are sent as the integers with the same bits.
+// Return value : SUCCESS: 1  FAILURE (full): 0
+// --------------------------------------------------------------------------
+int ATEncoder::pcmd(unsigned int seq, int flag, float roll, float pitch, float gaz, float yaw)
+{
+    float v[4] = {roll, pitch, gaz, yaw};
+    int bits[4];
+    memcpy(bits, v, sizeof(bits));
+
+    size_t start = begin();
+    literal("AT*PCMD=");
+    unsignedInteger(seq);
+    literal(",");
+    integer(flag);
+    for (int i = 0; i < 4; i++) {
+        literal(",");
+        integer(bits[i]);
+    }
+    return end(start);
+}
+
+// --------------------------------------------------------------------------
+// ATEncoder::ref(Sequence number, Control bits)
+// Description  : AT*REF.
+// Return value : SUCCESS: 1  FAILURE (full): 0
+// --------------------------------------------------------------------------
+int ATEncoder::ref(unsigned int seq, int bits)
+{
+    size_t start = begin();
+    literal("AT*REF=");
+    unsignedInteger(seq);
+    literal(",");
+    integer(bits);
+    return end(start);
+}
+
+// --------------------------------------------------------------------------
+// ATEncoder::comwdg(Sequence number)
+// Description  : AT*COMWDG.
+// Return value : SUCCESS: 1  FAILURE (full): 0
+// --------------------------------------------------------------------------
+int ATEncoder::comwdg(unsigned int seq)
+{
+    size_t start = begin();
+    literal("AT*COMWDG=");
+    unsignedInteger(seq);
+    return end(start);
+}
+
+// --------------------------------------------------------------------------
+// ATEncoder::config(Sequence number, Key, Value)
+// Description  : AT*CONFIG.
+// Return value : SUCCESS: 1  FAILURE (full): 0
+// --------------------------------------------------------------------------
+int ATEncoder::config(unsigned int seq, const char *key, const char *value)
+{
+    size_t start = begin();
+    literal("AT*CONFIG=");
+    unsignedInteger(seq);
+    literal(",\"");
+    string(key);
+    literal("\",\"");
+    string(value);
+    literal("\"");
+    return end(start);
+}
+
+// --------------------------------------------------------------------------
+// ATEncoder::configIds(Sequence number, Session ID, Profile ID, Application ID)
+// Description  : AT*CONFIG_IDS.
+// Return value : SUCCESS: 1  FAILURE (full): 0
+// --------------------------------------------------------------------------
+int ATEncoder::configIds(unsigned int seq, const char *session, const char *profile, const char *application)
+{
+    size_t start = begin();
+    literal("AT*CONFIG_IDS=");
+    unsignedInteger(seq);
+    literal(",\"");
+    string(session);
+    literal("\",\"");
+    string(profile);
+    literal("\",\"");
+    string(application);
+    literal("\"");
+    return end(start);
+}
+
+// --------------------------------------------------------------------------
+// ATEncoder::other(Sequence number, Name, Arguments)
+// Description  : Any other command, the arguments start with a comma.
+// Return value : SUCCESS: 1  FAILURE (full): 0
+// --------------------------------------------------------------------------
+int ATEncoder::other(unsigned int seq, const char *name, const char *args)
+{
+    size_t start = begin();
+    literal("AT*");
+    string(name);
+    literal("=");
+    unsignedInteger(seq);
+    string(args);
+    return end(start);
+}
+
+// --------------------------------------------------------------------------
+// ATEncoder::encode(Sequence number, Command)
+// Description  : Append a queued command.
+// Return value : SUCCESS: 1  FAILURE (full): 0
+// --------------------------------------------------------------------------
+int ATEncoder::encode(unsigned int seq, const ATCommand &command)
+{
+    const int *a = command.args;
+    const char *text = command.text;
+
+    switch (command.type) {
+        case ARDRONE_AT_PCMD: {
+            float v[4];
+            memcpy(v, a + 1, sizeof(v));
+            return pcmd(seq, a[0], v[0], v[1], v[2], v[3]);
+        }
+        case ARDRONE_AT_REF:
+            return ref(seq, a[0]);
+        case ARDRONE_AT_COMWDG:
+            return comwdg(seq);
+        case ARDRONE_AT_CONFIG:
+            return config(seq, text, text + strlen(text) + 1);
+        case ARDRONE_AT_CONFIG_IDS: {
+            const char *profile = text + strlen(text) + 1;
+            const char *application = profile + strlen(profile) + 1;
+            return configIds(seq, text, profile, application);
+        }
+        default:
+            return other(seq, command.name, text);
+    }
+}
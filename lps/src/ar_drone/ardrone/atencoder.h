@@ -0,0 +1,86 @@
+#ifndef __HEADER_ATENCODER__
+#define __HEADER_ATENCODER__
+
+// -------------------------------------------------------------------------
+// CV Drone (= OpenCV + AR.Drone)
+// Copyright(C) 2016 puku0x
+// https://github.com/puku0x/cvdrone
+//
+// This source file is part of CV Drone library.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of EITHER:
+// (1) The GNU Lesser General Public License as published by the Free
+//     Software Foundation; either version 2.1 of the License, or (at
+//     your option) any later version. The text of the GNU Lesser
+//     General Public License is included with this library in the
+//     file cvdrone-license-LGPL.txt.
+// (2) The BSD-style license that is included with this library in
+//     the file cvdrone-license-BSD.txt.
+// 
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files
+// cvdrone-license-LGPL.txt and cvdrone-license-BSD.txt for more details.
+//
+//! @file   atencoder.h
+//! @brief  Encoder of AT commands, writes them straight into a datagram
+//
+// -------------------------------------------------------------------------
+
+#include <stddef.h>
+#include <string.h>
+
+// AT command types
+enum ARDRONE_AT_TYPE {
+    ARDRONE_AT_OTHER = 0,   // Name and preformatted arguments
+    ARDRONE_AT_PCMD,        // Progressive command
+    ARDRONE_AT_REF,         // Take off / Landing / Emergency
+    ARDRONE_AT_COMWDG,      // Reset the communication watchdog
+    ARDRONE_AT_CONFIG,      // Set a configuration
+    ARDRONE_AT_CONFIG_IDS   // Identifiers of the next configuration
+};
+
+// AT command without sequence number
+struct ATCommand {
+    int  type;              // ARDRONE_AT_TYPE
+    int  args[5];           // PCMD: flag and the bits of roll, pitch, gaz and yaw, REF: control bits
+    char name[16];          // OTHER: name of the command (e.g. "LED")
+    char text[232];         // OTHER: arguments, CONFIG: key '\0' value, CONFIG_IDS: session '\0' profile '\0' application
+};
+
+// AT command encoder
+// Every function appends one complete command or nothing (if it does not fit), no printf and no allocations
+class ATEncoder {
+public:
+    ATEncoder(char *buffer, size_t size);
+    int    encode(unsigned int seq, const ATCommand &command);
+    int    pcmd(unsigned int seq, int flag, float roll, float pitch, float gaz, float yaw);
+    int    ref(unsigned int seq, int bits);
+    int    comwdg(unsigned int seq);
+    int    config(unsigned int seq, const char *key, const char *value);
+    int    configIds(unsigned int seq, const char *session, const char *profile, const char *application);
+    int    other(unsigned int seq, const char *name, const char *args);
+    size_t size(void);
+    void   clear(void);
+
+private:
+    char   *buffer;     // Datagram
+    size_t capacity;    // Size of the datagram
+    size_t length;      // Bytes written so far
+    bool   overflow;    // The current command did not fit
+
+    // Text known at compile time, the size is a constant
+    template <size_t N> void literal(const char (&str)[N]) {
+        if (length + N - 1 > capacity) { overflow = true; return; }
+        memcpy(buffer + length, str, N - 1);
+        length += N - 1;
+    }
+    void   string(const char *str);
+    void   integer(int value);
+    void   unsignedInteger(unsigned int value);
+    size_t begin(void);
+    int    end(size_t start);
+};
+
+#endif
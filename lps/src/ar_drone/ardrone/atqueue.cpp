@@ -0,0 +1,242 @@
+// -------------------------------------------------------------------------
+// CV Drone (= OpenCV + AR.Drone)
+// Copyright(C) 2016 puku0x
+// https://github.com/puku0x/cvdrone
+//
+// This source file is part of CV Drone library.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of EITHER:
+// (1) The GNU Lesser General Public License as published by the Free
+//     Software Foundation; either version 2.1 of the License, or (at
+//     your option) any later version. The text of the GNU Lesser
+//     General Public License is included with this library in the
+//     file cvdrone-license-LGPL.txt.
+// (2) The BSD-style license that is included with this library in
+//     the file cvdrone-license-BSD.txt.
+// 
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files
+// cvdrone-license-LGPL.txt and cvdrone-license-BSD.txt for more details.
+//
+//! @file   atqueue.cpp
+//! @brief  AT command queue class
+//
+// -------------------------------------------------------------------------
+
+// Bounded ring buffer after D. Vyukov: every slot carries the position it can be
+// written (turn == pos) or read (turn == pos + 1) at, so producers claim slots with
+// one compare-and-swap and never block each other or the sender.
+
+#include "ardrone.h"
+
+// --------------------------------------------------------------------------
+// ATCommandQueue::ATCommandQueue()
+// Description : Constructor of ATCommandQueue class.
+// --------------------------------------------------------------------------
+ATCommandQueue::ATCommandQueue()
+{
+    for (size_t i = 0; i < ARDRONE_AT_QUEUE_SIZE; i++) entries[i].turn = i;
+    head = 0;
+    tail = 0;
+}
+
+// --------------------------------------------------------------------------
+// ATCommandQueue::~ATCommandQueue()
+// Description : Destructor of ATCommandQueue class.
+// --------------------------------------------------------------------------
+ATCommandQueue::~ATCommandQueue()
+{
+}
+
+// --------------------------------------------------------------------------
+// ATCommandQueue::reserve(Number of slots)
+// Description  : Claim consecutive slots, so that commands which belong
+//                together are sent in this order without others in between.
+// Return value : SUCCESS: Position of the first slot  FAILURE (full): (size_t)-1
+// --------------------------------------------------------------------------
+size_t ATCommandQueue::reserve(int count)
+{
+    size_t pos = head.load(std::memory_order_relaxed);
+    while (1) {
+        // All the slots have to be free
+        int free = 0;
+        for (int i = 0; i < count; i++) {
+            size_t turn = entries[(pos + i) % ARDRONE_AT_QUEUE_SIZE].turn.load(std::memory_order_acquire);
+            if (turn == pos + i) free++;
+            else if ((long)(turn - (pos + i)) < 0) return (size_t)-1; // The sender did not catch up
+            else break;                                                  // Another producer was faster
+        }
+        if (free == count) {
+            if (head.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) return pos;
+        }
+        else pos = head.load(std::memory_order_relaxed);
+    }
+}
+
+// --------------------------------------------------------------------------
+// ATCommandQueue::slot(Position)
+// Description  : Command of a reserved slot.
+// Return value : Pointer to the command
+// --------------------------------------------------------------------------
+ATCommand* ATCommandQueue::slot(size_t pos)
+{
+    return &entries[pos % ARDRONE_AT_QUEUE_SIZE].command;
+}
+
+// --------------------------------------------------------------------------
+// ATCommandQueue::commit(Position, Number of slots)
+// Description : Hand written slots to the sender.
+// --------------------------------------------------------------------------
+void ATCommandQueue::commit(size_t pos, int count)
+{
+    for (int i = 0; i < count; i++) {
+        entries[(pos + i) % ARDRONE_AT_QUEUE_SIZE].turn.store(pos + i + 1, std::memory_order_release);
+    }
+}
+
+// --------------------------------------------------------------------------
+// ATCommandQueue::push(Name, Arguments)
+// Description  : Enqueue a command. The arguments follow the sequence number
+//                and start with a comma, e.g. push("LED", ",%d,%d,%d", ...).
+// Return value : SUCCESS: 1  FAILURE (full): 0
+// --------------------------------------------------------------------------
+int ATCommandQueue::push(const char *name, const char *args, ...)
+{
+    size_t pos = reserve(1);
+    if (pos == (size_t)-1) return 0;
+
+    // Write the slot
+    ATCommand *command = slot(pos);
+    command->type = ARDRONE_AT_OTHER;
+    strncpy(command->name, name, sizeof(command->name) - 1);
+    command->name[sizeof(command->name) - 1] = '\0';
+    va_list arg;
+    va_start(arg, args);
+    vsnprintf(command->text, sizeof(command->text), args, arg);
+    va_end(arg);
+
+    commit(pos, 1);
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+// ATCommandQueue::pushPCMD(Flag, Roll, Pitch, Gaz, Yaw)
+// Description  : Enqueue a progressive command.
+// Return value : SUCCESS: 1  FAILURE (full): 0
+// --------------------------------------------------------------------------
+int ATCommandQueue::pushPCMD(int flag, float roll, float pitch, float gaz, float yaw)
+{
+    size_t pos = reserve(1);
+    if (pos == (size_t)-1) return 0;
+
+    // The floats are kept as their bits
+    ATCommand *command = slot(pos);
+    float v[4] = {roll, pitch, gaz, yaw};
+    command->type = ARDRONE_AT_PCMD;
+    command->args[0] = flag;
+    memcpy(command->args + 1, v, sizeof(v));
+
+    commit(pos, 1);
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+// ATCommandQueue::pushREF(Control bits)
+// Description  : Enqueue take off / landing / emergency.
+// Return value : SUCCESS: 1  FAILURE (full): 0
+// --------------------------------------------------------------------------
+int ATCommandQueue::pushREF(int bits)
+{
+    size_t pos = reserve(1);
+    if (pos == (size_t)-1) return 0;
+
+    ATCommand *command = slot(pos);
+    command->type = ARDRONE_AT_REF;
+    command->args[0] = bits;
+
+    commit(pos, 1);
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+// ATCommandQueue::pushCOMWDG()
+// Description  : Enqueue a watchdog reset.
+// Return value : SUCCESS: 1  FAILURE (full): 0
+// --------------------------------------------------------------------------
+int ATCommandQueue::pushCOMWDG(void)
+{
+    size_t pos = reserve(1);
+    if (pos == (size_t)-1) return 0;
+
+    slot(pos)->type = ARDRONE_AT_COMWDG;
+
+    commit(pos, 1);
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+// ATCommandQueue::pushConfig(Key, Value, With IDs)
+// Description  : Enqueue a configuration, preceded by AT*CONFIG_IDS for AR.Drone 2.0.
+// Return value : SUCCESS: 1  FAILURE (full or too long): 0
+// --------------------------------------------------------------------------
+int ATCommandQueue::pushConfig(const char *key, const char *value, bool ids)
+{
+    // Key and value are stored one after the other
+    size_t k = strlen(key), v = strlen(value);
+    if (k + v + 2 > sizeof(((ATCommand*)0)->text)) return 0;
+
+    int count = ids ? 2 : 1;
+    size_t pos = reserve(count);
+    if (pos == (size_t)-1) return 0;
+
+    // Configuration IDs
+    if (ids) {
+        ATCommand *command = slot(pos);
+        const char *id[3] = {ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID};
+        char *p = command->text;
+        command->type = ARDRONE_AT_CONFIG_IDS;
+        for (int i = 0; i < 3; i++) {
+            size_t n = strlen(id[i]) + 1;
+            memcpy(p, id[i], n);
+            p += n;
+        }
+    }
+
+    // Configuration
+    ATCommand *command = slot(pos + count - 1);
+    command->type = ARDRONE_AT_CONFIG;
+    memcpy(command->text, key, k + 1);
+    memcpy(command->text + k + 1, value, v + 1);
+
+    commit(pos, count);
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+// ATCommandQueue::pack(Datagram, Size of datagram, Sequence number)
+// Description  : Dequeue as many commands as fit into one datagram and
+//                number them. Must only be called by one thread at a time.
+// Return value : Size of the datagram (0 if nothing is queued)
+// --------------------------------------------------------------------------
+size_t ATCommandQueue::pack(char *datagram, size_t size, std::atomic<unsigned int> *seq)
+{
+    ATEncoder encoder(datagram, size);
+    while (1) {
+        // Nothing (more) to send
+        Entry &entry = entries[tail % ARDRONE_AT_QUEUE_SIZE];
+        if (entry.turn.load(std::memory_order_acquire) != tail + 1) break;
+
+        // Append the command, keep it for the next datagram if it does not fit
+        unsigned int next = seq->load(std::memory_order_relaxed) + 1;
+        if (encoder.encode(next, entry.command)) seq->store(next, std::memory_order_relaxed);
+        else if (encoder.size() > 0) break;
+        // else: it can never be sent, drop it
+
+        // Free the slot
+        entry.turn.store(tail + ARDRONE_AT_QUEUE_SIZE, std::memory_order_release);
+        tail++;
+    }
+    return encoder.size();
+}
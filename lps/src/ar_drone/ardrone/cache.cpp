@@ -0,0 +1,210 @@
+// -------------------------------------------------------------------------
+// CV Drone (= OpenCV + AR.Drone)
+// Copyright(C) 2016 puku0x
+// https://github.com/puku0x/cvdrone
+//
+// This source file is part of CV Drone library.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of EITHER:
+// (1) The GNU Lesser General Public License as published by the Free
+//     Software Foundation; either version 2.1 of the License, or (at
+//     your option) any later version. The text of the GNU Lesser
+//     General Public License is included with this library in the
+//     file cvdrone-license-LGPL.txt.
+// (2) The BSD-style license that is included with this library in
+//     the file cvdrone-license-BSD.txt.
+// 
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files
+// cvdrone-license-LGPL.txt and cvdrone-license-BSD.txt for more details.
+//
+//! @file   cache.cpp
+//! @brief  On-disk cache of version information and configurations
+//
+// -------------------------------------------------------------------------
+
+#include "ardrone.h"
+#include <ctype.h>
+
+// Header of a cache file
+struct ARDRONE_CACHE_HEADER {
+    char         magic[8];      // "CVDRC01"
+    unsigned int version_size;  // sizeof(ARDRONE_VERSION)
+    unsigned int config_size;   // sizeof(ARDRONE_CONFIG)
+};
+
+// --------------------------------------------------------------------------
+//! @brief   Set the directory of the cache.
+//! @param   dir Directory, NULL or "" disables the cache
+//! @note    Version information and configurations are saved there after
+//!          connecting and used at the next connection to the same address.
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::setCacheDirectory(const char *dir)
+{
+    if (dir) strncpy(cacheDir, dir, sizeof(cacheDir) - 1);
+    else     cacheDir[0] = '\0';
+    cacheDir[sizeof(cacheDir) - 1] = '\0';
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Get the file names of the cache.
+//! @param   dir Directory of the cache
+//! @param   ip IP address of the AR.Drone
+//! @param   key Key of the AR.Drone (serial and firmware)
+//! @param   last Name of the file with the key of the last AR.Drone at this address, NULL to skip
+//! @param   cache Name of the cache file of the key, NULL to skip
+//! @param   size Size of the buffers
+//! @return  None
+// --------------------------------------------------------------------------
+static void cacheFiles(const char *dir, const char *ip, const char *key, char *last, char *cache, size_t size)
+{
+    if (last) snprintf(last, size, "%s/ardrone-%s.last", dir, ip);
+    if (key && cache) snprintf(cache, size, "%s/ardrone-%s.cache", dir, key);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Get the key of an AR.Drone.
+//! @param   configs Configurations of the AR.Drone
+//! @param   key Buffer for the key
+//! @param   size Size of the buffer
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 The serial or the firmware is unknown
+// --------------------------------------------------------------------------
+int ARDrone::cacheKey(const ARDRONE_CONFIG *configs, char *key, size_t size)
+{
+    if (!configs->general.drone_serial[0] || !configs->general.num_version_soft[0]) return 0;
+    snprintf(key, size, "%s-%s", configs->general.drone_serial, configs->general.num_version_soft);
+
+    // Only characters that are safe in a file name
+    for (char *c = key; *c; c++) {
+        if (!isalnum((unsigned char)*c) && *c != '.' && *c != '-') *c = '_';
+    }
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Load version information and configurations of the last connection.
+//! @return  Result of this function
+//! @retval  1 Loaded
+//! @retval  0 No (valid) cache
+// --------------------------------------------------------------------------
+int ARDrone::loadCache(void)
+{
+    if (!cacheDir[0]) return 0;
+
+    // Key of the last AR.Drone at this address
+    char last[512], cache[512], key[80] = {'\0'};
+    cacheFiles(cacheDir, ip, NULL, last, NULL, sizeof(last));
+    FILE *file = fopen(last, "r");
+    if (!file) return 0;
+    int found = fscanf(file, "%79s", key);
+    fclose(file);
+    if (found != 1) return 0;
+
+    // Cache of the key
+    cacheFiles(cacheDir, ip, key, NULL, cache, sizeof(cache));
+    file = fopen(cache, "rb");
+    if (!file) return 0;
+    ARDRONE_CACHE_HEADER header;
+    ARDRONE_VERSION cachedVersion;
+    ARDRONE_CONFIG *cachedConfig = new ARDRONE_CONFIG;
+    int valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                !strncmp(header.magic, "CVDRC01", sizeof(header.magic)) &&
+                header.version_size == sizeof(ARDRONE_VERSION) &&
+                header.config_size == sizeof(ARDRONE_CONFIG) &&
+                fread(&cachedVersion, sizeof(cachedVersion), 1, file) == 1 &&
+                fread(cachedConfig, sizeof(ARDRONE_CONFIG), 1, file) == 1;
+    fclose(file);
+
+    // Use it
+    if (valid) {
+        version = cachedVersion;
+        config = *cachedConfig;
+    }
+    delete cachedConfig;
+    return valid;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Save version information and configurations.
+//! @param   info Version information, NULL for the one of this ARDrone
+//! @param   configs Configurations, NULL for the ones of this ARDrone
+//! @return  Result of this function
+//! @retval  1 Saved
+//! @retval  0 Failure or disabled
+// --------------------------------------------------------------------------
+int ARDrone::saveCache(const ARDRONE_VERSION *info, const ARDRONE_CONFIG *configs)
+{
+    if (!cacheDir[0]) return 0;
+    if (!info) info = &version;
+    if (!configs) configs = &config;
+
+    char last[512], cache[512], key[80];
+    if (!cacheKey(configs, key, sizeof(key))) return 0;
+    cacheFiles(cacheDir, ip, key, last, cache, sizeof(last));
+
+    // Version information and configurations
+    ARDRONE_CACHE_HEADER header;
+    memset(&header, 0, sizeof(header));
+    strncpy(header.magic, "CVDRC01", sizeof(header.magic));
+    header.version_size = sizeof(ARDRONE_VERSION);
+    header.config_size = sizeof(ARDRONE_CONFIG);
+    FILE *file = fopen(cache, "wb");
+    if (!file) {
+        CVDRONE_ERROR("Could not write %s. (%s, %d)\n", cache, __FILE__, __LINE__);
+        return 0;
+    }
+    int written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  fwrite(info, sizeof(ARDRONE_VERSION), 1, file) == 1 &&
+                  fwrite(configs, sizeof(ARDRONE_CONFIG), 1, file) == 1;
+    if (fclose(file) != 0) written = 0;
+    if (!written) return 0;
+
+    // This AR.Drone is the last one at this address
+    file = fopen(last, "w");
+    if (!file) return 0;
+    fprintf(file, "%s\n", key);
+    fclose(file);
+
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Thread function to check the cache against the AR.Drone.
+//! @note    Fetches version information and configurations again, reports
+//!          if the cache belonged to another AR.Drone or firmware and saves
+//!          the fresh values. They are fetched into objects of its own, the
+//!          other threads keep reading the cached ones.
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::loopCache(void)
+{
+    // What the cache said, nobody writes it while the drone is open
+    char cachedKey[80] = {'\0'};
+    cacheKey(&config, cachedKey, sizeof(cachedKey));
+
+    // Ask the AR.Drone
+    ARDRONE_VERSION fetchedVersion;
+    ARDRONE_CONFIG *fetchedConfig = new ARDRONE_CONFIG;
+    memset(&fetchedVersion, 0, sizeof(fetchedVersion));
+    memset(fetchedConfig, 0, sizeof(ARDRONE_CONFIG));
+    char key[80] = {'\0'};
+    if (!getVersionInfo(&fetchedVersion) || !getConfig(fetchedConfig) || !cacheKey(fetchedConfig, key, sizeof(key))) {
+        CVDRONE_ERROR("Could not check the cached configurations. (%s, %d)\n", __FILE__, __LINE__);
+        delete fetchedConfig;
+        return;
+    }
+
+    // Compare
+    if (strcmp(key, cachedKey) || fetchedVersion.major != version.major || fetchedVersion.minor != version.minor || fetchedVersion.revision != version.revision) {
+        CVDRONE_ERROR("The cache was for AR.Drone %s, connected to %s. Reconnect if the AR.Drone version changed. (%s, %d)\n", cachedKey, key, __FILE__, __LINE__);
+    }
+
+    // Only the file gets the fresh values
+    saveCache(&fetchedVersion, fetchedConfig);
+    delete fetchedConfig;
+}
@@ -0,0 +1,190 @@
+// -------------------------------------------------------------------------
+// CV Drone (= OpenCV + AR.Drone)
+// Copyright(C) 2016 puku0x
+// https://github.com/puku0x/cvdrone
+//
+// This source file is part of CV Drone library.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of EITHER:
+// (1) The GNU Lesser General Public License as published by the Free
+//     Software Foundation; either version 2.1 of the License, or (at
+//     your option) any later version. The text of the GNU Lesser
+//     General Public License is included with this library in the
+//     file cvdrone-license-LGPL.txt.
+// (2) The BSD-style license that is included with this library in
+//     the file cvdrone-license-BSD.txt.
+// 
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files
+// cvdrone-license-LGPL.txt and cvdrone-license-BSD.txt for more details.
+//
+//! @file   clock.cpp
+//! @brief  Monotonic and virtual clock
+//
+// -------------------------------------------------------------------------
+
+#include "clock.h"
+#include <iterator>
+#ifdef _WIN32
+#include <chrono>
+#include <thread>
+#else
+#include <time.h>
+#include <errno.h>
+#endif
+
+// --------------------------------------------------------------------------
+//! @brief   Get the shared monotonic clock.
+//! @return  Pointer to the clock
+// --------------------------------------------------------------------------
+Clock *Clock::monotonic(void)
+{
+    static MonotonicClock clock;
+    return &clock;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Get the current time.
+//! @return  Time since an arbitrary point [s]
+// --------------------------------------------------------------------------
+double MonotonicClock::now(void)
+{
+#ifdef _WIN32
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+#endif
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Sleep for a duration.
+//! @param   seconds Duration [s]
+//! @return  None
+// --------------------------------------------------------------------------
+void MonotonicClock::sleep(double seconds)
+{
+    sleepUntil(now() + seconds);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Sleep until an absolute time, the deadline does not drift with the time spent before the call.
+//! @param   t Time returned by now() [s]
+//! @return  None
+// --------------------------------------------------------------------------
+void MonotonicClock::sleepUntil(double t)
+{
+#ifdef _WIN32
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(t))));
+#else
+    struct timespec deadline;
+    deadline.tv_sec  = (time_t)t;
+    deadline.tv_nsec = (long)((t - deadline.tv_sec) * 1e9);
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+#endif
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Constructor of VirtualClock class.
+//! @param   start Initial time [s]
+//! @return  None
+// --------------------------------------------------------------------------
+VirtualClock::VirtualClock(double start)
+{
+    time = start;
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&cond, NULL);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Destructor of VirtualClock class.
+//! @return  None
+// --------------------------------------------------------------------------
+VirtualClock::~VirtualClock()
+{
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&mutex);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Get the current virtual time.
+//! @return  Time [s]
+// --------------------------------------------------------------------------
+double VirtualClock::now(void)
+{
+    pthread_mutex_lock(&mutex);
+    double t = time;
+    pthread_mutex_unlock(&mutex);
+    return t;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Sleep until the virtual time has moved by a duration.
+//! @param   seconds Duration [s]
+//! @return  None
+// --------------------------------------------------------------------------
+void VirtualClock::sleep(double seconds)
+{
+    sleepUntil(now() + seconds);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Sleep until the virtual time reaches a time.
+//! @param   t Time [s]
+//! @return  None
+// --------------------------------------------------------------------------
+void VirtualClock::sleepUntil(double t)
+{
+    pthread_mutex_lock(&mutex);
+    std::multiset<double>::iterator it = deadlines.insert(t);
+    pthread_cond_broadcast(&cond);
+    while (time < t) pthread_cond_wait(&cond, &mutex);
+    deadlines.erase(it);
+    pthread_mutex_unlock(&mutex);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Move the virtual time forward.
+//! @param   seconds Duration [s]
+//! @return  None
+// --------------------------------------------------------------------------
+void VirtualClock::advance(double seconds)
+{
+    pthread_mutex_lock(&mutex);
+    time += seconds;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Set the virtual time, e.g. to the timestamp of a replayed record.
+//! @param   t Time [s], earlier times are ignored
+//! @return  None
+// --------------------------------------------------------------------------
+void VirtualClock::set(double t)
+{
+    pthread_mutex_lock(&mutex);
+    if (t > time) time = t;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Wait until a number of threads are sleeping on this clock.
+//! @param   n Number of threads
+//! @return  None
+// --------------------------------------------------------------------------
+void VirtualClock::waitForSleepers(int n)
+{
+    // Threads whose time is already reached are about to wake up and are not counted
+    pthread_mutex_lock(&mutex);
+    while ((int)std::distance(deadlines.upper_bound(time), deadlines.end()) < n) pthread_cond_wait(&cond, &mutex);
+    pthread_mutex_unlock(&mutex);
+}
@@ -0,0 +1,85 @@
+#ifndef __HEADER_CLOCK__
+#define __HEADER_CLOCK__
+
+// -------------------------------------------------------------------------
+// CV Drone (= OpenCV + AR.Drone)
+// Copyright(C) 2016 puku0x
+// https://github.com/puku0x/cvdrone
+//
+// This source file is part of CV Drone library.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of EITHER:
+// (1) The GNU Lesser General Public License as published by the Free
+//     Software Foundation; either version 2.1 of the License, or (at
+//     your option) any later version. The text of the GNU Lesser
+//     General Public License is included with this library in the
+//     file cvdrone-license-LGPL.txt.
+// (2) The BSD-style license that is included with this library in
+//     the file cvdrone-license-BSD.txt.
+// 
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files
+// cvdrone-license-LGPL.txt and cvdrone-license-BSD.txt for more details.
+//
+//! @file   clock.h
+//! @brief  Clock classes, every timestamp and sleep of the threads goes through a clock
+//
+// -------------------------------------------------------------------------
+
+// POSIX threads
+#include <pthread.h>
+
+// STL
+#include <set>
+
+// Clock interface
+class Clock {
+public:
+    virtual ~Clock() {}
+
+    // Current time [s]
+    virtual double now(void) = 0;
+
+    // Sleep for a duration / until a time [s]
+    virtual void sleep(double seconds) = 0;
+    virtual void sleepUntil(double t) = 0;
+
+    // Shared monotonic clock, used if no other clock is set
+    static Clock *monotonic(void);
+};
+
+// Monotonic wall clock
+class MonotonicClock : public Clock {
+public:
+    double now(void);
+    void sleep(double seconds);
+    void sleepUntil(double t);
+};
+
+// Virtual clock for replay and simulation
+// The time only moves when advance() or set() is called, sleeping threads wake up when their time is reached
+class VirtualClock : public Clock {
+public:
+    VirtualClock(double start = 0.0);
+    virtual ~VirtualClock();
+    double now(void);
+    void sleep(double seconds);
+    void sleepUntil(double t);
+
+    // Move the time forward and wake the threads whose time is reached
+    void advance(double seconds);
+    void set(double t);
+
+    // Wait until n threads are sleeping past the current time, makes stepping deterministic
+    void waitForSleepers(int n);
+
+private:
+    double time;
+    std::multiset<double> deadlines;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+};
+
+#endif
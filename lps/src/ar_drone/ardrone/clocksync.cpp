@@ -0,0 +1,214 @@
+// -------------------------------------------------------------------------
+// CV Drone (= OpenCV + AR.Drone)
+// Copyright(C) 2016 puku0x
+// https://github.com/puku0x/cvdrone
+//
+// This source file is part of CV Drone library.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of EITHER:
+// (1) The GNU Lesser General Public License as published by the Free
+//     Software Foundation; either version 2.1 of the License, or (at
+//     your option) any later version. The text of the GNU Lesser
+//     General Public License is included with this library in the
+//     file cvdrone-license-LGPL.txt.
+// (2) The BSD-style license that is included with this library in
+//     the file cvdrone-license-BSD.txt.
+// 
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files
+// cvdrone-license-LGPL.txt and cvdrone-license-BSD.txt for more details.
+//
+//! @file   clocksync.cpp
+//! @brief  Synchronisation of the clock of the AR.Drone
+//
+// -------------------------------------------------------------------------
+
+// Every packet arrives some delay after the AR.Drone stamped it, so the
+// offset between the clocks is at most local time - stamp. The smallest
+// offset of every period had the least delay, a line through the smallest
+// offsets of the last periods follows the offset and the skew of the clocks.
+
+#include "ardrone.h"
+
+// --------------------------------------------------------------------------
+// DroneClockSync::DroneClockSync()
+// Description : Constructor of DroneClockSync class.
+// --------------------------------------------------------------------------
+DroneClockSync::DroneClockSync()
+{
+    version = 0;
+    clear();
+}
+
+// --------------------------------------------------------------------------
+// DroneClockSync::~DroneClockSync()
+// Description : Destructor of DroneClockSync class.
+// --------------------------------------------------------------------------
+DroneClockSync::~DroneClockSync()
+{
+}
+
+// --------------------------------------------------------------------------
+// DroneClockSync::clear()
+// Description : Forget the offsets, e.g. when the AR.Drone restarted.
+//               Must only be called by the thread calling update().
+// --------------------------------------------------------------------------
+void DroneClockSync::clear(void)
+{
+    numPoints = 0;
+    nextPoint = 0;
+    current.drone  = 0.0;
+    current.offset = 0.0;
+    start = -1.0;
+    last  = -1.0;
+    wraps = 0;
+    latest = -1.0;
+
+    // Nothing to map with
+    unsigned int v = version.load(std::memory_order_relaxed);
+    version.store(v + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    center = offset = skew = 0.0;
+    valid  = false;
+    version.store(v + 2, std::memory_order_release);
+}
+
+// --------------------------------------------------------------------------
+// DroneClockSync::update(NAVDATA_TIME stamp, Local time)
+// Description  : Add the stamp of a packet and the time it was received.
+//                Must only be called by one thread.
+// Return value : Time of the AR.Drone [s], the wraps of the stamp removed
+// --------------------------------------------------------------------------
+double DroneClockSync::update(unsigned int stamp, double local)
+{
+    // 11 bits of seconds and 21 bits of microseconds, the seconds wrap every 2048 s
+    double seconds = (stamp >> 21) + (stamp & 0x1FFFFF) * 1e-6;
+    if (last >= 0.0 && seconds < last) {
+        // Wrapped
+        if (last - seconds > 1024.0) wraps++;
+        // Restarted
+        else if (last - seconds > 1.0) clear();
+        // Reordered by the network, too late to tell about the delay
+        else return seconds + wraps * 2048.0;
+    }
+    last = seconds;
+    double drone = seconds + wraps * 2048.0;
+    latest = drone;
+
+    // Smallest offset of the period
+    double d = local - drone;
+    if (start < 0.0 || drone - start >= ARDRONE_CLOCK_WINDOW) {
+        if (start >= 0.0) {
+            points[nextPoint] = current;
+            nextPoint = (nextPoint + 1) % ARDRONE_CLOCK_WINDOWS;
+            if (numPoints < ARDRONE_CLOCK_WINDOWS) numPoints++;
+        }
+        start = drone;
+        current.drone  = drone;
+        current.offset = d;
+        fit();
+    }
+    else if (d < current.offset) {
+        current.drone  = drone;
+        current.offset = d;
+
+        // Only used until there are past periods
+        if (numPoints < 2) fit();
+    }
+
+    return drone;
+}
+
+// --------------------------------------------------------------------------
+// DroneClockSync::unwrap(Time since the AR.Drone booted)
+// Description  : Other stamps of the AR.Drone (e.g. PaVE, milliseconds since
+//                it booted) do not wrap after 2048 s, but the seconds of update()
+//                were unwrapped from 0 at the first stamp. The uptime modulo
+//                2048 s is put into the wrap closest to the latest stamp.
+//                May be called by any thread.
+// Return value : Time of the AR.Drone [s] as returned by update()
+// --------------------------------------------------------------------------
+double DroneClockSync::unwrap(double uptime) const
+{
+    double seconds = fmod(uptime, 2048.0);
+    double now = latest;
+    if (now < 0.0) return seconds;
+
+    // The same wrap, the one before or the one after
+    double drone = seconds + floor(now / 2048.0) * 2048.0;
+    if (drone - now >  1024.0) drone -= 2048.0;
+    if (now - drone >  1024.0) drone += 2048.0;
+    return drone;
+}
+
+// --------------------------------------------------------------------------
+// DroneClockSync::fit()
+// Description : Fit a line through the smallest offsets and publish it.
+// --------------------------------------------------------------------------
+void DroneClockSync::fit(void)
+{
+    double c, o, s = 0.0;
+    if (numPoints < 2) {
+        // Not enough for the skew yet, the smallest offset so far
+        Point best = current;
+        for (int i = 0; i < numPoints; i++) {
+            if (points[i].offset < best.offset) best = points[i];
+        }
+        c = best.drone;
+        o = best.offset;
+    }
+    else {
+        // Least squares around the mean time, the current period is left out
+        // because its smallest offset may still have a large delay
+        double sx = 0.0, sy = 0.0;
+        for (int i = 0; i < numPoints; i++) {
+            sx += points[i].drone;
+            sy += points[i].offset;
+        }
+        c = sx / numPoints;
+        o = sy / numPoints;
+        double sxx = 0.0, sxy = 0.0;
+        for (int i = 0; i < numPoints; i++) {
+            sxx += (points[i].drone - c) * (points[i].drone - c);
+            sxy += (points[i].drone - c) * (points[i].offset - o);
+        }
+        if (sxx > 0.0) s = sxy / sxx;
+    }
+
+    // An odd version tells the readers that the line is written
+    unsigned int v = version.load(std::memory_order_relaxed);
+    version.store(v + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    center = c;
+    offset = o;
+    skew   = s;
+    valid  = true;
+    version.store(v + 2, std::memory_order_release);
+}
+
+// --------------------------------------------------------------------------
+// DroneClockSync::map(Time of the AR.Drone, Local time)
+// Description  : Convert a time of the AR.Drone to the local time it had.
+// Return value : SUCCESS: 1  FAILURE (no stamps yet): 0
+// --------------------------------------------------------------------------
+int DroneClockSync::map(double drone, double *local) const
+{
+    double c, o, s;
+    bool ok;
+    while (1) {
+        unsigned int v = version.load(std::memory_order_acquire);
+        if (v & 1) continue;
+        c  = center;
+        o  = offset;
+        s  = skew;
+        ok = valid;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (version.load(std::memory_order_relaxed) == v) break;
+    }
+    if (!ok) return 0;
+
+    *local = drone + o + s * (drone - c);
+    return 1;
+}
@@ -41,147 +41,39 @@ int ARDrone::initCommand(void)
         return 0;
     }
 
-    // AR.Drone 2.0
-    if (version.major == ARDRONE_VERSION_2) {
-        // Send undocumented command
-        sockCommand.sendf("AT*PMODE=%d,%d\r", ++seq, 2);
-
-        // Send undocumented command
-        sockCommand.sendf("AT*MISC=%d,%d,%d,%d,%d\r", ++seq, 2, 20, 2000, 3000);
-
-        // Send flat trim
-        sockCommand.sendf("AT*FTRIM=%d,\r", ++seq);
-
-        // Set the configuration IDs
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"custom:session_id\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID);
-        msleep(500);
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"custom:profile_id\",\"%s\"\r", ++seq, ARDRONE_PROFILE_ID);
-        msleep(500);
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"custom:application_id\",\"%s\"\r", ++seq, ARDRONE_APPLOCATION_ID);
-        msleep(500);
-
-        // Set maximum velocity in Z-axis [mm/s]
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"control:control_vz_max\",\"%d\"\r", ++seq, 700);
-        msleep(100);
-
-        // Set maximum yaw [rad/s]
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"control:control_yaw\",\"%f\"\r", ++seq, 99.0 * DEG_TO_RAD);
-        msleep(100);
-
-        // Set maximum euler angle [rad]
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"control:euler_angle_max\",\"%f\"\r", ++seq, 12.0 * DEG_TO_RAD);
-        msleep(100);
-
-        // Set maximum altitude [mm]
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"control:altitude_max\",\"%d\"\r", ++seq, 3000);
-        msleep(100);
-
-        // Bitrate control mode
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"video:bitrate_ctrl_mode\",\"%d\"\r", ++seq, 0);     // VBC_MODE_DISABLED
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:bitrate_ctrl_mode\",\"%d\"\r", ++seq, 1);   // VBC_MODE_DYNAMIC
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:bitrate_ctrl_mode\",\"%d\"\r", ++seq, 2);   // VBC_MANUAL
-        msleep(100);
-
-        // Bitrate
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"video:bitrate\",\"%d\"\r", ++seq, 1000);
-        msleep(100);
-
-        // Max bitrate
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"video:max_bitrate\",\"%d\"\r", ++seq, 4000);
-        msleep(100);
-
-        // Set video codec
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", ++seq, 0x81);   // H264_360P_CODEC
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", ++seq, 0x82); // MP4_360P_H264_720P_CODEC
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", ++seq, 0x83); // H264_720P_CODEC
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", ++seq, 0x88); // MP4_360P_H264_360P_CODEC
-        msleep(100);
-
-        // Set video channel to default
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"video:video_channel\",\"0\"\r", ++seq);
-        msleep(100);
-
-        // Disable USB recording
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"video:video_on_usb\",\"FALSE\"\r", ++seq);
-        msleep(100);
-    }
-    // AR.Drone 1.0
-    else {
-        // Send undocumented command
-        sockCommand.sendf("AT*PMODE=%d,%d\r", ++seq, 2);
-
-        // Send undocumented command
-        sockCommand.sendf("AT*MISC=%d,%d,%d,%d,%d\r", ++seq, 2, 20, 2000, 3000);
-
-        // Send flat trim
-        sockCommand.sendf("AT*FTRIM=%d,\r", ++seq);
-
-        // Set maximum velocity in Z-axis [mm/s]
-        sockCommand.sendf("AT*CONFIG=%d,\"control:control_vz_max\",\"%d\"\r", ++seq, 700);
-        msleep(100);
-
-        // Set maximum yaw [rad/s]
-        sockCommand.sendf("AT*CONFIG=%d,\"control:control_yaw\",\"%f\"\r", ++seq, 99.0 * DEG_TO_RAD);
-        msleep(100);
-
-        // Set maximum euler angle [rad]
-        sockCommand.sendf("AT*CONFIG=%d,\"control:euler_angle_max\",\"%f\"\r", ++seq, 12.0 * DEG_TO_RAD);
-        msleep(100);
-
-        // Set maximum altitude [mm]
-        sockCommand.sendf("AT*CONFIG=%d,\"control:altitude_max\",\"%d\"\r", ++seq, 3000);
-        msleep(100);
-
-        // Bitrate control mode
-        sockCommand.sendf("AT*CONFIG=%d,\"video:bitrate_ctrl_mode\",\"%d\"\r", ++seq, 0);     // VBC_MODE_DISABLED
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:bitrate_ctrl_mode\",\"%d\"\r", ++seq, 1);   // VBC_MODE_DYNAMIC
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:bitrate_ctrl_mode\",\"%d\"\r", ++seq, 2);   // VBC_MANUAL
-        msleep(100);
-
-        // Bitrate
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:bitrate\",\"%d\"\r", ++seq, 1000);
-        //msleep(100);
-
-        // Max bitrate
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:max_bitrate\",\"%d\"\r", ++seq, 4000);
-        //msleep(100);
-
-        // Set video codec
-        sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", ++seq, 0x20);   // UVLC_CODEC
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", ++seq, 0x40); // P264_CODEC (not supported)
-        msleep(100);
-        
-        // Set video channel to default
-        sockCommand.sendf("AT*CONFIG=%d,\"video:video_channel\",\"0\"\r", ++seq);
-        msleep(100);
+    // Create mutexes
+    mutexSetpoint = new pthread_mutex_t;
+    pthread_mutex_init(mutexSetpoint, NULL);
+    mutexConfig = new pthread_mutex_t;
+    pthread_mutex_init(mutexConfig, NULL);
+
+    // Nothing sent yet
+    sentFlag = 0;
+    memset(sentSetpoint, 0, sizeof(sentSetpoint));
+    sentFlying = false;
+    keepalive = clock->now();
+
+    // Everything queued below is sent by a timer of the event loop
+    timerPeriod = commandPeriod;
+    bool timer = loopEvents.running() && loopEvents.setTimer(timerCommand, clock->now() + timerPeriod, timerPeriod);
+
+    // or by a thread
+    if (!timer) {
+        threadCommand = new pthread_t;
+        if (pthread_create(threadCommand, NULL, runCommand, this) != 0) {
+            CVDRONE_ERROR("pthread_create() was failed. (%s, %d)\n", __FILE__, __LINE__);
+            delete threadCommand;
+            threadCommand = NULL;
+            return 0;
+        }
     }
 
-    // Disable outdoor mode
-    setOutdoorMode(false);
+    // Send undocumented commands
+    queueCommand.push("PMODE", ",%d", 2);
+    queueCommand.push("MISC", ",%d,%d,%d,%d", 2, 20, 2000, 3000);
 
-    // Create a mutex
-    mutexCommand = new pthread_mutex_t;
-    pthread_mutex_init(mutexCommand, NULL);
-
-    // Create a thread
-    threadCommand = new pthread_t;
-    if (pthread_create(threadCommand, NULL, runCommand, this) != 0) {
-        CVDRONE_ERROR("pthread_create() was failed. (%s, %d)\n", __FILE__, __LINE__);
-        return 0;
-    }
+    // Send flat trim
+    queueCommand.push("FTRIM", ",");
 
     return 1;
 }
@@ -192,13 +84,193 @@ int ARDrone::initCommand(void)
 // --------------------------------------------------------------------------
 void ARDrone::loopCommand(void)
 {
+    double deadline = clock->now();
+
     while (1) {
-        // Reset Watch-Dog every 100ms
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*COMWDG=%d\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
+        // Wait for the next period, skip the missed ones
+        double period = commandPeriod;
+        deadline += period;
+        clock->sleepUntil(deadline);
+        double now = clock->now();
+        if (now - deadline > period) deadline = now;
+
+        // Do not get cancelled while sending
+        int state;
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+        updateCommand(now);
+        pthread_setcancelstate(state, NULL);
         pthread_testcancel();
-        msleep(100);
+    }
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Timer of the event loop for AT command.
+//! @param   args A pointer to the ARDrone
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::onCommandTimer(void *args)
+{
+    ARDrone *drone = reinterpret_cast<ARDrone*>(args);
+    double now = drone->clock->now();
+    drone->updateCommand(now);
+
+    // The rate was changed
+    double period = drone->commandPeriod;
+    if (period != drone->timerPeriod) {
+        drone->timerPeriod = period;
+        drone->loopEvents.setTimer(drone->timerCommand, now + period, period);
+    }
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Send the queued AT commands and the latest setpoint.
+//! @param   now Current time [s]
+//! @note    Once per period the queued commands and the latest setpoint are
+//!          sent in one datagram. An unchanged setpoint is only repeated
+//!          together with the watch-dog reset every ARDRONE_KEEPALIVE.
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::updateCommand(double now)
+{
+    // Latest setpoint
+    if (mutexSetpoint) pthread_mutex_lock(mutexSetpoint);
+    int   flag = setpointFlag;
+    float v[4] = {setpoint[0], setpoint[1], setpoint[2], setpoint[3]};
+    if (mutexSetpoint) pthread_mutex_unlock(mutexSetpoint);
+
+    // Reset Watch-Dog
+    bool alive = (now >= keepalive);
+    if (alive) {
+        queueCommand.pushCOMWDG();
+        keepalive = now + ARDRONE_KEEPALIVE;
+    }
+
+    // Send the setpoint if it changed, repeat it with the keep alive
+    if (!onGround()) {
+        bool changed = !sentFlying || flag != sentFlag || memcmp(v, sentSetpoint, sizeof(sentSetpoint)) != 0;
+        if ((changed || alive) && queueCommand.pushPCMD(flag, v[0], v[1], v[2], v[3])) {
+            sentFlag = flag;
+            memcpy(sentSetpoint, v, sizeof(sentSetpoint));
+        }
+        sentFlying = true;
+    }
+    else sentFlying = false;
+
+    // One datagram for everything
+    sendCommands();
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Set the rate the latest setpoint is sent at.
+//! @param   rate Rate [Hz], limited to 30-50 Hz
+//! @note    The AR.Drone expects a command at least every 30 ms,
+//!          faster than 50 Hz only adds traffic.
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::setCommandRate(double rate)
+{
+    commandPeriod = 1.0 / MIN(MAX(rate, 30.0), 50.0);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Send the queued AT commands.
+//! @note    Commands are packed into as few datagrams as possible and
+//!          numbered in the order they were queued.
+//! @return  Number of sent datagrams
+// --------------------------------------------------------------------------
+int ARDrone::sendCommands(void)
+{
+    char datagram[ARDRONE_AT_DATAGRAM_SIZE];
+    int n = 0;
+
+    size_t size;
+    while ((size = queueCommand.pack(datagram, sizeof(datagram), &seq)) > 0) {
+        sockCommand.send2(datagram, size);
+        n++;
+    }
+
+    return n;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Send a configuration and wait until it is acknowledged.
+//! @param   key Name of the configuration (e.g. "control:altitude_max")
+//! @param   format Format of the value, followed by the arguments
+//! @note    AR.Drone 2.0 needs AT*CONFIG_IDS in front, both are queued together.
+//!          The AR.Drone sets ARDRONE_COMMAND_MASK when a configuration was
+//!          applied, it is cleared with AT*CTRL=5 before the next one.
+//!          Without Navdata the configuration is sent without waiting.
+//! @return  Result of this function
+//! @retval  1 Acknowledged
+//! @retval  0 Not acknowledged after ARDRONE_CONFIG_RETRIES attempts
+// --------------------------------------------------------------------------
+int ARDrone::setConfig(const char *key, const char *format, ...)
+{
+    char value[128];
+
+    // Apply format
+    va_list arg;
+    va_start(arg, format);
+    vsnprintf(value, sizeof(value), format, arg);
+    va_end(arg);
+
+    // One configuration at a time
+    if (mutexConfig) pthread_mutex_lock(mutexConfig);
+
+    // Without Navdata there is nothing to wait for
+    int acknowledged = 0;
+    if (!threadNavdata && readerNavdata < 0) {
+        acknowledged = queueCommand.pushConfig(key, value, version.major == ARDRONE_VERSION_2);
+    }
+    else {
+        // Clear an old acknowledgement
+        if (!waitState(ARDRONE_COMMAND_MASK, false, 0.0)) {
+            queueCommand.push("CTRL", ",5,0");
+            waitState(ARDRONE_COMMAND_MASK, false, ARDRONE_CONFIG_TIMEOUT);
+        }
+
+        // Send until it is acknowledged
+        for (int i = 0; i < ARDRONE_CONFIG_RETRIES && !acknowledged; i++) {
+            if (!queueCommand.pushConfig(key, value, version.major == ARDRONE_VERSION_2)) break;
+            acknowledged = waitState(ARDRONE_COMMAND_MASK, true, ARDRONE_CONFIG_TIMEOUT);
+        }
+
+        // Clear the acknowledgement
+        queueCommand.push("CTRL", ",5,0");
+        waitState(ARDRONE_COMMAND_MASK, false, ARDRONE_CONFIG_TIMEOUT);
+    }
+
+    if (mutexConfig) pthread_mutex_unlock(mutexConfig);
+
+    if (!acknowledged) CVDRONE_ERROR("AT*CONFIG %s was not acknowledged. (%s, %d)\n", key, __FILE__, __LINE__);
+    return acknowledged;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Wait until state bits of Navdata are set or cleared.
+//! @param   mask State bits (ARDRONE_STATE_MASK)
+//! @param   set Wait for set (true) or cleared (false) bits
+//! @param   timeout Timeout [s]
+//! @return  Result of this function
+//! @retval  1 The state was reached
+//! @retval  0 Timeout
+// --------------------------------------------------------------------------
+int ARDrone::waitState(unsigned int mask, bool set, double timeout)
+{
+    double end = clock->now() + timeout;
+
+    while (1) {
+        // Get the state
+        bool state;
+        unsigned int version;
+        do {
+            version = beginNavdata();
+            state = (navdata.ardrone_state & mask) == mask;
+        } while (retryNavdata(version));
+
+        if (state == set) return 1;
+        if (clock->now() >= end) return 0;
+        clock->sleep(0.005);
     }
 }
 
@@ -208,18 +280,22 @@ void ARDrone::loopCommand(void)
 // --------------------------------------------------------------------------
 void ARDrone::takeoff(void)
 {
+    // Start with hovering
+    move3D(0.0, 0.0, 0.0, 0.0);
+
     // Get the state
-    if (mutexCommand) pthread_mutex_lock(mutexNavdata);
-    int state = navdata.ardrone_state;
-    if (mutexCommand) pthread_mutex_unlock(mutexNavdata);
+    int state;
+    unsigned int version;
+    do {
+        version = beginNavdata();
+        state = navdata.ardrone_state;
+    } while (retryNavdata(version));
 
     // If AR.Drone is in emergency, reset it
     if (state & ARDRONE_EMERGENCY_MASK) emergency();
     else {
         // Send take off
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*REF=%d,290718208\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
+        queueCommand.pushREF(290718208);
     }
 }
 
@@ -230,17 +306,18 @@ void ARDrone::takeoff(void)
 void ARDrone::landing(void)
 {
     // Get the state
-    if (mutexCommand) pthread_mutex_lock(mutexNavdata);
-    int state = navdata.ardrone_state;
-    if (mutexCommand) pthread_mutex_unlock(mutexNavdata);
+    int state;
+    unsigned int version;
+    do {
+        version = beginNavdata();
+        state = navdata.ardrone_state;
+    } while (retryNavdata(version));
 
     // If AR.Drone is in emergency, reset it
     if (state & ARDRONE_EMERGENCY_MASK) emergency();
     else {
         // Send langding
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*REF=%d,290717696\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
+        queueCommand.pushREF(290717696);
     }
 }
 
@@ -251,9 +328,7 @@ void ARDrone::landing(void)
 void ARDrone::emergency(void)
 {
     // Send emergency
-    if (mutexCommand) pthread_mutex_lock(mutexCommand);
-    sockCommand.sendf("AT*REF=%d,290717952\r", ++seq);
-    if (mutexCommand) pthread_mutex_unlock(mutexCommand);
+    queueCommand.pushREF(290717952);
 }
 
 // --------------------------------------------------------------------------
@@ -274,26 +349,25 @@ void ARDrone::move(double vx, double vy, double vr)
 //! @param   vy Y velocity [m/s]
 //! @param   vz Z velocity [m/s]
 //! @param   vr Angular velocity [rad/s]
+//! @note    Only the latest setpoint of a period is sent (see loopCommand).
 //! @return  None
 // --------------------------------------------------------------------------
 void ARDrone::move3D(double vx, double vy, double vz, double vr)
 {
-    // AR.Drone is flying
-    if (!onGround()) {
-        // Command velocities
-        float v[4] = {-0.2f * (float)vy, -0.2f * (float)vx, 1.0f * (float)vz, -0.5f * (float)vr};
-        int mode = (fabs(v[0]) > 0.0 || fabs(v[1]) > 0.0);
-
-        // Nomarization (-1.0 to +1.0)
-        for (int i = 0; i < 4; i++) {
-            if (fabs(v[i]) > 1.0) v[i] /= fabs(v[i]);
-        }
+    // Command velocities
+    float v[4] = {-0.2f * (float)vy, -0.2f * (float)vx, 1.0f * (float)vz, -0.5f * (float)vr};
+    int mode = (fabs(v[0]) > 0.0 || fabs(v[1]) > 0.0);
 
-        // Send a command
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*PCMD=%d,%d,%d,%d,%d,%d\r", ++seq, mode, *(int*)(&v[0]), *(int*)(&v[1]), *(int*)(&v[2]), *(int*)(&v[3]));
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
+    // Nomarization (-1.0 to +1.0)
+    for (int i = 0; i < 4; i++) {
+        if (fabs(v[i]) > 1.0) v[i] /= fabs(v[i]);
     }
+
+    // Store the setpoint, the thread for AT command sends it while flying
+    if (mutexSetpoint) pthread_mutex_lock(mutexSetpoint);
+    setpointFlag = mode;
+    memcpy(setpoint, v, sizeof(setpoint));
+    if (mutexSetpoint) pthread_mutex_unlock(mutexSetpoint);
 }
 
 // --------------------------------------------------------------------------
@@ -305,23 +379,14 @@ void ARDrone::move3D(double vx, double vy, double vz, double vr)
 // --------------------------------------------------------------------------
 void ARDrone::setCamera(int channel)
 {
-    // Enable mutex lock
-    if (mutexCommand) pthread_mutex_lock(mutexCommand);
-
     // AR.Drone 2.0
     if (version.major == ARDRONE_VERSION_2) {
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"video:video_channel\",\"%d\"\r", ++seq, channel % 2);
+        setConfig("video:video_channel", "%d", channel % 2);
     }
     // AR.Drone 1.0
     else {
-        sockCommand.sendf("AT*CONFIG=%d,\"video:video_channel\",\"%d\"\r", ++seq, channel % 4);
+        setConfig("video:video_channel", "%d", channel % 4);
     }
-
-    // Disable mutex lock
-    if (mutexCommand) pthread_mutex_unlock(mutexCommand);
-
-    msleep(100);
 }
 
 // --------------------------------------------------------------------------
@@ -332,9 +397,7 @@ void ARDrone::setFlatTrim(void)
 {
     if (onGround()) {
         // Send flat trim command
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*FTRIM=%d\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
+        queueCommand.push("FTRIM", "");
     }
 }
 
@@ -347,9 +410,7 @@ void ARDrone::setCalibration(int device)
 {
     if (!onGround()) {
         // Send calibration command
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*CALIB=%d,%d\r", ++seq, device);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
+        queueCommand.push("CALIB", ",%d", device);
     }
 }
 
@@ -372,9 +433,7 @@ void ARDrone::setAnimation(int id, int timeout)
     }
 
     // Send a command
-    if (mutexCommand) pthread_mutex_lock(mutexCommand);
-    sockCommand.sendf("AT*ANIM=%d,%d,%d\r", ++seq, id, timeout);
-    if (mutexCommand) pthread_mutex_unlock(mutexCommand);
+    queueCommand.push("ANIM", ",%d,%d", id, timeout);
 }
 
 // --------------------------------------------------------------------------
@@ -402,9 +461,7 @@ void ARDrone::setLED(int id, float freq, int duration)
     }
 
     // Send a command
-    if (mutexCommand) pthread_mutex_lock(mutexCommand);
-    sockCommand.sendf("AT*LED=%d,%d,%d,%d\r", ++seq, id, *(int*)(&freq), duration);
-    if (mutexCommand) pthread_mutex_unlock(mutexCommand);
+    queueCommand.push("LED", ",%d,%d,%d", id, *(int*)(&freq), duration);
 }
 
 // --------------------------------------------------------------------------
@@ -422,20 +479,12 @@ void ARDrone::setVideoRecord(bool activate)
         finalizeVideo();
 
         // Enable/Disable video recording
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        if (activate) sockCommand.sendf("AT*CONFIG=%d,\"video:video_on_usb\",\"TRUE\"\r",  ++seq);
-        else          sockCommand.sendf("AT*CONFIG=%d,\"video:video_on_usb\",\"FALSE\"\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
-        msleep(100);
+        if (activate) setConfig("video:video_on_usb", "TRUE");
+        else          setConfig("video:video_on_usb", "FALSE");
 
         // Output video with MP4_360P_H264_720P_CODEC / H264_360P_CODEC
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        if (activate) sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", ++seq, 0x82);
-        else          sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", ++seq, 0x81);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
-        msleep(100);
+        if (activate) setConfig("video:video_codec", "%d", 0x82);
+        else          setConfig("video:video_codec", "%d", 0x81);
 
         // Initialize video
         initVideo();
@@ -452,36 +501,22 @@ void ARDrone::setOutdoorMode(bool activate)
     // AR.Drone 2.0
     if (version.major == ARDRONE_VERSION_2) {
         // Enable/Disable outdoor mode
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        if (activate) sockCommand.sendf("AT*CONFIG=%d,\"control:outdoor\",\"TRUE\"\r",  ++seq);
-        else          sockCommand.sendf("AT*CONFIG=%d,\"control:outdoor\",\"FALSE\"\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
-        msleep(100);
+        if (activate) setConfig("control:outdoor", "TRUE");
+        else          setConfig("control:outdoor", "FALSE");
 
         // Without/With shell
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        if (activate) sockCommand.sendf("AT*CONFIG=%d,\"control:flight_without_shell\",\"TRUE\"\r",  ++seq);
-        else          sockCommand.sendf("AT*CONFIG=%d,\"control:flight_without_shell\",\"FALSE\"\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
-        msleep(100);
+        if (activate) setConfig("control:flight_without_shell", "TRUE");
+        else          setConfig("control:flight_without_shell", "FALSE");
     }
     // AR.Drone 1.0
     else {
         // Enable/Disable outdoor mode
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        if (activate) sockCommand.sendf("AT*CONFIG=%d,\"control:outdoor\",\"TRUE\"\r",  ++seq);
-        else          sockCommand.sendf("AT*CONFIG=%d,\"control:outdoor\",\"FALSE\"\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
-        msleep(100);
+        if (activate) setConfig("control:outdoor", "TRUE");
+        else          setConfig("control:outdoor", "FALSE");
 
         // Without/With shell
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        if (activate) sockCommand.sendf("AT*CONFIG=%d,\"control:flight_without_shell\",\"TRUE\"\r",  ++seq);
-        else          sockCommand.sendf("AT*CONFIG=%d,\"control:flight_without_shell\",\"FALSE\"\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
-        msleep(100);
+        if (activate) setConfig("control:flight_without_shell", "TRUE");
+        else          setConfig("control:flight_without_shell", "FALSE");
     }
 }
 
@@ -492,15 +527,16 @@ void ARDrone::setOutdoorMode(bool activate)
 void ARDrone::resetWatchDog(void)
 {
     // Get the state
-    if (mutexCommand) pthread_mutex_lock(mutexNavdata);
-    int state = navdata.ardrone_state;
-    if (mutexCommand) pthread_mutex_unlock(mutexNavdata);
+    int state;
+    unsigned int version;
+    do {
+        version = beginNavdata();
+        state = navdata.ardrone_state;
+    } while (retryNavdata(version));
 
     // If AR.Drone is in Watch-Dog, reset it
     if (state & ARDRONE_COM_WATCHDOG_MASK) {
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*COMWDG=%d\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
+        queueCommand.pushCOMWDG();
     }
 }
 
@@ -511,15 +547,16 @@ void ARDrone::resetWatchDog(void)
 void ARDrone::resetEmergency(void)
 {
     // Get the state
-    if (mutexCommand) pthread_mutex_lock(mutexNavdata);
-    int state = navdata.ardrone_state;
-    if (mutexCommand) pthread_mutex_unlock(mutexNavdata);
+    int state;
+    unsigned int version;
+    do {
+        version = beginNavdata();
+        state = navdata.ardrone_state;
+    } while (retryNavdata(version));
 
     // If AR.Drone is in emergency, reset it
     if (state & ARDRONE_EMERGENCY_MASK) {
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*REF=%d,290717952\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
+        queueCommand.pushREF(290717952);
     }
 }
 
@@ -537,11 +574,19 @@ void ARDrone::finalizeCommand(void)
         threadCommand = NULL;
     }
 
-    // Delete the mutex
-    if (mutexCommand) {
-        pthread_mutex_destroy(mutexCommand);
-        delete mutexCommand;
-        mutexCommand = NULL;
+    // Send the remaining commands (e.g. landing)
+    sendCommands();
+
+    // Delete the mutexes
+    if (mutexSetpoint) {
+        pthread_mutex_destroy(mutexSetpoint);
+        delete mutexSetpoint;
+        mutexSetpoint = NULL;
+    }
+    if (mutexConfig) {
+        pthread_mutex_destroy(mutexConfig);
+        delete mutexConfig;
+        mutexConfig = NULL;
     }
 
     // Close the socket
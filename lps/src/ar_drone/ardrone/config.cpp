@@ -206,14 +206,103 @@ void parse(const char *str, ARDRONE_CONFIG *config)
     }
 }
 
+// --------------------------------------------------------------------------
+//! @brief   Set the configurations used by CV Drone.
+//! @note    Each configuration is sent as soon as the previous one was
+//!          acknowledged, Navdata has to be running.
+//! @return  Result of initialization
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::initConfig(void)
+{
+    // AR.Drone 2.0
+    if (version.major == ARDRONE_VERSION_2) {
+        // Set maximum velocity in Z-axis [mm/s]
+        setConfig("control:control_vz_max", "%d", 700);
+
+        // Set maximum yaw [rad/s]
+        setConfig("control:control_yaw", "%f", 99.0 * DEG_TO_RAD);
+
+        // Set maximum euler angle [rad]
+        setConfig("control:euler_angle_max", "%f", 12.0 * DEG_TO_RAD);
+
+        // Set maximum altitude [mm]
+        setConfig("control:altitude_max", "%d", 3000);
+
+        // Bitrate control mode
+        setConfig("video:bitrate_ctrl_mode", "%d", 0);     // VBC_MODE_DISABLED
+        //setConfig("video:bitrate_ctrl_mode", "%d", 1);   // VBC_MODE_DYNAMIC
+        //setConfig("video:bitrate_ctrl_mode", "%d", 2);   // VBC_MANUAL
+
+        // Bitrate
+        setConfig("video:bitrate", "%d", 1000);
+
+        // Max bitrate
+        setConfig("video:max_bitrate", "%d", 4000);
+
+        // Set video codec
+        setConfig("video:video_codec", "%d", 0x81);   // H264_360P_CODEC
+        //setConfig("video:video_codec", "%d", 0x82); // MP4_360P_H264_720P_CODEC
+        //setConfig("video:video_codec", "%d", 0x83); // H264_720P_CODEC
+        //setConfig("video:video_codec", "%d", 0x88); // MP4_360P_H264_360P_CODEC
+
+        // Set video channel to default
+        setConfig("video:video_channel", "0");
+
+        // Disable USB recording
+        setConfig("video:video_on_usb", "FALSE");
+    }
+    // AR.Drone 1.0
+    else {
+        // Set maximum velocity in Z-axis [mm/s]
+        setConfig("control:control_vz_max", "%d", 700);
+
+        // Set maximum yaw [rad/s]
+        setConfig("control:control_yaw", "%f", 99.0 * DEG_TO_RAD);
+
+        // Set maximum euler angle [rad]
+        setConfig("control:euler_angle_max", "%f", 12.0 * DEG_TO_RAD);
+
+        // Set maximum altitude [mm]
+        setConfig("control:altitude_max", "%d", 3000);
+
+        // Bitrate control mode
+        setConfig("video:bitrate_ctrl_mode", "%d", 0);     // VBC_MODE_DISABLED
+        //setConfig("video:bitrate_ctrl_mode", "%d", 1);   // VBC_MODE_DYNAMIC
+        //setConfig("video:bitrate_ctrl_mode", "%d", 2);   // VBC_MANUAL
+
+        // Bitrate
+        //setConfig("video:bitrate", "%d", 1000);
+
+        // Max bitrate
+        //setConfig("video:max_bitrate", "%d", 4000);
+
+        // Set video codec
+        setConfig("video:video_codec", "%d", 0x20);   // UVLC_CODEC
+        //setConfig("video:video_codec", "%d", 0x40); // P264_CODEC (not supported)
+
+        // Set video channel to default
+        setConfig("video:video_channel", "0");
+    }
+
+    // Disable outdoor mode
+    setOutdoorMode(false);
+
+    return 1;
+}
+
 // --------------------------------------------------------------------------
 //! @brief   Get current configurations of AR.Drone.
+//! @param   configs Configurations to fill, NULL for the ones of this ARDrone
 //! @return  Result of this function
 //! @retval  1 Success
 //! @retval  0 Failure
 // --------------------------------------------------------------------------
-int ARDrone::getConfig(void)
+int ARDrone::getConfig(ARDRONE_CONFIG *configs)
 {
+    if (!configs) configs = &config;
+
     // Open the IP address and port
     TCPSocket sockConfig;
     if (!sockConfig.open(ip, ARDRONE_CONTROL_PORT)) {
@@ -221,17 +310,19 @@ int ARDrone::getConfig(void)
         return 0;
     }
 
-    // Send requests
-    UDPSocket tmpCommand;
-    tmpCommand.open(ip, ARDRONE_AT_PORT);
-    tmpCommand.sendf("AT*CTRL=%d,5,0\r", ++seq);
-    tmpCommand.sendf("AT*CTRL=%d,4,0\r", ++seq);
-    msleep(500);
-    tmpCommand.close();
+    // Send requests, not in the middle of setConfig (AT*CTRL=5 clears its acknowledgement)
+    if (mutexConfig) pthread_mutex_lock(mutexConfig);
+    queueCommand.push("CTRL", ",5,0");
+    queueCommand.push("CTRL", ",4,0");
 
-    // Receive data
+    // Receive data, it ends when the AR.Drone pauses for 100ms (see TCPSocket::open)
     char buf[10000] = {'\0'};
-    int size = sockConfig.receive((void*)&buf, sizeof(buf));
+    int size = 0;
+    double timeout = clock->now() + 1.0;
+    while (size == 0 && clock->now() < timeout) {
+        size = sockConfig.receive((void*)&buf, sizeof(buf) - 1);
+    }
+    if (mutexConfig) pthread_mutex_unlock(mutexConfig);
 
     // Received something
     if (size > 0) {
@@ -245,15 +336,20 @@ int ARDrone::getConfig(void)
         #endif
 
         // Clear config struct
-        memset(&config, 0, sizeof(config));
+        ARDRONE_CONFIG *received = new ARDRONE_CONFIG;
+        memset(received, 0, sizeof(ARDRONE_CONFIG));
 
         // Parsing configurations
         char *token = strtok(buf, "\n");
-        if (token != NULL) parse(token, &config);
+        if (token != NULL) parse(token, received);
         while (token != NULL) {
             token = strtok(NULL, "\n");
-            if (token != NULL) parse(token, &config);
+            if (token != NULL) parse(token, received);
         }
+
+        // Replace the configurations at once
+        *configs = *received;
+        delete received;
     }
 
     #if 0
@@ -0,0 +1,389 @@
+// -------------------------------------------------------------------------
+// CV Drone (= OpenCV + AR.Drone)
+// Copyright(C) 2016 puku0x
+// https://github.com/puku0x/cvdrone
+//
+// This source file is part of CV Drone library.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of EITHER:
+// (1) The GNU Lesser General Public License as published by the Free
+//     Software Foundation; either version 2.1 of the License, or (at
+//     your option) any later version. The text of the GNU Lesser
+//     General Public License is included with this library in the
+//     file cvdrone-license-LGPL.txt.
+// (2) The BSD-style license that is included with this library in
+//     the file cvdrone-license-BSD.txt.
+// 
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files
+// cvdrone-license-LGPL.txt and cvdrone-license-BSD.txt for more details.
+//
+//! @file   eventloop.cpp
+//! @brief  Event loop class
+//
+// -------------------------------------------------------------------------
+
+// One thread waits in epoll for all sockets and timers (timerfd) instead of
+// a thread per socket. An eventfd wakes it up to stop, so a handler is never
+// cancelled in the middle. Without epoll open() fails and the callers fall
+// back to their own threads. The handlers run with a recursive mutex held,
+// so a source removed by another thread is not used after remove() returned.
+
+#include "ardrone.h"
+
+#ifdef __linux__
+#include <stdint.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#endif
+
+// --------------------------------------------------------------------------
+// EventLoop::EventLoop()
+// Description : Constructor of EventLoop class.
+// --------------------------------------------------------------------------
+EventLoop::EventLoop()
+{
+    numSources = 0;
+    epoll = -1;
+    wakeup = -1;
+    quit = false;
+    thread = NULL;
+    cpu = -1;
+
+    // Handlers may remove their own source
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&mutexSources, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+// --------------------------------------------------------------------------
+// EventLoop::~EventLoop()
+// Description : Destructor of EventLoop class.
+// --------------------------------------------------------------------------
+EventLoop::~EventLoop()
+{
+    close();
+    pthread_mutex_destroy(&mutexSources);
+}
+
+// --------------------------------------------------------------------------
+// EventLoop::open()
+// Description  : Create the epoll instance and the eventfd to stop it.
+// Return value : SUCCESS: 1  FAILURE (or not supported): 0
+// --------------------------------------------------------------------------
+int EventLoop::open(void)
+{
+    #ifdef __linux__
+    // Already open
+    if (epoll >= 0) return 1;
+
+    epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll < 0) {
+        printf("ERROR: epoll_create1() failed. (%s, %d)\n", __FILE__, __LINE__);
+        return 0;
+    }
+
+    // Events without a source wake the loop up
+    wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    if (wakeup < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, wakeup, &event) < 0) {
+        printf("ERROR: eventfd() failed. (%s, %d)\n", __FILE__, __LINE__);
+        close();
+        return 0;
+    }
+
+    return 1;
+    #else
+    return 0;
+    #endif
+}
+
+// --------------------------------------------------------------------------
+// EventLoop::add(Descriptor, Timer, Handler, Arguments)
+// Description  : Watch a descriptor for reading.
+// Return value : SUCCESS: Number of the source  FAILURE: -1
+// --------------------------------------------------------------------------
+int EventLoop::add(int fd, bool timer, EventHandler handler, void *args)
+{
+    #ifdef __linux__
+    if (epoll < 0 || fd < 0) return -1;
+
+    pthread_mutex_lock(&mutexSources);
+
+    // A removed source is used again
+    int index = 0;
+    while (index < numSources && sources[index].fd >= 0) index++;
+    if (index >= ARDRONE_EVENT_SOURCES) {
+        pthread_mutex_unlock(&mutexSources);
+        return -1;
+    }
+
+    // The loop only sees the source after epoll_ctl()
+    Source *source = &sources[index];
+    source->fd      = fd;
+    source->timer   = timer;
+    source->handler = handler;
+    source->args    = args;
+
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = source;
+    if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+        printf("ERROR: epoll_ctl() failed. (%s, %d)\n", __FILE__, __LINE__);
+        source->fd = -1;
+        pthread_mutex_unlock(&mutexSources);
+        return -1;
+    }
+    if (index == numSources) numSources++;
+
+    pthread_mutex_unlock(&mutexSources);
+    return index;
+    #else
+    return -1;
+    #endif
+}
+
+// --------------------------------------------------------------------------
+// EventLoop::addReader(Socket, Handler, Arguments)
+// Description  : Call the handler in the loop whenever the socket can be read.
+// Return value : SUCCESS: Number of the source  FAILURE: -1
+// --------------------------------------------------------------------------
+int EventLoop::addReader(SOCKET sock, EventHandler handler, void *args)
+{
+    return add((int)sock, false, handler, args);
+}
+
+// --------------------------------------------------------------------------
+// EventLoop::remove(Source)
+// Description  : Stop watching a socket. The handler is not called any more
+//                once it returns, it waits for a handler that is running.
+//                The socket is left open.
+// Return value : SUCCESS: 1  FAILURE: 0
+// --------------------------------------------------------------------------
+int EventLoop::remove(int index)
+{
+    #ifdef __linux__
+    pthread_mutex_lock(&mutexSources);
+    if (index < 0 || index >= numSources || sources[index].timer || sources[index].fd < 0) {
+        pthread_mutex_unlock(&mutexSources);
+        return 0;
+    }
+
+    Source *source = &sources[index];
+    int result = 1;
+    if (epoll_ctl(epoll, EPOLL_CTL_DEL, source->fd, NULL) < 0) {
+        printf("ERROR: epoll_ctl() failed. (%s, %d)\n", __FILE__, __LINE__);
+        result = 0;
+    }
+    // Events of it already taken from epoll are ignored
+    source->fd      = -1;
+    source->handler = NULL;
+    pthread_mutex_unlock(&mutexSources);
+
+    return result;
+    #else
+    return 0;
+    #endif
+}
+
+// --------------------------------------------------------------------------
+// EventLoop::addTimer(Handler, Arguments)
+// Description  : Create a timer on the monotonic clock, see setTimer().
+// Return value : SUCCESS: Number of the timer  FAILURE: -1
+// --------------------------------------------------------------------------
+int EventLoop::addTimer(EventHandler handler, void *args)
+{
+    #ifdef __linux__
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (fd < 0) {
+        printf("ERROR: timerfd_create() failed. (%s, %d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    int timer = add(fd, true, handler, args);
+    if (timer < 0) ::close(fd);
+    return timer;
+    #else
+    return -1;
+    #endif
+}
+
+// --------------------------------------------------------------------------
+// EventLoop::setTimer(Timer, Time [s], Period [s])
+// Description  : Arm a timer at a time of CLOCK_MONOTONIC (MonotonicClock::now()),
+//                then every period. A period of 0 fires once, a time of 0 disarms it.
+//                Missed periods only call the handler once.
+// Return value : SUCCESS: 1  FAILURE: 0
+// --------------------------------------------------------------------------
+int EventLoop::setTimer(int timer, double time, double period)
+{
+    #ifdef __linux__
+    if (timer < 0 || timer >= numSources || !sources[timer].timer) return 0;
+
+    itimerspec spec;
+    spec.it_value.tv_sec     = (time_t)time;
+    spec.it_value.tv_nsec    = (long)((time - (time_t)time) * 1e9);
+    spec.it_interval.tv_sec  = (time_t)period;
+    spec.it_interval.tv_nsec = (long)((period - (time_t)period) * 1e9);
+    if (timerfd_settime(sources[timer].fd, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+        printf("ERROR: timerfd_settime() failed. (%s, %d)\n", __FILE__, __LINE__);
+        return 0;
+    }
+
+    return 1;
+    #else
+    return 0;
+    #endif
+}
+
+// --------------------------------------------------------------------------
+// EventLoop::start()
+// Description  : Run the loop in its own thread.
+// Return value : SUCCESS: 1  FAILURE: 0
+// --------------------------------------------------------------------------
+int EventLoop::start(void)
+{
+    if (epoll < 0) return 0;
+    if (thread) return 1;
+
+    quit = false;
+    thread = new pthread_t;
+    if (pthread_create(thread, NULL, run, this) != 0) {
+        printf("ERROR: pthread_create() failed. (%s, %d)\n", __FILE__, __LINE__);
+        delete thread;
+        thread = NULL;
+        return 0;
+    }
+
+    // Pin it if that was asked for before
+    if (cpu >= 0) setCPU(cpu);
+
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+// EventLoop::setCPU(CPU number)
+// Description  : Pin the thread to a CPU, e.g. one the camera does not use.
+// Return value : SUCCESS: 1  FAILURE: 0
+// --------------------------------------------------------------------------
+int EventLoop::setCPU(int cpu)
+{
+    this->cpu = cpu;
+    if (!thread) return 1;
+
+    #ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (cpu >= 0) CPU_SET(cpu, &set);
+    else {
+        long n = sysconf(_SC_NPROCESSORS_CONF);
+        for (long i = 0; i < n && i < CPU_SETSIZE; i++) CPU_SET(i, &set);
+    }
+    int error = pthread_setaffinity_np(*thread, sizeof(set), &set);
+    if (error) {
+        printf("ERROR: pthread_setaffinity_np(%d) failed: %s (%s, %d)\n", cpu, strerror(error), __FILE__, __LINE__);
+        return 0;
+    }
+    return 1;
+    #else
+    return 0;
+    #endif
+}
+
+// --------------------------------------------------------------------------
+// EventLoop::running()
+// Description  : Check whether the thread of the loop runs.
+// Return value : YES: true  NO: false
+// --------------------------------------------------------------------------
+bool EventLoop::running(void) const
+{
+    return thread != NULL;
+}
+
+// --------------------------------------------------------------------------
+// EventLoop::loop()
+// Description : Wait for the sources and call their handlers until stop().
+// --------------------------------------------------------------------------
+void EventLoop::loop(void)
+{
+    #ifdef __linux__
+    epoll_event events[ARDRONE_EVENT_SOURCES + 1];
+
+    while (!quit.load(std::memory_order_acquire)) {
+        int n = epoll_wait(epoll, events, ARDRONE_EVENT_SOURCES + 1, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            printf("ERROR: epoll_wait() failed. (%s, %d)\n", __FILE__, __LINE__);
+            break;
+        }
+
+        pthread_mutex_lock(&mutexSources);
+        for (int i = 0; i < n && !quit.load(std::memory_order_acquire); i++) {
+            // Woken up by stop(), or removed
+            Source *source = (Source*)events[i].data.ptr;
+            if (!source || !source->handler) continue;
+
+            // Take the expirations of a timer, the handler runs once for all of them
+            if (source->timer) {
+                uint64_t expirations;
+                if (read(source->fd, &expirations, sizeof(expirations)) != sizeof(expirations)) continue;
+            }
+
+            source->handler(source->args);
+        }
+        pthread_mutex_unlock(&mutexSources);
+    }
+    #endif
+}
+
+// --------------------------------------------------------------------------
+// EventLoop::stop()
+// Description : Stop the thread after the handler that is running returns.
+// --------------------------------------------------------------------------
+void EventLoop::stop(void)
+{
+    if (!thread) return;
+
+    quit.store(true, std::memory_order_release);
+    #ifdef __linux__
+    uint64_t one = 1;
+    if (write(wakeup, &one, sizeof(one)) != sizeof(one)) {
+        printf("ERROR: write() failed. (%s, %d)\n", __FILE__, __LINE__);
+    }
+    #endif
+
+    pthread_join(*thread, NULL);
+    delete thread;
+    thread = NULL;
+}
+
+// --------------------------------------------------------------------------
+// EventLoop::close()
+// Description : Stop the thread and close epoll and the timers.
+//               The sockets belong to the callers.
+// --------------------------------------------------------------------------
+void EventLoop::close(void)
+{
+    stop();
+
+    #ifdef __linux__
+    for (int i = 0; i < numSources; i++) {
+        if (sources[i].timer && sources[i].fd >= 0) ::close(sources[i].fd);
+    }
+    if (wakeup >= 0) ::close(wakeup);
+    if (epoll  >= 0) ::close(epoll);
+    #endif
+    numSources = 0;
+    wakeup = -1;
+    epoll = -1;
+}
@@ -0,0 +1,336 @@
+// -------------------------------------------------------------------------
+// CV Drone (= OpenCV + AR.Drone)
+// Copyright(C) 2016 puku0x
+// https://github.com/puku0x/cvdrone
+//
+// This source file is part of CV Drone library.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of EITHER:
+// (1) The GNU Lesser General Public License as published by the Free
+//     Software Foundation; either version 2.1 of the License, or (at
+//     your option) any later version. The text of the GNU Lesser
+//     General Public License is included with this library in the
+//     file cvdrone-license-LGPL.txt.
+// (2) The BSD-style license that is included with this library in
+//     the file cvdrone-license-BSD.txt.
+// 
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files
+// cvdrone-license-LGPL.txt and cvdrone-license-BSD.txt for more details.
+//
+//! @file   frame.cpp
+//! @brief  Video frame class
+//
+// -------------------------------------------------------------------------
+
+// A frame holds a reference to the buffers the decoder wrote, copying it
+// only adds a reference. The decoder allocates new buffers for the next
+// frames as long as a frame is held, so the pixels never change.
+
+#include "ardrone.h"
+
+// Context of the BGR conversion, every thread keeps its own and frees it when it ends
+struct FrameScaler {
+    SwsContext *context;
+    FrameScaler() : context(NULL) {}
+    ~FrameScaler() { sws_freeContext(context); }
+};
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::ARDRONE_FRAME()
+// Description : Constructor of ARDRONE_FRAME class.
+// --------------------------------------------------------------------------
+ARDRONE_FRAME::ARDRONE_FRAME()
+{
+    frame = NULL;
+    release();
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::ARDRONE_FRAME(Frame)
+// Description : Another reference to the same buffers.
+// --------------------------------------------------------------------------
+ARDRONE_FRAME::ARDRONE_FRAME(const ARDRONE_FRAME &other)
+{
+    frame = other.frame ? av_frame_clone(other.frame) : NULL;
+    stamp        = other.stamp;
+    receivedTime = other.receivedTime;
+    drone        = other.drone;
+    frameNumber  = other.frameNumber;
+    frameType    = other.frameType;
+    frameSequence = other.frameSequence;
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::operator =(Frame)
+// Description  : Drop the own reference and take another one.
+// Return value : This frame
+// --------------------------------------------------------------------------
+ARDRONE_FRAME& ARDRONE_FRAME::operator = (const ARDRONE_FRAME &other)
+{
+    if (this != &other) {
+        if (other.frame) {
+            if (!frame) frame = av_frame_alloc();
+            else av_frame_unref(frame);
+            if (!frame || av_frame_ref(frame, other.frame) < 0) {
+                release();
+                return *this;
+            }
+            stamp        = other.stamp;
+            receivedTime = other.receivedTime;
+            drone        = other.drone;
+            frameNumber  = other.frameNumber;
+            frameType    = other.frameType;
+            frameSequence = other.frameSequence;
+        }
+        else release();
+    }
+    return *this;
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::~ARDRONE_FRAME()
+// Description : Destructor of ARDRONE_FRAME class.
+// --------------------------------------------------------------------------
+ARDRONE_FRAME::~ARDRONE_FRAME()
+{
+    if (frame) av_frame_free(&frame);
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::empty()
+// Description  : Check whether there is a frame.
+// Return value : YES: true  NO: false
+// --------------------------------------------------------------------------
+bool ARDRONE_FRAME::empty(void) const
+{
+    return frame == NULL;
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::width()
+// Description  : Width of the frame.
+// Return value : Width [px] (0 if empty)
+// --------------------------------------------------------------------------
+int ARDRONE_FRAME::width(void) const
+{
+    return frame ? frame->width : 0;
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::height()
+// Description  : Height of the frame, the 8 lines H.264 adds to 360 are left out.
+// Return value : Height [px] (0 if empty)
+// --------------------------------------------------------------------------
+int ARDRONE_FRAME::height(void) const
+{
+    if (!frame) return 0;
+    return (frame->height == 368) ? 360 : frame->height;
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::time()
+// Description  : Time the frame was captured, the time it was received if the
+//                clock of the AR.Drone is not known yet.
+// Return value : Time [s] of the clock of ARDrone (0 if empty)
+// --------------------------------------------------------------------------
+double ARDRONE_FRAME::time(void) const
+{
+    return frame ? stamp : 0.0;
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::received()
+// Description  : Time the last byte of the frame was received.
+// Return value : Time [s] of the clock of ARDrone (0 if empty)
+// --------------------------------------------------------------------------
+double ARDRONE_FRAME::received(void) const
+{
+    return frame ? receivedTime : 0.0;
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::droneTime()
+// Description  : Time stamp of the AR.Drone in the PaVE header, on the clock
+//                of Navdata (see ARDrone::fromDroneTime) once it is synchronised.
+// Return value : Time [s] of the AR.Drone (negative if unknown)
+// --------------------------------------------------------------------------
+double ARDRONE_FRAME::droneTime(void) const
+{
+    return frame ? drone : -1.0;
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::number()
+// Description  : Frame number in the PaVE header.
+// Return value : Frame number (0 if unknown)
+// --------------------------------------------------------------------------
+unsigned int ARDRONE_FRAME::number(void) const
+{
+    return frame ? frameNumber : 0;
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::type()
+// Description  : Frame type in the PaVE header.
+// Return value : ARDRONE_FRAME_TYPE (ARDRONE_FRAME_UNKNOWN if unknown)
+// --------------------------------------------------------------------------
+int ARDRONE_FRAME::type(void) const
+{
+    return frame ? frameType : ARDRONE_FRAME_UNKNOWN;
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::sequence()
+// Description  : Number ARDrone counted the frame with, to tell newer frames.
+// Return value : Sequence number (0 if empty)
+// --------------------------------------------------------------------------
+unsigned int ARDRONE_FRAME::sequence(void) const
+{
+    return frame ? frameSequence : 0;
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::gray()
+// Description  : Luminance of the frame. For the formats of the decoder it is
+//                the Y plane itself, valid as long as a reference is held.
+// Return value : 8 bit image (empty if there is no frame)
+// --------------------------------------------------------------------------
+cv::Mat ARDRONE_FRAME::gray(void) const
+{
+    if (!frame) return cv::Mat();
+
+    switch (frame->format) {
+        // The first plane is the luminance
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+        case AV_PIX_FMT_NV12:
+        case AV_PIX_FMT_GRAY8:
+            return cv::Mat(height(), width(), CV_8UC1, frame->data[0], frame->linesize[0]);
+        // AR.Drone 1.0
+        case AV_PIX_FMT_BGR24: {
+            cv::Mat image;
+            cv::cvtColor(cv::Mat(height(), width(), CV_8UC3, frame->data[0], frame->linesize[0]), image, cv::COLOR_BGR2GRAY);
+            return image;
+        }
+        default: {
+            cv::Mat image;
+            cv::cvtColor(bgr(), image, cv::COLOR_BGR2GRAY);
+            return image;
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::bgr()
+// Description  : Convert the frame to BGR.
+// Return value : New image (empty if there is no frame)
+// --------------------------------------------------------------------------
+cv::Mat ARDRONE_FRAME::bgr(void) const
+{
+    cv::Mat image;
+    bgr(image);
+    return image;
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::bgr(Image)
+// Description : Convert the frame to BGR, straight into the image if it has
+//               the right size already.
+// --------------------------------------------------------------------------
+void ARDRONE_FRAME::bgr(cv::Mat &image) const
+{
+    if (!frame) {
+        image.release();
+        return;
+    }
+
+    int w = width(), h = height();
+    image.create(h, w, CV_8UC3);
+
+    // AR.Drone 1.0
+    if (frame->format == AV_PIX_FMT_BGR24) {
+        cv::Mat(h, w, CV_8UC3, frame->data[0], frame->linesize[0]).copyTo(image);
+        return;
+    }
+
+    // Every thread keeps its context, the size rarely changes
+    static thread_local FrameScaler scaler;
+    SwsContext *context = sws_getCachedContext(scaler.context, w, h, (AVPixelFormat)frame->format, w, h, AV_PIX_FMT_BGR24, SWS_SPLINE, NULL, NULL, NULL);
+    scaler.context = context;
+    if (!context) {
+        CVDRONE_ERROR("sws_getCachedContext() was failed. (%s, %d)\n", __FILE__, __LINE__);
+        return;
+    }
+
+    uint8_t *data[4] = {image.data, NULL, NULL, NULL};
+    int linesize[4] = {(int)image.step, 0, 0, 0};
+    sws_scale(context, (const uint8_t* const*)frame->data, frame->linesize, 0, h, data, linesize);
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::assign(Decoded frame, Packet it was decoded from)
+// Description  : Reference the buffers of a decoded frame, nothing is copied.
+// Return value : SUCCESS: 1  FAILURE: 0
+// --------------------------------------------------------------------------
+int ARDRONE_FRAME::assign(const AVFrame *src, const ARDRONE_VIDEO_PACKET *packet)
+{
+    if (!frame) frame = av_frame_alloc();
+    else av_frame_unref(frame);
+    if (!frame || av_frame_ref(frame, src) < 0) {
+        release();
+        return 0;
+    }
+
+    stamp        = packet->time;
+    receivedTime = packet->received;
+    drone        = packet->drone;
+    frameNumber  = packet->number;
+    frameType    = packet->type;
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::copy(BGR image, Width, Height, Time)
+// Description  : Copy a BGR image into new buffers (AR.Drone 1.0).
+// Return value : SUCCESS: 1  FAILURE: 0
+// --------------------------------------------------------------------------
+int ARDRONE_FRAME::copy(const uint8_t *bgr, int width, int height, double time)
+{
+    // New buffers, somebody else may still hold the old ones
+    release();
+    frame = av_frame_alloc();
+    if (!frame) return 0;
+    frame->format = AV_PIX_FMT_BGR24;
+    frame->width  = width;
+    frame->height = height;
+    if (av_frame_get_buffer(frame, 32) < 0) {
+        release();
+        return 0;
+    }
+
+    for (int y = 0; y < height; y++) {
+        memcpy(frame->data[0] + y * frame->linesize[0], bgr + y * width * 3, width * 3);
+    }
+
+    stamp        = time;
+    receivedTime = time;
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+// ARDRONE_FRAME::release()
+// Description : Drop the reference, the buffers are freed with the last one.
+// --------------------------------------------------------------------------
+void ARDRONE_FRAME::release(void)
+{
+    if (frame) av_frame_free(&frame);
+    frame = NULL;
+    stamp = receivedTime = 0.0;
+    drone = -1.0;
+    frameNumber = 0;
+    frameType   = ARDRONE_FRAME_UNKNOWN;
+    frameSequence = 0;
+}
@@ -43,46 +43,55 @@ int ARDrone::initNavdata(void)
 
     // Clear Navdata
     memset(&navdata, 0, sizeof(navdata));
+    memset(navdataBuffer, 0, sizeof(navdataBuffer));
+    navdataSize = 0;
+    navdataTime = 0.0;
+    historyNavdata.clear();
+    syncClock.clear();
+
+    // Wait for Navdata, but not forever, and know when it arrived
+    sockNavdata.setTimeout(ARDRONE_NAVDATA_TIMEOUT);
+    sockNavdata.enableTimestamps();
 
     // Start Navdata
     sockNavdata.sendf("\x01\x00\x00\x00");
 
-    // AR.Drone 2.0
-    if (version.major == ARDRONE_VERSION_2) {
-        // Disable BOOTSTRAP mode
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        //sockCommand.sendf("AT*CONFIG=%d,\"general:navdata_demo\",\"TRUE\"\r", ++seq);
-        sockCommand.sendf("AT*CONFIG=%d,\"general:navdata_demo\",\"FALSE\"\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
-        msleep(100);
-
-        // Seed ACK
-        sockCommand.sendf("AT*CTRL=%d,0\r", ++seq);
-    }
-    // AR.Drone 1.0
-    else {
-        // Disable BOOTSTRAP mode
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        //sockCommand.sendf("AT*CONFIG=%d,\"general:navdata_demo\",\"TRUE\"\r", ++seq);
-        sockCommand.sendf("AT*CONFIG=%d,\"general:navdata_demo\",\"FALSE\"\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
-
-        // Send ACK
-        sockCommand.sendf("AT*CTRL=%d,0\r", ++seq);
+    // Receive in the event loop, a timer requests it again if it stops
+    if (loopEvents.running() && sockNavdata.setNonBlocking(true)) {
+        readerNavdata = loopEvents.addReader(sockNavdata.getSocket(), onNavdataReceived, this);
+        if (readerNavdata < 0) sockNavdata.setNonBlocking(false);
+        else loopEvents.setTimer(timerNavdata, clock->now() + ARDRONE_NAVDATA_TIMEOUT, ARDRONE_NAVDATA_TIMEOUT);
     }
 
-    // Create a mutex
-    mutexNavdata = new pthread_mutex_t;
-    pthread_mutex_init(mutexNavdata, NULL);
+    // or in a thread
+    if (readerNavdata < 0) {
+        threadNavdata = new pthread_t;
+        if (pthread_create(threadNavdata, NULL, runNavdata, this) != 0) {
+            CVDRONE_ERROR("pthread_create() was failed. (%s, %d)\n", __FILE__, __LINE__);
+            delete threadNavdata;
+            threadNavdata = NULL;
+            return 0;
+        }
+    }
 
-    // Create a thread
-    threadNavdata = new pthread_t;
-    if (pthread_create(threadNavdata, NULL, runNavdata, this) != 0) {
-        CVDRONE_ERROR("pthread_create() was failed. (%s, %d)\n", __FILE__, __LINE__);
-        return 0;
+    // Create the session first, the acknowledgement is sent in BOOTSTRAP mode already
+    // and the configurations below are sent for this session
+    if (version.major == ARDRONE_VERSION_2) {
+        setConfig("custom:session_id", "%s", ARDRONE_SESSION_ID);
+        setConfig("custom:profile_id", "%s", ARDRONE_PROFILE_ID);
+        setConfig("custom:application_id", "%s", ARDRONE_APPLOCATION_ID);
     }
 
+    // Disable BOOTSTRAP mode, the state (and the acknowledgement) is sent in BOOTSTRAP mode too
+    //setConfig("general:navdata_demo", "TRUE");
+    setConfig("general:navdata_demo", "FALSE");
+
+    // Only the options somebody reads
+    pthread_mutex_lock(&mutexNavdataOptions);
+    navdataOptions = 0;
+    negotiateNavdata();
+    pthread_mutex_unlock(&mutexNavdataOptions);
+
     return 1;
 }
 
@@ -96,7 +105,30 @@ void ARDrone::loopNavdata(void)
         // Get Navdata
         if (!getNavdata()) break;
         pthread_testcancel();
-        msleep(10);
+    }
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Socket of Navdata can be read in the event loop.
+//! @param   args A pointer to the ARDrone
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::onNavdataReceived(void *args)
+{
+    reinterpret_cast<ARDrone*>(args)->getNavdata();
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Timer of the event loop for Navdata.
+//! @note    Requests Navdata again if nothing came for ARDRONE_NAVDATA_TIMEOUT.
+//! @param   args A pointer to the ARDrone
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::onNavdataTimer(void *args)
+{
+    ARDrone *drone = reinterpret_cast<ARDrone*>(args);
+    if (drone->clock->now() - drone->navdataTime >= ARDRONE_NAVDATA_TIMEOUT) {
+        drone->sockNavdata.sendf("\x01\x00\x00\x00");
     }
 }
 
@@ -108,138 +140,131 @@ void ARDrone::loopNavdata(void)
 // --------------------------------------------------------------------------
 int ARDrone::getNavdata(void)
 {
-    // Send a request
-    sockNavdata.sendf("\x01\x00\x00\x00");
+    // Wait for the next packet, the ones behind it come along
+    UDPMessage messages[ARDRONE_NAVDATA_BATCH];
+    for (int i = 0; i < ARDRONE_NAVDATA_BATCH; i++) {
+        messages[i].data = navdataBuffer[i].data;
+        messages[i].size = sizeof(navdataBuffer[i].data);
+    }
+    int count = sockNavdata.receive(messages, ARDRONE_NAVDATA_BATCH);
+    double now = clock->now();
 
-    // Receive data
-    char buf[4096] = {'\0'};
-    int size = sockNavdata.receive((void*)&buf, sizeof(buf));
-
-    // Received something
-    if (size > 0) {
-        // Enable mutex lock
-        if (mutexNavdata) pthread_mutex_lock(mutexNavdata);
-
-        // Header
-        int index = 0;
-        memcpy((void*)&(navdata.header),         (const void*)(buf + index), 4); index += 4;
-        memcpy((void*)&(navdata.ardrone_state),  (const void*)(buf + index), 4); index += 4;
-        memcpy((void*)&(navdata.sequence),       (const void*)(buf + index), 4); index += 4;
-        memcpy((void*)&(navdata.vision_defined), (const void*)(buf + index), 4); index += 4;
-
-        // Parse navdata
-        while (index < size) {
-            // Tag and data size
-            unsigned short tmp_tag, tmp_size;
-            memcpy((void*)&tmp_tag,  (const void*)(buf + index), 2); index += 2;  // tag
-            memcpy((void*)&tmp_size, (const void*)(buf + index), 2); index += 2;  // size
-            index -= 4;
-
-            // Copy to NAVDATA structure
-            switch (tmp_tag) {
-                case ARDRONE_NAVDATA_DEMO_TAG:
-                    memcpy((void*)&(navdata.demo),            (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.demo)));
-                    break;
-                case ARDRONE_NAVDATA_TIME_TAG:
-                    memcpy((void*)&(navdata.time),            (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.time)));
-                    break;
-                case ARDRONE_NAVDATA_RAW_MEASURES_TAG:
-                    memcpy((void*)&(navdata.raw_measures),    (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.raw_measures)));
-                    break;
-                case ARDRONE_NAVDATA_PHYS_MEASURES_TAG:
-                    memcpy((void*)&(navdata.phys_measures),   (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.phys_measures)));
-                    break;
-                case ARDRONE_NAVDATA_GYROS_OFFSETS_TAG:
-                    memcpy((void*)&(navdata.gyros_offsets),   (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.gyros_offsets)));
-                    break;
-                case ARDRONE_NAVDATA_EULER_ANGLES_TAG:
-                    memcpy((void*)&(navdata.euler_angles),    (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.euler_angles)));
-                    break;
-                case ARDRONE_NAVDATA_REFERENCES_TAG:
-                    memcpy((void*)&(navdata.references),      (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.references)));
-                    break;
-                case ARDRONE_NAVDATA_TRIMS_TAG:
-                    memcpy((void*)&(navdata.trims),           (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.trims)));
-                    break;
-                case ARDRONE_NAVDATA_RC_REFERENCES_TAG:
-                    memcpy((void*)&(navdata.rc_references),   (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.rc_references)));
-                    break;
-                case ARDRONE_NAVDATA_PWM_TAG:
-                    memcpy((void*)&(navdata.pwm),             (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.pwm)));
-                    break;
-                case ARDRONE_NAVDATA_ALTITUDE_TAG:
-                    memcpy((void*)&(navdata.altitude),        (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.altitude)));
-                    break;
-                case ARDRONE_NAVDATA_VISION_RAW_TAG:
-                    memcpy((void*)&(navdata.vision_raw),      (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.vision_raw)));
-                    break;
-                case ARDRONE_NAVDATA_VISION_OF_TAG:
-                    memcpy((void*)&(navdata.vision_of),       (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.vision_of)));
-                    break;
-                case ARDRONE_NAVDATA_VISION_TAG:
-                    memcpy((void*)&(navdata.vision),          (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.vision)));
-                    break;
-                case ARDRONE_NAVDATA_VISION_PERF_TAG:
-                    memcpy((void*)&(navdata.vision_perf),     (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.vision_perf)));
-                    break;
-                case ARDRONE_NAVDATA_TRACKERS_SEND_TAG:
-                    memcpy((void*)&(navdata.trackers_send),   (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.trackers_send)));
-                    break;
-                case ARDRONE_NAVDATA_VISION_DETECT_TAG:
-                    memcpy((void*)&(navdata.vision_detect),   (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.vision_detect)));
-                    break;
-                case ARDRONE_NAVDATA_WATCHDOG_TAG:
-                    memcpy((void*)&(navdata.watchdog),        (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.watchdog)));
-                    break;
-                case ARDRONE_NAVDATA_ADC_DATA_FRAME_TAG:
-                    memcpy((void*)&(navdata.adc_data_frame),  (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.adc_data_frame)));
-                    break;
-                case ARDRONE_NAVDATA_VIDEO_STREAM_TAG:
-                    memcpy((void*)&(navdata.video_stream),    (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.video_stream)));
-                    break;
-                case ARDRONE_NAVDATA_GAME_TAG:
-                    memcpy((void*)&(navdata.games),           (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.games)));
-                    break;
-                case ARDRONE_NAVDATA_PRESSURE_RAW_TAG:
-                    memcpy((void*)&(navdata.pressure_raw),    (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.pressure_raw)));
-                    break;
-                case ARDRONE_NAVDATA_MAGNETO_TAG:
-                    memcpy((void*)&(navdata.magneto),         (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.magneto)));
-                    break;
-                case ARDRONE_NAVDATA_WIND_TAG:
-                    memcpy((void*)&(navdata.wind),            (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.wind)));
-                    break;
-                case ARDRONE_NAVDATA_KALMAN_PRESSURE_TAG:
-                    memcpy((void*)&(navdata.kalman_pressure), (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.kalman_pressure)));
-                    break;
-                case ARDRONE_NAVDATA_HDVIDEO_STREAM_TAG:
-                    memcpy((void*)&(navdata.hdvideo_stream),  (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.hdvideo_stream)));
-                    break;
-                case ARDRONE_NAVDATA_WIFI_TAG:
-                    memcpy((void*)&(navdata.wifi),            (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.wifi)));
-                    break;
-                case ARDRONE_NAVDATA_GPS_TAG:
-                    if (version.major == 2 && version.minor == 4) memcpy((void*)&(navdata.gps),        (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.gps)));
-                    else                                          memcpy((void*)&(navdata.zimmu_3000), (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.zimmu_3000)));
-                    break;
-                case 28:
-                    break;
-                case 29:
-                    break;
-                default:
-                    memcpy((void*)&(navdata.cks),             (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.cks)));
-                    break;
-            }
-            index += tmp_size;
-        }
+    // Nothing came, request Navdata again (the event loop has a timer for it)
+    if (count <= 0) {
+        if (readerNavdata < 0) sockNavdata.sendf("\x01\x00\x00\x00");
+        return 1;
+    }
+
+    // Index the options, broken packets are dropped
+    int latest = -1;
+    for (int i = 0; i < count; i++) {
+        if (!navdataIndex(&navdataBuffer[i], messages[i].length)) continue;
+
+        // The time of the kernel is only meaningful on the monotonic clock
+        double received = (messages[i].time >= 0.0 && clock == Clock::monotonic()) ? messages[i].time : now;
+        recordNavdata(&navdataBuffer[i], received);
+        latest = i;
+    }
+    if (latest < 0) return 1;
+
+    // Hand the newest one to the readers
+    publishNavdata(&navdataBuffer[latest]);
 
-        // Disable mutex lock
-        if (mutexNavdata) pthread_mutex_unlock(mutexNavdata);
+    // The size only changes with the options, tell what they cost
+    unsigned int size = messages[latest].length;
+    if (navdataSize != size && !(navdataBuffer[latest].ardrone_state & ARDRONE_NAVDATA_BOOTSTRAP)) {
+        if (navdataSize) std::cout << "Navdata packets " << navdataSize << " -> " << size << " bytes." << std::endl;
+        navdataSize = size;
     }
 
     return 1;
 }
 
+// --------------------------------------------------------------------------
+//! @brief   Publish the indexed Navdata.
+//! @param   packet A pointer to the packet
+//! @note    Only the Navdata thread writes, readers never make it wait.
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::publishNavdata(const ARDRONE_NAVDATA_PACKET *packet)
+{
+    // An odd version tells the readers that a copy is in progress
+    unsigned int version = navdataVersion.load(std::memory_order_relaxed);
+    navdataVersion.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&navdata, packet, offsetof(ARDRONE_NAVDATA_PACKET, data));
+    memcpy(navdata.data, packet->data, packet->size);
+    navdataVersion.store(version + 2, std::memory_order_release);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Append the received Navdata to the history.
+//! @param   packet A pointer to the indexed packet
+//! @param   received Time it was received [s]
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::recordNavdata(const ARDRONE_NAVDATA_PACKET *packet, double received)
+{
+    // Only the Navdata thread uses the buffers, no lock
+    ARDRONE_NAVDATA::NAVDATA_TIME stamp;
+    ARDRONE_NAVDATA::NAVDATA_DEMO demo;
+    ARDRONE_NAVDATA::NAVDATA_ALTITUDE altitude;
+    navdataOption(packet, ARDRONE_NAVDATA_DEMO_TAG,     &demo,     sizeof(demo));
+    navdataOption(packet, ARDRONE_NAVDATA_ALTITUDE_TAG, &altitude, sizeof(altitude));
+
+    // Time the AR.Drone measured it, without the delay of the network,
+    // but never after it was received
+    double time = received;
+    if (navdataOption(packet, ARDRONE_NAVDATA_TIME_TAG, &stamp, sizeof(stamp))) {
+        double local;
+        if (syncClock.map(syncClock.update(stamp.time, received), &local) && local < received) time = local;
+    }
+
+    // The history is in time order
+    if (time <= navdataTime) time = navdataTime + 1e-6;
+    navdataTime = time;
+
+    // Same units as the getters
+    ARDRONE_NAVDATA_SAMPLE sample;
+    sample.time     = time;
+    sample.received = received;
+    sample.sequence = packet->sequence;
+    sample.state    = packet->ardrone_state;
+    sample.roll     =  demo.phi   * 0.001 * DEG_TO_RAD;
+    sample.pitch    = -demo.theta * 0.001 * DEG_TO_RAD;
+    sample.yaw      = -demo.psi   * 0.001 * DEG_TO_RAD;
+    sample.altitude =  demo.altitude * 0.001;
+    sample.vx       =  demo.vx * 0.001;
+    sample.vy       = -demo.vy * 0.001;
+    sample.vz       = -altitude.altitude_vz * 0.001;
+    historyNavdata.push(sample);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Start reading the published Navdata.
+//! @return  Version to pass to retryNavdata()
+// --------------------------------------------------------------------------
+unsigned int ARDrone::beginNavdata(void) const
+{
+    while (1) {
+        unsigned int version = navdataVersion.load(std::memory_order_acquire);
+        if (!(version & 1)) return version;
+    }
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Check whether the Navdata was published again while it was read.
+//! @param   version Version returned by beginNavdata()
+//! @return  Result of this function
+//! @retval  true  The values are torn, read them again
+//! @retval  false The values are consistent
+// --------------------------------------------------------------------------
+bool ARDrone::retryNavdata(unsigned int version) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return navdataVersion.load(std::memory_order_relaxed) != version;
+}
+
 // --------------------------------------------------------------------------
 //! @brief   Get current role angle of AR.Drone.
 //! @return  Role angle [rad]
@@ -247,11 +272,14 @@ int ARDrone::getNavdata(void)
 double ARDrone::getRoll(void)
 {
     // Get the data
-    if (mutexNavdata) pthread_mutex_lock(mutexNavdata);
-    double roll = navdata.demo.phi * 0.001 * DEG_TO_RAD;
-    if (mutexNavdata) pthread_mutex_unlock(mutexNavdata);
-
-    return roll;
+    ARDRONE_NAVDATA::NAVDATA_DEMO demo;
+    unsigned int version;
+    do {
+        version = beginNavdata();
+        navdataOption(&navdata, ARDRONE_NAVDATA_DEMO_TAG, &demo, sizeof(demo));
+    } while (retryNavdata(version));
+
+    return demo.phi * 0.001 * DEG_TO_RAD;
 }
 
 // --------------------------------------------------------------------------
@@ -261,11 +289,14 @@ double ARDrone::getRoll(void)
 double ARDrone::getPitch(void)
 {
     // Get the data
-    if (mutexNavdata) pthread_mutex_lock(mutexNavdata);
-    double pitch = -navdata.demo.theta * 0.001 * DEG_TO_RAD;
-    if (mutexNavdata) pthread_mutex_unlock(mutexNavdata);
-
-    return pitch;
+    ARDRONE_NAVDATA::NAVDATA_DEMO demo;
+    unsigned int version;
+    do {
+        version = beginNavdata();
+        navdataOption(&navdata, ARDRONE_NAVDATA_DEMO_TAG, &demo, sizeof(demo));
+    } while (retryNavdata(version));
+
+    return -demo.theta * 0.001 * DEG_TO_RAD;
 }
 
 // --------------------------------------------------------------------------
@@ -275,11 +306,14 @@ double ARDrone::getPitch(void)
 double ARDrone::getYaw(void)
 {
     // Get the data
-    if (mutexNavdata) pthread_mutex_lock(mutexNavdata);
-    double yaw = -navdata.demo.psi * 0.001 * DEG_TO_RAD;
-    if (mutexNavdata) pthread_mutex_unlock(mutexNavdata);
-
-    return yaw;
+    ARDRONE_NAVDATA::NAVDATA_DEMO demo;
+    unsigned int version;
+    do {
+        version = beginNavdata();
+        navdataOption(&navdata, ARDRONE_NAVDATA_DEMO_TAG, &demo, sizeof(demo));
+    } while (retryNavdata(version));
+
+    return -demo.psi * 0.001 * DEG_TO_RAD;
 }
 
 // --------------------------------------------------------------------------
@@ -289,11 +323,14 @@ double ARDrone::getYaw(void)
 double ARDrone::getAltitude(void)
 {
     // Get the data
-    if (mutexNavdata) pthread_mutex_lock(mutexNavdata);
-    double altitude = navdata.demo.altitude * 0.001;
-    if (mutexNavdata) pthread_mutex_unlock(mutexNavdata);
-
-    return altitude;
+    ARDRONE_NAVDATA::NAVDATA_DEMO demo;
+    unsigned int version;
+    do {
+        version = beginNavdata();
+        navdataOption(&navdata, ARDRONE_NAVDATA_DEMO_TAG, &demo, sizeof(demo));
+    } while (retryNavdata(version));
+
+    return demo.altitude * 0.001;
 }
 
 // --------------------------------------------------------------------------
@@ -306,12 +343,18 @@ double ARDrone::getAltitude(void)
 double ARDrone::getVelocity(double *vx, double *vy, double *vz)
 {
     // Get the data
-    if (mutexNavdata) pthread_mutex_lock(mutexNavdata);
-    double velocity_x =  navdata.demo.vx * 0.001;
-    double velocity_y = -navdata.demo.vy * 0.001;
-    //double velocity_z = -navdata.demo.vz * 0.001;
-    double velocity_z = -navdata.altitude.altitude_vz * 0.001;
-    if (mutexNavdata) pthread_mutex_unlock(mutexNavdata);
+    ARDRONE_NAVDATA::NAVDATA_DEMO demo;
+    ARDRONE_NAVDATA::NAVDATA_ALTITUDE altitude;
+    unsigned int version;
+    do {
+        version = beginNavdata();
+        navdataOption(&navdata, ARDRONE_NAVDATA_DEMO_TAG,     &demo,     sizeof(demo));
+        navdataOption(&navdata, ARDRONE_NAVDATA_ALTITUDE_TAG, &altitude, sizeof(altitude));
+    } while (retryNavdata(version));
+    double velocity_x =  demo.vx * 0.001;
+    double velocity_y = -demo.vy * 0.001;
+    //double velocity_z = -demo.vz * 0.001;
+    double velocity_z = -altitude.altitude_vz * 0.001;
 
     // Velocities
     if (vx) *vx = velocity_x;
@@ -336,12 +379,19 @@ double ARDrone::getVelocity(double *vx, double *vy, double *vz)
 int ARDrone::getPosition(double *latitude, double *longitude, double *elevation)
 {
     // Get the data
-    if (mutexNavdata) pthread_mutex_lock(mutexNavdata);
-    double gps_latitude  = navdata.gps.lat;
-    double gps_longitude = navdata.gps.lon;
-    double gps_elevation = navdata.gps.elevation;
-    int    available     = navdata.gps.data_available;
-    if (mutexNavdata) pthread_mutex_unlock(mutexNavdata);
+    ARDRONE_NAVDATA::NAVDATA_GPS gps;
+    unsigned int seqlock;
+    do {
+        seqlock = beginNavdata();
+        navdataOption(&navdata, ARDRONE_NAVDATA_GPS_TAG, &gps, sizeof(gps));
+    } while (retryNavdata(seqlock));
+
+    // The tag was used by ZIMMU 3000 before 2.4.1
+    if (version.major != 2 || version.minor != 4) memset(&gps, 0, sizeof(gps));
+    double gps_latitude  = gps.lat;
+    double gps_longitude = gps.lon;
+    double gps_elevation = gps.elevation;
+    int    available     = gps.data_available;
 
     // Positions
     if (latitude)  *latitude  = gps_latitude;
@@ -358,11 +408,153 @@ int ARDrone::getPosition(double *latitude, double *longitude, double *elevation)
 int ARDrone::getBatteryPercentage(void)
 {
     // Get the data
-    if (mutexNavdata) pthread_mutex_lock(mutexNavdata);
-    int battery = navdata.demo.vbat_flying_percentage;
-    if (mutexNavdata) pthread_mutex_unlock(mutexNavdata);
+    ARDRONE_NAVDATA::NAVDATA_DEMO demo;
+    unsigned int version;
+    do {
+        version = beginNavdata();
+        navdataOption(&navdata, ARDRONE_NAVDATA_DEMO_TAG, &demo, sizeof(demo));
+    } while (retryNavdata(version));
+
+    return demo.vbat_flying_percentage;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Ask the AR.Drone to send Navdata options.
+//! @param   options Options that are read, e.g. ARDRONE_NAVDATA_OPTION(ARDRONE_NAVDATA_DEMO_TAG)
+//! @note    Every component subscribes what it reads, the AR.Drone sends the union.
+//!          Before open() it only takes effect when connecting.
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::subscribeNavdata(unsigned int options)
+{
+    pthread_mutex_lock(&mutexNavdataOptions);
+    for (int i = 0; i < ARDRONE_NAVDATA_NUM_TAGS; i++) {
+        if (options & ARDRONE_NAVDATA_OPTION(i)) navdataSubscribers[i]++;
+    }
+    int result = negotiateNavdata();
+    pthread_mutex_unlock(&mutexNavdataOptions);
+
+    return result;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Stop asking for Navdata options.
+//! @param   options Options that were subscribed
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::unsubscribeNavdata(unsigned int options)
+{
+    pthread_mutex_lock(&mutexNavdataOptions);
+    for (int i = 0; i < ARDRONE_NAVDATA_NUM_TAGS; i++) {
+        if ((options & ARDRONE_NAVDATA_OPTION(i)) && navdataSubscribers[i] > 0) navdataSubscribers[i]--;
+    }
+    int result = negotiateNavdata();
+    pthread_mutex_unlock(&mutexNavdataOptions);
+
+    return result;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Get the Navdata options the AR.Drone sends.
+//! @return  Mask of the options (0 before open())
+// --------------------------------------------------------------------------
+unsigned int ARDrone::getNavdataOptions(void)
+{
+    pthread_mutex_lock(&mutexNavdataOptions);
+    unsigned int options = navdataOptions;
+    pthread_mutex_unlock(&mutexNavdataOptions);
+
+    return options;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Send the subscribed Navdata options if they changed.
+//! @note    Without any subscription all options are sent, like before.
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::negotiateNavdata(void)
+{
+    // Union of the subscriptions
+    unsigned int options = 0;
+    for (int i = 0; i < ARDRONE_NAVDATA_NUM_TAGS; i++) {
+        if (navdataSubscribers[i] > 0) options |= ARDRONE_NAVDATA_OPTION(i);
+    }
+    if (!options) options = ARDRONE_NAVDATA_ALL_OPTIONS;
 
-    return battery;
+    // The clock of the AR.Drone is synchronised with the time
+    options |= ARDRONE_NAVDATA_OPTION(ARDRONE_NAVDATA_TIME_TAG);
+
+    // Not connected or nothing changed
+    if ((!threadNavdata && readerNavdata < 0) || options == navdataOptions) return 1;
+
+    if (!setConfig("general:navdata_options", "%u", options)) return 0;
+    navdataOptions = options;
+
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Get the Navdata at a time in the past.
+//! @param   time Time [s] of the clock of ARDrone, e.g. when an image was captured
+//! @param   sample A pointer to the sample, interpolated between the two packets around the time
+//! @note    Samples are at the time the AR.Drone measured them.
+//!          After the newest packet its values are held, sample->time tells how old they are.
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure (no Navdata of that time)
+// --------------------------------------------------------------------------
+int ARDrone::getNavdataAt(double time, ARDRONE_NAVDATA_SAMPLE *sample)
+{
+    return historyNavdata.at(time, sample);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Get the Navdata received in a period.
+//! @param   from Start of the period [s]
+//! @param   to End of the period [s]
+//! @param   samples An array for the samples, the oldest first
+//! @param   max Size of the array
+//! @return  Number of samples
+// --------------------------------------------------------------------------
+int ARDrone::getNavdataWindow(double from, double to, ARDRONE_NAVDATA_SAMPLE *samples, int max)
+{
+    return historyNavdata.window(from, to, samples, max);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Convert a time of the clock of the AR.Drone.
+//! @param   drone Time of the AR.Drone [s], like NAVDATA_TIME without the wraps
+//! @param   local A pointer to the time [s] of the clock of ARDrone
+//! @note    The offset and the skew of the clocks are followed with every Navdata packet.
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure (no Navdata yet)
+// --------------------------------------------------------------------------
+int ARDrone::fromDroneTime(double drone, double *local)
+{
+    return syncClock.map(drone, local);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Convert a time since the AR.Drone booted (e.g. of a PaVE header) to local time.
+//! @param   uptime Time since the AR.Drone booted [s], not wrapped after 2048 s like the one of Navdata
+//! @param   drone Time of the AR.Drone on the clock of Navdata [s], may be NULL
+//! @param   local Time of the clock of ARDrone [s]
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure (the clocks are not synchronised yet)
+// --------------------------------------------------------------------------
+int ARDrone::fromDroneUptime(double uptime, double *drone, double *local)
+{
+    double t = syncClock.unwrap(uptime);
+    if (drone) *drone = t;
+    return syncClock.map(t, local);
 }
 
 // --------------------------------------------------------------------------
@@ -374,9 +566,12 @@ int ARDrone::getBatteryPercentage(void)
 int ARDrone::onGround(void)
 {
     // Get the data
-    if (mutexNavdata) pthread_mutex_lock(mutexNavdata);
-    int on_ground = (navdata.ardrone_state & ARDRONE_FLY_MASK) ? 0 : 1;
-    if (mutexNavdata) pthread_mutex_unlock(mutexNavdata);
+    int on_ground;
+    unsigned int version;
+    do {
+        version = beginNavdata();
+        on_ground = (navdata.ardrone_state & ARDRONE_FLY_MASK) ? 0 : 1;
+    } while (retryNavdata(version));
 
     return on_ground;
 }
@@ -395,13 +590,6 @@ void ARDrone::finalizeNavdata(void)
         threadNavdata = NULL;
     }
 
-    // Delete the mutex
-    if (mutexNavdata) {
-        pthread_mutex_destroy(mutexNavdata);
-        delete mutexNavdata;
-        mutexNavdata = NULL;
-    }
-
     // Close the socket
     sockNavdata.close();
 }
\ No newline at end of file
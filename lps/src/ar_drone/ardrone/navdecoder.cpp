@@ -0,0 +1,192 @@
+// -------------------------------------------------------------------------
+// CV Drone (= OpenCV + AR.Drone)
+// Copyright(C) 2016 puku0x
+// https://github.com/puku0x/cvdrone
+//
+// This source file is part of CV Drone library.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of EITHER:
+// (1) The GNU Lesser General Public License as published by the Free
+//     Software Foundation; either version 2.1 of the License, or (at
+//     your option) any later version. The text of the GNU Lesser
+//     General Public License is included with this library in the
+//     file cvdrone-license-LGPL.txt.
+// (2) The BSD-style license that is included with this library in
+//     the file cvdrone-license-BSD.txt.
+// 
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files
+// cvdrone-license-LGPL.txt and cvdrone-license-BSD.txt for more details.
+//
+//! @file   navdecoder.cpp
+//! @brief  Decoder of Navdata
+//
+// -------------------------------------------------------------------------
+
+#include "navdecoder.h"
+
+// Where the option of each tag goes in ARDRONE_NAVDATA, taken from the struct itself
+#define NAVDATA_OPTION(tag, member) { tag, offsetof(ARDRONE_NAVDATA, member), sizeof(((ARDRONE_NAVDATA*)0)->member) }
+static const struct {
+    int    tag;
+    size_t offset;
+    size_t size;
+} NAVDATA_OPTIONS[ARDRONE_NAVDATA_NUM_TAGS] = {
+    NAVDATA_OPTION(ARDRONE_NAVDATA_DEMO_TAG,            demo),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_TIME_TAG,            time),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_RAW_MEASURES_TAG,    raw_measures),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_PHYS_MEASURES_TAG,   phys_measures),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_GYROS_OFFSETS_TAG,   gyros_offsets),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_EULER_ANGLES_TAG,    euler_angles),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_REFERENCES_TAG,      references),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_TRIMS_TAG,           trims),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_RC_REFERENCES_TAG,   rc_references),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_PWM_TAG,             pwm),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_ALTITUDE_TAG,        altitude),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_VISION_RAW_TAG,      vision_raw),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_VISION_OF_TAG,       vision_of),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_VISION_TAG,          vision),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_VISION_PERF_TAG,     vision_perf),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_TRACKERS_SEND_TAG,   trackers_send),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_VISION_DETECT_TAG,   vision_detect),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_WATCHDOG_TAG,        watchdog),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_ADC_DATA_FRAME_TAG,  adc_data_frame),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_VIDEO_STREAM_TAG,    video_stream),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_GAME_TAG,            games),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_PRESSURE_RAW_TAG,    pressure_raw),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_MAGNETO_TAG,         magneto),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_WIND_TAG,            wind),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_KALMAN_PRESSURE_TAG, kalman_pressure),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_HDVIDEO_STREAM_TAG,  hdvideo_stream),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_WIFI_TAG,            wifi),
+    NAVDATA_OPTION(ARDRONE_NAVDATA_GPS_TAG,             gps),            // zimmu_3000 before 2.4.1, read it with navdataOption()
+};
+
+// --------------------------------------------------------------------------
+// navdataChecksum(Data, Size of data)
+// Description  : Check sum the AR.Drone sends in the NAVDATA_CKS option.
+// Return value : Sum of the bytes
+// --------------------------------------------------------------------------
+unsigned int navdataChecksum(const unsigned char *data, size_t size)
+{
+    unsigned int cks = 0;
+    size_t i = 0;
+
+    // Sixteen bytes at once, summed in two sets of four 16 bit lanes that are emptied
+    // before they overflow. The two sums do not wait for each other.
+    while (i + 16 <= size) {
+        unsigned long long lanes0 = 0, lanes1 = 0;
+        for (int n = 0; n < 128 && i + 16 <= size; n++, i += 16) {
+            unsigned long long word0, word1;
+            memcpy(&word0, data + i, 8);
+            memcpy(&word1, data + i + 8, 8);
+            lanes0 += (word0 & 0x00FF00FF00FF00FFULL) + ((word0 >> 8) & 0x00FF00FF00FF00FFULL);
+            lanes1 += (word1 & 0x00FF00FF00FF00FFULL) + ((word1 >> 8) & 0x00FF00FF00FF00FFULL);
+        }
+        lanes0 = (lanes0 & 0x0000FFFF0000FFFFULL) + ((lanes0 >> 16) & 0x0000FFFF0000FFFFULL);
+        lanes1 = (lanes1 & 0x0000FFFF0000FFFFULL) + ((lanes1 >> 16) & 0x0000FFFF0000FFFFULL);
+        lanes0 += lanes1;
+        cks += (unsigned int)(lanes0 + (lanes0 >> 32));
+    }
+
+    // The rest
+    for (; i < size; i++) cks += data[i];
+    return cks;
+}
+
+// --------------------------------------------------------------------------
+// navdataIndex(Packet, Size of packet)
+// Description  : Check a packet received into packet->data and note where
+//                its options are. Nothing is copied.
+// Return value : SUCCESS: 1  FAILURE (broken or wrong check sum): 0
+// --------------------------------------------------------------------------
+int navdataIndex(ARDRONE_NAVDATA_PACKET *packet, unsigned int size)
+{
+    const unsigned char *data = packet->data;
+
+    // Header
+    if (size < 16 || size > ARDRONE_NAVDATA_SIZE) return 0;
+    memcpy(&packet->header,         data +  0, 4);
+    memcpy(&packet->ardrone_state,  data +  4, 4);
+    memcpy(&packet->sequence,       data +  8, 4);
+    memcpy(&packet->vision_defined, data + 12, 4);
+    if (packet->header != ARDRONE_NAVDATA_HEADER) return 0;
+    packet->size = size;
+    memset(packet->offset, 0, sizeof(packet->offset));
+    memset(packet->length, 0, sizeof(packet->length));
+
+    // Options
+    unsigned int index = 16;
+    while (index + 4 <= size) {
+        // Tag and size
+        unsigned short tag, length;
+        memcpy(&tag,    data + index,     2);
+        memcpy(&length, data + index + 2, 2);
+        if (length < 4 || index + length > size) return 0;
+
+        // The check sum is the last option and covers all bytes before it
+        if (tag == ARDRONE_NAVDATA_CKS_TAG) {
+            unsigned int cks;
+            if (length < 8) return 0;
+            memcpy(&cks, data + index + 4, 4);
+            return navdataChecksum(data, index) == cks;
+        }
+
+        // Unknown tags are skipped
+        if (tag < ARDRONE_NAVDATA_NUM_TAGS) {
+            packet->offset[tag] = (unsigned short)index;
+            packet->length[tag] = length;
+        }
+        index += length;
+    }
+
+    // No check sum
+    return 0;
+}
+
+// --------------------------------------------------------------------------
+// navdataOption(Packet, Tag, Option, Size of option)
+// Description  : Copy an option out of an indexed packet. An option shorter
+//                than the struct (older firmware) is filled up with zeros.
+// Return value : SUCCESS: 1  FAILURE (not received): 0
+// --------------------------------------------------------------------------
+int navdataOption(const ARDRONE_NAVDATA_PACKET *packet, int tag, void *option, size_t size)
+{
+    // Not received, or beyond the packet because it was read while it changed
+    size_t offset = 0, length = 0;
+    if (tag >= 0 && tag < ARDRONE_NAVDATA_NUM_TAGS) {
+        offset = packet->offset[tag];
+        length = packet->length[tag] < size ? packet->length[tag] : size;
+    }
+    if (offset == 0 || offset + length > ARDRONE_NAVDATA_SIZE) {
+        memset(option, 0, size);
+        return 0;
+    }
+
+    memcpy(option, packet->data + offset, length);
+    if (length < size) memset((char*)option + length, 0, size - length);
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+// navdataDecode(Packet, Navdata)
+// Description : Copy the header and every received option of an indexed
+//               packet into ARDRONE_NAVDATA. Options that were not received
+//               keep their values.
+// --------------------------------------------------------------------------
+void navdataDecode(const ARDRONE_NAVDATA_PACKET *packet, ARDRONE_NAVDATA *navdata)
+{
+    // Header
+    navdata->header         = packet->header;
+    navdata->ardrone_state  = packet->ardrone_state;
+    navdata->sequence       = packet->sequence;
+    navdata->vision_defined = packet->vision_defined;
+
+    // Options
+    for (int i = 0; i < ARDRONE_NAVDATA_NUM_TAGS; i++) {
+        if (packet->offset[i] == 0) continue;
+        navdataOption(packet, NAVDATA_OPTIONS[i].tag, (char*)navdata + NAVDATA_OPTIONS[i].offset, NAVDATA_OPTIONS[i].size);
+    }
+}
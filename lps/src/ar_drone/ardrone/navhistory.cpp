@@ -0,0 +1,189 @@
+// -------------------------------------------------------------------------
+// CV Drone (= OpenCV + AR.Drone)
+// Copyright(C) 2016 puku0x
+// https://github.com/puku0x/cvdrone
+//
+// This source file is part of CV Drone library.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of EITHER:
+// (1) The GNU Lesser General Public License as published by the Free
+//     Software Foundation; either version 2.1 of the License, or (at
+//     your option) any later version. The text of the GNU Lesser
+//     General Public License is included with this library in the
+//     file cvdrone-license-LGPL.txt.
+// (2) The BSD-style license that is included with this library in
+//     the file cvdrone-license-BSD.txt.
+// 
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files
+// cvdrone-license-LGPL.txt and cvdrone-license-BSD.txt for more details.
+//
+//! @file   navhistory.cpp
+//! @brief  Navdata history class
+//
+// -------------------------------------------------------------------------
+
+// Ring of the latest samples. Every slot is guarded by its own sequence
+// lock, readers copy a slot and retry if the Navdata thread wrote it meanwhile.
+
+#include "ardrone.h"
+
+// --------------------------------------------------------------------------
+// NavdataHistory::NavdataHistory()
+// Description : Constructor of NavdataHistory class.
+// --------------------------------------------------------------------------
+NavdataHistory::NavdataHistory()
+{
+    for (size_t i = 0; i < ARDRONE_NAVDATA_HISTORY; i++) {
+        slots[i].version = 0;
+        slots[i].index = (size_t)-1;
+        memset(&slots[i].sample, 0, sizeof(slots[i].sample));
+    }
+    count = 0;
+}
+
+// --------------------------------------------------------------------------
+// NavdataHistory::~NavdataHistory()
+// Description : Destructor of NavdataHistory class.
+// --------------------------------------------------------------------------
+NavdataHistory::~NavdataHistory()
+{
+}
+
+// --------------------------------------------------------------------------
+// NavdataHistory::push(Sample)
+// Description : Append a sample, the oldest one is overwritten.
+//               Must only be called by one thread.
+// --------------------------------------------------------------------------
+void NavdataHistory::push(const ARDRONE_NAVDATA_SAMPLE &sample)
+{
+    size_t n = count.load(std::memory_order_relaxed);
+    Slot &slot = slots[n % ARDRONE_NAVDATA_HISTORY];
+
+    // An odd version tells the readers that the slot is written
+    unsigned int version = slot.version.load(std::memory_order_relaxed);
+    slot.version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.index  = n;
+    slot.sample = sample;
+    slot.version.store(version + 2, std::memory_order_release);
+
+    count.store(n + 1, std::memory_order_release);
+}
+
+// --------------------------------------------------------------------------
+// NavdataHistory::read(Number of the sample, Sample)
+// Description  : Copy a sample out of its slot.
+// Return value : SUCCESS: 1  FAILURE (already overwritten): 0
+// --------------------------------------------------------------------------
+int NavdataHistory::read(size_t index, ARDRONE_NAVDATA_SAMPLE *sample) const
+{
+    const Slot &slot = slots[index % ARDRONE_NAVDATA_HISTORY];
+    while (1) {
+        unsigned int version = slot.version.load(std::memory_order_acquire);
+        if (version & 1) continue;
+        size_t written = slot.index;
+        *sample = slot.sample;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.version.load(std::memory_order_relaxed) == version) return written == index;
+    }
+}
+
+// --------------------------------------------------------------------------
+// NavdataHistory::at(Time, Sample)
+// Description  : Interpolate attitude, altitude and velocity at a time
+//                between two samples. After the newest sample it is held,
+//                the time of the sample tells how old it is.
+// Return value : SUCCESS: 1  FAILURE (no samples or older than all): 0
+// --------------------------------------------------------------------------
+int NavdataHistory::at(double time, ARDRONE_NAVDATA_SAMPLE *sample) const
+{
+    // Nothing yet
+    size_t end = count.load(std::memory_order_acquire);
+    if (end == 0) return 0;
+
+    // Newer than all samples
+    ARDRONE_NAVDATA_SAMPLE a, b;
+    if (!read(end - 1, &b)) return 0;
+    if (time >= b.time) {
+        *sample = b;
+        return 1;
+    }
+
+    // Older than all samples, the oldest slot may just be overwritten
+    size_t lo = end > ARDRONE_NAVDATA_HISTORY ? end - ARDRONE_NAVDATA_HISTORY + 1 : 0;
+    size_t hi = end - 1;
+    if (!read(lo, &a) || time < a.time) return 0;
+
+    // The last sample at or before the time, samples are in time order
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        ARDRONE_NAVDATA_SAMPLE m;
+        if (!read(mid, &m)) return 0;
+        if (m.time <= time) lo = mid;
+        else                hi = mid;
+    }
+    if (!read(lo, &a) || !read(hi, &b)) return 0;
+
+    // Interpolate, the yaw the short way round
+    double w = (b.time > a.time) ? (time - a.time) / (b.time - a.time) : 0.0;
+    double dyaw = b.yaw - a.yaw;
+    if (dyaw >  M_PI) dyaw -= 2.0 * M_PI;
+    if (dyaw < -M_PI) dyaw += 2.0 * M_PI;
+
+    *sample = a;
+    sample->time     = time;
+    sample->roll     = a.roll     + w * (b.roll     - a.roll);
+    sample->pitch    = a.pitch    + w * (b.pitch    - a.pitch);
+    sample->yaw      = a.yaw      + w * dyaw;
+    sample->altitude = a.altitude + w * (b.altitude - a.altitude);
+    sample->vx       = a.vx       + w * (b.vx       - a.vx);
+    sample->vy       = a.vy       + w * (b.vy       - a.vy);
+    sample->vz       = a.vz       + w * (b.vz       - a.vz);
+    if (sample->yaw >  M_PI) sample->yaw -= 2.0 * M_PI;
+    if (sample->yaw < -M_PI) sample->yaw += 2.0 * M_PI;
+
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+// NavdataHistory::window(From, To, Samples, Maximum number of samples)
+// Description  : Copy the samples received in [from, to], the oldest first.
+// Return value : Number of samples copied
+// --------------------------------------------------------------------------
+int NavdataHistory::window(double from, double to, ARDRONE_NAVDATA_SAMPLE *samples, int max) const
+{
+    size_t end = count.load(std::memory_order_acquire);
+    size_t begin = end > ARDRONE_NAVDATA_HISTORY ? end - ARDRONE_NAVDATA_HISTORY + 1 : 0;
+
+    int n = 0;
+    for (size_t i = begin; i < end && n < max; i++) {
+        // Overwritten samples were older anyway
+        if (!read(i, &samples[n])) continue;
+        if (samples[n].time > to) break;
+        if (samples[n].time >= from) n++;
+    }
+    return n;
+}
+
+// --------------------------------------------------------------------------
+// NavdataHistory::clear()
+// Description : Forget all samples. Must only be called by the writer.
+//               The numbering starts again, so the range readers search is
+//               only made of new samples. A reader still using the old count
+//               finds numbers that do not match the slots and fails.
+// --------------------------------------------------------------------------
+void NavdataHistory::clear(void)
+{
+    count.store(0, std::memory_order_release);
+    for (size_t i = 0; i < ARDRONE_NAVDATA_HISTORY; i++) {
+        Slot &slot = slots[i];
+        unsigned int version = slot.version.load(std::memory_order_relaxed);
+        slot.version.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.index = (size_t)-1;
+        slot.version.store(version + 2, std::memory_order_release);
+    }
+}
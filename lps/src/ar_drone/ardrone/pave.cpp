@@ -0,0 +1,279 @@
+// -------------------------------------------------------------------------
+// CV Drone (= OpenCV + AR.Drone)
+// Copyright(C) 2016 puku0x
+// https://github.com/puku0x/cvdrone
+//
+// This source file is part of CV Drone library.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of EITHER:
+// (1) The GNU Lesser General Public License as published by the Free
+//     Software Foundation; either version 2.1 of the License, or (at
+//     your option) any later version. The text of the GNU Lesser
+//     General Public License is included with this library in the
+//     file cvdrone-license-LGPL.txt.
+// (2) The BSD-style license that is included with this library in
+//     the file cvdrone-license-BSD.txt.
+// 
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files
+// cvdrone-license-LGPL.txt and cvdrone-license-BSD.txt for more details.
+//
+//! @file   pave.cpp
+//! @brief  PaVE reader class
+//
+// -------------------------------------------------------------------------
+
+// The AR.Drone 2.0 sends every H.264 frame behind a PaVE header with its
+// size, number, type and time stamp. Whole frames are read into a few
+// buffers that are reused, so the decoder gets them without probing or
+// copying, and a frame can be left out before it is decoded.
+
+#include "ardrone.h"
+
+// Zeroed bytes the decoder may read behind a frame
+#ifdef AV_INPUT_BUFFER_PADDING_SIZE
+#define PAVE_PADDING AV_INPUT_BUFFER_PADDING_SIZE
+#else
+#define PAVE_PADDING FF_INPUT_BUFFER_PADDING_SIZE
+#endif
+
+// Larger frames are taken for a broken header
+#define PAVE_MAX_PAYLOAD (4 * 1024 * 1024)
+
+// Bytes up to the frame type, a header must at least have them
+#define PAVE_MIN_HEADER  (offsetof(ARDRONE_PAVE_HEADER, control))
+
+// --------------------------------------------------------------------------
+// PaVEReader::PaVEReader()
+// Description : Constructor of PaVEReader class.
+// --------------------------------------------------------------------------
+PaVEReader::PaVEReader()
+{
+    clock = Clock::monotonic();
+    memset(pool, 0, sizeof(pool));
+    first = NULL;
+    imageWidth = imageHeight = 0;
+    close();
+}
+
+// --------------------------------------------------------------------------
+// PaVEReader::~PaVEReader()
+// Description : Destructor of PaVEReader class.
+// --------------------------------------------------------------------------
+PaVEReader::~PaVEReader()
+{
+    close();
+    for (int i = 0; i < ARDRONE_VIDEO_BUFFERS; i++) {
+        if (pool[i].data) av_free(pool[i].data);
+        pool[i].data = NULL;
+        pool[i].capacity = 0;
+    }
+}
+
+// --------------------------------------------------------------------------
+// PaVEReader::open(IP address, Port number, Clock)
+// Description  : Connect to the video port and wait for the first frame,
+//                it tells the size of the images.
+// Return value : SUCCESS: 1  FAILURE: 0
+// --------------------------------------------------------------------------
+int PaVEReader::open(const char *addr, int port, Clock *clock)
+{
+    close();
+    this->clock = clock ? clock : Clock::monotonic();
+
+    // Connect
+    if (!sock.open(addr, port)) {
+        printf("ERROR: TCPSocket::open() failed. (%s, %d)\n", __FILE__, __LINE__);
+        return 0;
+    }
+
+    // The first frame
+    double start = this->clock->now();
+    while (this->clock->now() - start < ARDRONE_VIDEO_TIMEOUT) {
+        ARDRONE_VIDEO_PACKET *packet;
+        int result = read(&packet);
+        if (result < 0) break;
+        if (result > 0) {
+            first = packet;
+            imageWidth  = packet->width;
+            imageHeight = packet->height;
+            return 1;
+        }
+    }
+
+    printf("ERROR: No video from the AR.Drone. (%s, %d)\n", __FILE__, __LINE__);
+    close();
+    return 0;
+}
+
+// --------------------------------------------------------------------------
+// PaVEReader::read(Frame)
+// Description  : Read until a frame is complete. A frame stays valid for
+//                ARDRONE_VIDEO_BUFFERS - 1 more calls.
+// Return value : SUCCESS: 1  NOT YET (timeout, or empty if non-blocking): 0  FAILURE (closed): -1
+// --------------------------------------------------------------------------
+int PaVEReader::read(ARDRONE_VIDEO_PACKET **packet)
+{
+    // The frame open() waited for
+    if (first) {
+        *packet = first;
+        first = NULL;
+        return 1;
+    }
+
+    static const uint8_t signature[4] = {'P', 'a', 'V', 'E'};
+    uint8_t *bytes = (uint8_t*)&header;
+    ARDRONE_VIDEO_PACKET *current = &pool[next];
+
+    while (1) {
+        // Header
+        if (headerFilled < (int)sizeof(header)) {
+            int n = sock.receiveSome(bytes + headerFilled, sizeof(header) - headerFilled);
+            if (n <= 0) return n;
+            headerFilled += n;
+
+            // Drop everything in front of the signature (the stream started within a frame)
+            int start = 0;
+            while (start < headerFilled) {
+                int m = (headerFilled - start < 4) ? headerFilled - start : 4;
+                if (memcmp(bytes + start, signature, m) == 0) break;
+                start++;
+            }
+            if (start > 0) {
+                memmove(bytes, bytes + start, headerFilled - start);
+                headerFilled -= start;
+            }
+            if (headerFilled < (int)sizeof(header)) continue;
+
+            // Not a header after all, look for the next signature
+            if (header.header_size < PAVE_MIN_HEADER || header.payload_size > PAVE_MAX_PAYLOAD) {
+                memmove(bytes, bytes + 1, --headerFilled);
+                continue;
+            }
+
+            // A buffer for the frame
+            int capacity = header.payload_size + PAVE_PADDING;
+            if (current->capacity < capacity) {
+                if (current->data) av_free(current->data);
+                current->data = (uint8_t*)av_malloc(capacity);
+                if (!current->data) {
+                    printf("ERROR: av_malloc() failed. (%s, %d)\n", __FILE__, __LINE__);
+                    current->capacity = 0;
+                    return -1;
+                }
+                current->capacity = capacity;
+            }
+
+            // A shorter header, the frame already started
+            payloadFilled = 0;
+            headerSkip = 0;
+            if (header.header_size < sizeof(header)) {
+                payloadFilled = sizeof(header) - header.header_size;
+                if (payloadFilled > (int)header.payload_size) payloadFilled = header.payload_size;
+                memcpy(current->data, bytes + header.header_size, payloadFilled);
+            }
+            // A longer one
+            else headerSkip = header.header_size - sizeof(header);
+        }
+
+        // Rest of a longer header
+        if (headerSkip > 0) {
+            uint8_t skip[256];
+            int n = sock.receiveSome(skip, (headerSkip < (int)sizeof(skip)) ? headerSkip : sizeof(skip));
+            if (n <= 0) return n;
+            headerSkip -= n;
+            continue;
+        }
+
+        // Frame
+        if (payloadFilled < (int)header.payload_size) {
+            int n = sock.receiveSome(current->data + payloadFilled, header.payload_size - payloadFilled);
+            if (n <= 0) return n;
+            payloadFilled += n;
+            if (payloadFilled < (int)header.payload_size) continue;
+        }
+
+        // Complete
+        memset(current->data + header.payload_size, 0, PAVE_PADDING);
+        current->size     = header.payload_size;
+        current->number   = header.frame_number;
+        current->type     = header.frame_type;
+        current->width    = header.display_width;
+        current->height   = header.display_height;
+        current->drone    = header.timestamp * 0.001;
+        current->received = clock->now();
+        current->time     = current->received;
+
+        // The next frame goes into the next buffer
+        headerFilled = 0;
+        next = (next + 1) % ARDRONE_VIDEO_BUFFERS;
+        *packet = current;
+        return 1;
+    }
+}
+
+// --------------------------------------------------------------------------
+// PaVEReader::queued()
+// Description  : Bytes of the next frames already waiting in the socket.
+// Return value : Number of bytes
+// --------------------------------------------------------------------------
+int PaVEReader::queued(void)
+{
+    return sock.available();
+}
+
+// --------------------------------------------------------------------------
+// PaVEReader::setNonBlocking(Enable)
+// Description  : Switch the non-blocking mode of the socket. read() keeps
+//                the part of a frame it got and goes on at the next call.
+// Return value : SUCCESS: 1  FAILURE: 0
+// --------------------------------------------------------------------------
+int PaVEReader::setNonBlocking(bool enable)
+{
+    return sock.setNonBlocking(enable);
+}
+
+// --------------------------------------------------------------------------
+// PaVEReader::getSocket()
+// Description  : Descriptor of the socket, e.g. for an event loop.
+// Return value : Socket (INVALID_SOCKET if it is closed)
+// --------------------------------------------------------------------------
+SOCKET PaVEReader::getSocket(void) const
+{
+    return sock.getSocket();
+}
+
+// --------------------------------------------------------------------------
+// PaVEReader::width()
+// Description  : Width of the images.
+// Return value : Width [px] (0 before open())
+// --------------------------------------------------------------------------
+int PaVEReader::width(void) const
+{
+    return imageWidth;
+}
+
+// --------------------------------------------------------------------------
+// PaVEReader::height()
+// Description  : Height of the images.
+// Return value : Height [px] (0 before open())
+// --------------------------------------------------------------------------
+int PaVEReader::height(void) const
+{
+    return imageHeight;
+}
+
+// --------------------------------------------------------------------------
+// PaVEReader::close()
+// Description  : Close the socket, the buffers are kept for the next open().
+// Return value : NONE
+// --------------------------------------------------------------------------
+void PaVEReader::close(void)
+{
+    sock.close();
+    next = 0;
+    headerFilled = headerSkip = payloadFilled = 0;
+    first = NULL;
+}
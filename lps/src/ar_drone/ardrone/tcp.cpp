@@ -95,25 +95,6 @@ int TCPSocket::open(const char *addr, int port)
         return 0;
     }
 
-    //// Set to non-blocking mode
-    //#if _WIN32
-    //u_long nonblock = 1;
-    //if (ioctlsocket(sock, FIONBIO, &nonblock) == SOCKET_ERROR) {
-    //    printf("ERROR: ioctlsocket() failed. (%s, %d)\n", __FILE__, __LINE__);  
-    //    return 0;
-    //}
-    //#else
-    //int flag = fcntl(sock, F_GETFL, 0);
-    //if (flag < 0) {
-    //    printf("ERROR: fcntl(F_GETFL) failed. (%s, %d)\n", __FILE__, __LINE__);  
-    //    return 0;
-    //}
-    //if (fcntl(sock, F_SETFL, flag|O_NONBLOCK) < 0) {
-    //    printf("ERROR: fcntl(F_SETFL) failed. (%s, %d)\n", __FILE__, __LINE__);  
-    //    return 0;
-    //}
-    //#endif
-
     // Enable re-use address option
     int reuse = 1;
     if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse)) == SOCKET_ERROR) {
@@ -184,6 +165,96 @@ int TCPSocket::receive(void *data, size_t size)
     return received;
 }
 
+// --------------------------------------------------------------------------
+// TCPSocket::receiveSome(Receiving data, Size of data)
+// Description  : Receive what is there, waits until the timeout if nothing is.
+// Return value : SUCCESS: Number of received bytes (0 on timeout)  FAILURE (closed): -1
+// --------------------------------------------------------------------------
+int TCPSocket::receiveSome(void *data, size_t size)
+{
+    // The socket is invalid
+    if (sock == INVALID_SOCKET) return -1;
+
+    // Receive data
+    int n = (int)recv(sock, (char*)data, size, 0);
+    if (n > 0) return n;
+    if (n == 0) return -1;
+
+    // Nothing within the timeout
+    #if _WIN32
+    if (WSAGetLastError() == WSAETIMEDOUT || WSAGetLastError() == WSAEWOULDBLOCK) return 0;
+    #else
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+    #endif
+
+    printf("ERROR: recv() failed. (%s, %d)\n", __FILE__, __LINE__);
+    return -1;
+}
+
+// --------------------------------------------------------------------------
+// TCPSocket::available()
+// Description  : Number of received bytes waiting to be read.
+// Return value : SUCCESS: Number of bytes  FAILURE: 0
+// --------------------------------------------------------------------------
+int TCPSocket::available(void)
+{
+    // The socket is invalid
+    if (sock == INVALID_SOCKET) return 0;
+
+    #if _WIN32
+    u_long n = 0;
+    if (ioctlsocket(sock, FIONREAD, &n) == SOCKET_ERROR) return 0;
+    #else
+    int n = 0;
+    if (ioctl(sock, FIONREAD, &n) < 0) return 0;
+    #endif
+
+    return (int)n;
+}
+
+// --------------------------------------------------------------------------
+// TCPSocket::setNonBlocking(Enable)
+// Description  : Switch the non-blocking mode, receive() then returns at once
+//                if nothing is there (for an event loop).
+// Return value : SUCCESS: 1  FAILURE: 0
+// --------------------------------------------------------------------------
+int TCPSocket::setNonBlocking(bool enable)
+{
+    // The socket is invalid
+    if (sock == INVALID_SOCKET) return 0;
+
+    #if _WIN32
+    u_long nonblock = enable ? 1 : 0;
+    if (ioctlsocket(sock, FIONBIO, &nonblock) == SOCKET_ERROR) {
+        printf("ERROR: ioctlsocket() failed. (%s, %d)\n", __FILE__, __LINE__);
+        return 0;
+    }
+    #else
+    int flag = fcntl(sock, F_GETFL, 0);
+    if (flag < 0) {
+        printf("ERROR: fcntl(F_GETFL) failed. (%s, %d)\n", __FILE__, __LINE__);
+        return 0;
+    }
+    flag = enable ? (flag | O_NONBLOCK) : (flag & ~O_NONBLOCK);
+    if (fcntl(sock, F_SETFL, flag) < 0) {
+        printf("ERROR: fcntl(F_SETFL) failed. (%s, %d)\n", __FILE__, __LINE__);
+        return 0;
+    }
+    #endif
+
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+// TCPSocket::getSocket()
+// Description  : Descriptor of the socket, e.g. for an event loop.
+// Return value : Socket (INVALID_SOCKET if it is closed)
+// --------------------------------------------------------------------------
+SOCKET TCPSocket::getSocket(void) const
+{
+    return sock;
+}
+
 // --------------------------------------------------------------------------
 // TCPSocket::close()
 // Description  : Finalize the socket.
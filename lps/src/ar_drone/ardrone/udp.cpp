@@ -83,25 +83,6 @@ int UDPSocket::open(const char *addr, int port)
         return 0;
     }
 
-    //// Set to non-blocking mode
-    //#if _WIN32
-    //u_long nonblock = 1;
-    //if (ioctlsocket(sock, FIONBIO, &nonblock) == SOCKET_ERROR) {
-    //    printf("ERROR: ioctlsocket() failed. (%s, %d)\n", __FILE__, __LINE__);  
-    //    return 0;
-    //}
-    //#else
-    //int flag = fcntl(sock, F_GETFL, 0);
-    //if (flag < 0) {
-    //    printf("ERROR: fcntl(F_GETFL) failed. (%s, %d)\n", __FILE__, __LINE__);  
-    //    return 0;
-    //}
-    //if (fcntl(sock, F_SETFL, flag|O_NONBLOCK) < 0) {
-    //    printf("ERROR: fcntl(F_SETFL) failed. (%s, %d)\n", __FILE__, __LINE__);  
-    //    return 0;
-    //}
-    //#endif
-
     // Enable re-use address option
     int reuse = 1;
     if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse)) == SOCKET_ERROR) {
@@ -173,6 +154,158 @@ int UDPSocket::receive(void *data, size_t size)
     return n;
 }
 
+// --------------------------------------------------------------------------
+// UDPSocket::receive(Messages, Number of messages)
+// Description  : Wait for a datagram and take the ones behind it with the
+//                same call. The times are set if enableTimestamps() was called.
+// Return value : SUCCESS: Number of received datagrams  FAILURE: 0
+// --------------------------------------------------------------------------
+int UDPSocket::receive(UDPMessage *messages, int count)
+{
+    // The socket is invalid.
+    if (sock == INVALID_SOCKET || count < 1) return 0;
+
+    #if defined(__linux__)
+    // Room for the time of every datagram
+    const int MAX_BATCH = 16;
+    if (count > MAX_BATCH) count = MAX_BATCH;
+    mmsghdr headers[MAX_BATCH];
+    iovec   vectors[MAX_BATCH];
+    char    controls[MAX_BATCH][CMSG_SPACE(sizeof(timespec))];
+    memset(headers, 0, sizeof(headers[0]) * count);
+    for (int i = 0; i < count; i++) {
+        vectors[i].iov_base = messages[i].data;
+        vectors[i].iov_len  = messages[i].size;
+        headers[i].msg_hdr.msg_iov        = &vectors[i];
+        headers[i].msg_hdr.msg_iovlen     = 1;
+        headers[i].msg_hdr.msg_control    = controls[i];
+        headers[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+    }
+
+    // Block for the first one only
+    int n = recvmmsg(sock, headers, count, MSG_WAITFORONE, NULL);
+    if (n < 1) return 0;
+
+    // The kernel stamps with CLOCK_REALTIME, move the times to CLOCK_MONOTONIC
+    timespec real, mono;
+    clock_gettime(CLOCK_REALTIME,  &real);
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    double now   = mono.tv_sec + mono.tv_nsec * 1e-9;
+    double shift = now - (real.tv_sec + real.tv_nsec * 1e-9);
+
+    for (int i = 0; i < n; i++) {
+        messages[i].length = (int)headers[i].msg_len;
+        messages[i].time   = -1.0;
+        for (cmsghdr *c = CMSG_FIRSTHDR(&headers[i].msg_hdr); c != NULL; c = CMSG_NXTHDR(&headers[i].msg_hdr, c)) {
+            if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_TIMESTAMPNS) continue;
+            timespec stamp;
+            memcpy(&stamp, CMSG_DATA(c), sizeof(stamp));
+            double time = stamp.tv_sec + stamp.tv_nsec * 1e-9 + shift;
+            messages[i].time = (time < now) ? time : now;
+        }
+    }
+
+    return n;
+    #else
+    // One at a time, without the time
+    messages[0].length = receive(messages[0].data, messages[0].size);
+    messages[0].time   = -1.0;
+    return (messages[0].length > 0) ? 1 : 0;
+    #endif
+}
+
+// --------------------------------------------------------------------------
+// UDPSocket::setTimeout(Timeout [s])
+// Description  : Set how long receive() waits for data, 0 waits forever.
+// Return value : SUCCESS: 1  FAILURE: 0
+// --------------------------------------------------------------------------
+int UDPSocket::setTimeout(double timeout)
+{
+    // The socket is invalid
+    if (sock == INVALID_SOCKET) return 0;
+
+    // Set the receive timeout
+    #if _WIN32
+    DWORD tv = (DWORD)(timeout * 1000);
+    #else
+    timeval tv;
+    tv.tv_sec  = (long)timeout;
+    tv.tv_usec = (long)((timeout - tv.tv_sec) * 1000000);
+    #endif
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv)) == SOCKET_ERROR) {
+        printf("ERROR: setsockopt() failed. (%s, %d)\n", __FILE__, __LINE__);
+        return 0;
+    }
+
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+// UDPSocket::enableTimestamps()
+// Description  : Let the kernel stamp the datagrams when they arrive, the
+//                time does not depend on when the thread is scheduled.
+// Return value : SUCCESS: 1  FAILURE (not supported): 0
+// --------------------------------------------------------------------------
+int UDPSocket::enableTimestamps(void)
+{
+    // The socket is invalid
+    if (sock == INVALID_SOCKET) return 0;
+
+    #if defined(__linux__)
+    int enable = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, (const char*)&enable, sizeof(enable)) == SOCKET_ERROR) {
+        printf("ERROR: setsockopt() failed. (%s, %d)\n", __FILE__, __LINE__);
+        return 0;
+    }
+    return 1;
+    #else
+    return 0;
+    #endif
+}
+
+// --------------------------------------------------------------------------
+// UDPSocket::setNonBlocking(Enable)
+// Description  : Switch the non-blocking mode, receive() then returns at once
+//                if nothing is there (for an event loop).
+// Return value : SUCCESS: 1  FAILURE: 0
+// --------------------------------------------------------------------------
+int UDPSocket::setNonBlocking(bool enable)
+{
+    // The socket is invalid
+    if (sock == INVALID_SOCKET) return 0;
+
+    #if _WIN32
+    u_long nonblock = enable ? 1 : 0;
+    if (ioctlsocket(sock, FIONBIO, &nonblock) == SOCKET_ERROR) {
+        printf("ERROR: ioctlsocket() failed. (%s, %d)\n", __FILE__, __LINE__);
+        return 0;
+    }
+    #else
+    int flag = fcntl(sock, F_GETFL, 0);
+    if (flag < 0) {
+        printf("ERROR: fcntl(F_GETFL) failed. (%s, %d)\n", __FILE__, __LINE__);
+        return 0;
+    }
+    flag = enable ? (flag | O_NONBLOCK) : (flag & ~O_NONBLOCK);
+    if (fcntl(sock, F_SETFL, flag) < 0) {
+        printf("ERROR: fcntl(F_SETFL) failed. (%s, %d)\n", __FILE__, __LINE__);
+        return 0;
+    }
+    #endif
+
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+// UDPSocket::getSocket()
+// Description  : Descriptor of the socket, e.g. for an event loop.
+// Return value : Socket (INVALID_SOCKET if it is closed)
+// --------------------------------------------------------------------------
+SOCKET UDPSocket::getSocket(void) const
+{
+    return sock;
+}
+
 // --------------------------------------------------------------------------
 // UDPSocket::close()
 // Description  : Finalize the socket.
@@ -29,12 +29,15 @@
 
 // --------------------------------------------------------------------------
 //! @brief   Get the version information via FTP.
+//! @param   info Version information to fill, NULL for the one of this ARDrone
 //! @return  Result of initialization
 //! @retval  1 Success
 //! @retval  0 Failure
 // --------------------------------------------------------------------------
-int ARDrone::getVersionInfo(void)
+int ARDrone::getVersionInfo(ARDRONE_VERSION *info)
 {
+    if (!info) info = &version;
+
     TCPSocket socket1, socket2;
 
     // Open the IP address and port
@@ -72,7 +75,7 @@ int ARDrone::getVersionInfo(void)
     socket2.receive(buf, len);
 
     // Get version information
-    sscanf(buf, "%d.%d.%d", &version.major, &version.minor, &version.revision);
+    sscanf(buf, "%d.%d.%d", &info->major, &info->minor, &info->revision);
     //printf("AR.Drone Ver %d.%d.%d\n", major, minor, revision);
 
     // See you
@@ -44,25 +44,41 @@ int ARDrone::initVideo(void)
 {
     // AR.Drone 2.0
     if (version.major == ARDRONE_VERSION_2) {
-        // Open the IP address and port
-        char filename[256];
-        sprintf(filename, "tcp://%s:%d", ip, ARDRONE_VIDEO_PORT);
-        if (avformat_open_input(&pFormatCtx, filename, NULL, NULL) < 0) {
-            CVDRONE_ERROR("avformat_open_input() was failed. (%s, %d)\n", __FILE__, __LINE__);
+        // Connect and wait for the first frame, its PaVE header tells the size
+        if (!readerVideo.open(ip, ARDRONE_VIDEO_PORT, clock)) {
+            CVDRONE_ERROR("PaVEReader::open(port=%d) was failed. (%s, %d)\n", ARDRONE_VIDEO_PORT, __FILE__, __LINE__);
             return 0;
         }
+        skipVideo = false;
+        rejectedVideoTime = false;
 
-        // Retrive and dump stream information
-        avformat_find_stream_info(pFormatCtx, NULL);
-        av_dump_format(pFormatCtx, 0, filename, 0);
-
-        // Find the decoder for the video stream
-        pCodecCtx = pFormatCtx->streams[0]->codec;
-        AVCodec *pCodec = avcodec_find_decoder(pCodecCtx->codec_id);
+        // Find the decoder, the stream is H.264 and needs no probing
+        AVCodec *pCodec = avcodec_find_decoder(AV_CODEC_ID_H264);
         if (pCodec == NULL) {
             CVDRONE_ERROR("avcodec_find_decoder() was failed. (%s, %d)\n", __FILE__, __LINE__);
             return 0;
         }
+        pCodecCtx = avcodec_alloc_context3(pCodec);
+        if (pCodecCtx == NULL) {
+            CVDRONE_ERROR("avcodec_alloc_context3() was failed. (%s, %d)\n", __FILE__, __LINE__);
+            return 0;
+        }
+        pCodecCtx->width  = readerVideo.width();
+        pCodecCtx->height = readerVideo.height();
+
+        // Decoded frames are handed out by reference, the decoder must not reuse their buffers
+        pCodecCtx->refcounted_frames = 1;
+
+        // Output every frame as soon as it is complete, the slices of a frame are decoded in parallel
+        if (lowLatencyVideo) {
+            #ifdef AV_CODEC_FLAG_LOW_DELAY
+            pCodecCtx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+            #else
+            pCodecCtx->flags |= CODEC_FLAG_LOW_DELAY;
+            #endif
+            pCodecCtx->thread_type  = FF_THREAD_SLICE;
+            pCodecCtx->thread_count = 0;
+        }
 
         // Open codec
         if (avcodec_open2(pCodecCtx, pCodec, NULL) < 0) {
@@ -70,21 +86,8 @@ int ARDrone::initVideo(void)
             return 0;
         }
 
-        // Allocate video frames and a buffer
-        #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(55,28,1)
+        // Allocate a video frame, it is converted to BGR only when an image is requested
         pFrame = av_frame_alloc();
-        pFrameBGR = av_frame_alloc();
-        #else
-        pFrame = avcodec_alloc_frame();
-        pFrameBGR = avcodec_alloc_frame();
-        #endif
-        bufferBGR = (uint8_t*)av_mallocz(avpicture_get_size(AV_PIX_FMT_BGR24, pCodecCtx->width, pCodecCtx->height) * sizeof(uint8_t));
-
-        // Assign appropriate parts of buffer to image planes in pFrameBGR
-        avpicture_fill((AVPicture*)pFrameBGR, bufferBGR, AV_PIX_FMT_BGR24, pCodecCtx->width, pCodecCtx->height);
-
-        // Convert it to BGR
-        pConvertCtx = sws_getContext(pCodecCtx->width, pCodecCtx->height, pCodecCtx->pix_fmt, pCodecCtx->width, pCodecCtx->height, AV_PIX_FMT_BGR24, SWS_SPLINE, NULL, NULL, NULL);
     }
     // AR.Drone 1.0
     else {
@@ -93,6 +96,7 @@ int ARDrone::initVideo(void)
             CVDRONE_ERROR("UDPSocket::open(port=%d) was failed. (%s, %d)\n", ARDRONE_VIDEO_PORT, __FILE__, __LINE__);
             return 0;
         }
+        sockVideo.enableTimestamps();
 
         // Set codec
         pCodecCtx = avcodec_alloc_context3(NULL);
@@ -116,28 +120,77 @@ int ARDrone::initVideo(void)
     // Create a mutex
     mutexVideo = new pthread_mutex_t;
     pthread_mutex_init(mutexVideo, NULL);
+    mutexImage = new pthread_mutex_t;
+    pthread_mutex_init(mutexImage, NULL);
+
+    // Create a condition variable, waiting on the monotonic clock
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    #ifndef _WIN32
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    #endif
+    condVideo = new pthread_cond_t;
+    pthread_cond_init(condVideo, &attr);
+    pthread_condattr_destroy(&attr);
+    waitingVideo = 0;
+    closingVideo = false;
+
+    // AR.Drone 2.0 is read in the event loop, every frame is decoded as soon as it is complete
+    if (version.major == ARDRONE_VERSION_2 && loopEvents.running() && readerVideo.setNonBlocking(true)) {
+        readerVideoSocket = loopEvents.addReader(readerVideo.getSocket(), onVideoReceived, this);
+        if (readerVideoSocket < 0) readerVideo.setNonBlocking(false);
+    }
 
-    // Create a thread
-    threadVideo = new pthread_t;
-    if (pthread_create(threadVideo, NULL, runVideo, this) != 0) {
-        CVDRONE_ERROR("pthread_create() was failed. (%s, %d)\n", __FILE__, __LINE__);
-        return 0;
+    // or in a thread
+    if (readerVideoSocket < 0) {
+        stopVideo = false;
+        threadVideo = new pthread_t;
+        if (pthread_create(threadVideo, NULL, runVideo, this) != 0) {
+            CVDRONE_ERROR("pthread_create() was failed. (%s, %d)\n", __FILE__, __LINE__);
+            delete threadVideo;
+            threadVideo = NULL;
+            return 0;
+        }
     }
 
     return 1;
 }
 
+// --------------------------------------------------------------------------
+//! @brief   Socket of the video can be read in the event loop.
+//! @note    read() returns when the socket is empty, a part of a frame is kept for the next call.
+//! @param   args A pointer to the ARDrone
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::onVideoReceived(void *args)
+{
+    ARDrone *drone = reinterpret_cast<ARDrone*>(args);
+
+    // The AR.Drone closed the connection, a closed socket would be readable forever
+    if (!drone->getVideo()) {
+        CVDRONE_ERROR("The video connection was closed. (%s, %d)\n", __FILE__, __LINE__);
+        drone->loopEvents.remove(drone->readerVideoSocket);
+        drone->readerVideoSocket = -1;
+    }
+}
+
 // --------------------------------------------------------------------------
 //! @brief   Thread function for video.
 //! @return  None
 // --------------------------------------------------------------------------
 void ARDrone::loopVideo(void)
 {
-    while (1) {
+    // The decoder threads wait on condition variables, cancelling this thread there
+    // would leave their mutex locked, so it is stopped with stopVideo instead
+    int state;
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+
+    while (!stopVideo) {
         // Get video stream
         if (!getVideo()) break;
-        pthread_testcancel();
-        msleep(1);
+
+        // Reading the H.264 stream blocks, every packet is decoded as soon as it arrives
+        if (version.major != ARDRONE_VERSION_2) clock->sleep(0.001);
     }
 }
 
@@ -151,32 +204,46 @@ int ARDrone::getVideo(void)
 {
     // AR.Drone 2.0
     if (version.major == ARDRONE_VERSION_2) {
-        AVPacket packet;
-        int frameFinished = 0;
-
-        // Read all frames
-        while (av_read_frame(pFormatCtx, &packet) >= 0) {
-            // Decode the frame
-            avcodec_decode_video2(pCodecCtx, pFrame, &frameFinished, &packet);
+        // Read a frame (nothing within the timeout of the socket, or yet in the event loop, is no error)
+        ARDRONE_VIDEO_PACKET *frame;
+        int result = readerVideo.read(&frame);
+        if (result < 0) return 0;
+        if (result == 0) return 1;
+
+        // The time it was captured, unless the clocks are not synchronised yet.
+        // The PaVE stamp counts from the boot, it is put on the clock of Navdata first
+        double local;
+        if (fromDroneUptime(frame->drone, &frame->drone, &local)) {
+            if (local <= frame->received && frame->received - local < 1.0) {
+                frame->time = local;
+                rejectedVideoTime = false;
+            }
+            else if (!rejectedVideoTime) {
+                CVDRONE_ERROR("The time stamp of video frame %u is %.3f s off its arrival, the arrival is used. (%s, %d)\n", frame->number, frame->received - local, __FILE__, __LINE__);
+                rejectedVideoTime = true;
+            }
+        }
 
-            // Decoded all frames
-            if (frameFinished) {
-                // Convert to BGR
+        // Behind the AR.Drone, P-frames are left out until the next I-frame
+        if (!skipVideo && (frame->received - frame->time > ARDRONE_VIDEO_MAX_DELAY || readerVideo.queued() > ARDRONE_VIDEO_MAX_QUEUED)) skipVideo = true;
+        if (skipVideo) {
+            if (frame->type == ARDRONE_FRAME_IDR || frame->type == ARDRONE_FRAME_I) skipVideo = false;
+            else if (frame->type == ARDRONE_FRAME_P) {
                 if (mutexVideo) pthread_mutex_lock(mutexVideo);
-                sws_scale(pConvertCtx, (const uint8_t* const*)pFrame->data, pFrame->linesize, 0, pCodecCtx->height, pFrameBGR->data, pFrameBGR->linesize);
-                newImage = true;
+                statsVideo.skipped++;
                 if (mutexVideo) pthread_mutex_unlock(mutexVideo);
-
-                // Free the packet and break immidiately
-                av_free_packet(&packet);
                 return 1;
-                //break;
             }
-
-            // Free the packet
-            av_free_packet(&packet);
         }
-        return 0;
+
+        // Decode it straight from the buffer, a finished frame replaces the latest one
+        AVPacket packet;
+        av_init_packet(&packet);
+        packet.data = frame->data;
+        packet.size = frame->size;
+        if (frame->type == ARDRONE_FRAME_IDR || frame->type == ARDRONE_FRAME_I) packet.flags |= AV_PKT_FLAG_KEY;
+        decodeVideo(&packet, frame);
+        return 1;
     }
     // AR.Drone 1.0
     else {
@@ -185,13 +252,26 @@ int ARDrone::getVideo(void)
 
         // Receive data
         uint8_t buf[122880];
-        int size = sockVideo.receive((void*)&buf, sizeof(buf));
+        UDPMessage message = {buf, sizeof(buf), 0, -1.0};
+        int count = sockVideo.receive(&message, 1);
+        double now = clock->now();
 
         // Received something
-        if (size > 0) {
-            // Decode UVLC video
+        if (count > 0 && message.length > 0) {
+            // Decode UVLC video, only this thread uses the buffer
+            UVLC::DecodeVideo(buf, message.length, bufferBGR, &pCodecCtx->width, &pCodecCtx->height);
+            double received = (message.time >= 0.0 && clock == Clock::monotonic()) ? message.time : now;
+
+            // Replace the latest frame, frames handed out keep their own buffers
             if (mutexVideo) pthread_mutex_lock(mutexVideo);
-            UVLC::DecodeVideo(buf, size, bufferBGR, &pCodecCtx->width, &pCodecCtx->height);
+            if (frameVideo.copy(bufferBGR, pCodecCtx->width, pCodecCtx->height, received)) {
+                if (newImage) statsVideo.dropped++;
+                newImage = true;
+                frameVideo.frameSequence = ++sequenceVideo;
+                statsVideo.decoded++;
+                statsVideo.decode += clock->now() - received;
+                if (condVideo) pthread_cond_broadcast(condVideo);
+            }
             if (mutexVideo) pthread_mutex_unlock(mutexVideo);
         }
     }
@@ -199,8 +279,87 @@ int ARDrone::getVideo(void)
     return 1;
 }
 
+// --------------------------------------------------------------------------
+//! @brief   Decode a frame of the H.264 stream.
+//! @param   packet The packet of the frame
+//! @param   frame The frame read by the PaVE reader
+//! @return  Number of frames finished
+// --------------------------------------------------------------------------
+int ARDrone::decodeVideo(AVPacket *packet, const ARDRONE_VIDEO_PACKET *frame)
+{
+    int count = 0;
+
+    #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57,37,100)
+    // Every frame the packet finished
+    if (avcodec_send_packet(pCodecCtx, packet) < 0) return 0;
+    while (avcodec_receive_frame(pCodecCtx, pFrame) == 0) {
+        publishVideo(frame);
+        count++;
+    }
+    #else
+    // A broken packet only costs its frame
+    int frameFinished = 0;
+    if (avcodec_decode_video2(pCodecCtx, pFrame, &frameFinished, packet) < 0) return 0;
+    if (frameFinished) {
+        publishVideo(frame);
+        count++;
+    }
+    #endif
+
+    return count;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Replace the latest frame with the one just decoded.
+//! @param   frame The frame read by the PaVE reader
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::publishVideo(const ARDRONE_VIDEO_PACKET *frame)
+{
+    double now = clock->now();
+
+    // Enable mutex lock
+    if (mutexVideo) pthread_mutex_lock(mutexVideo);
+
+    // Take a reference, nothing is copied or converted here
+    if (frameVideo.assign(pFrame, frame)) {
+        // Nobody fetched the previous one
+        if (newImage) statsVideo.dropped++;
+        newImage = true;
+        frameVideo.frameSequence = ++sequenceVideo;
+        statsVideo.decoded++;
+        statsVideo.decode += now - frame->received;
+
+        // Wake up the threads waiting for it
+        if (condVideo) pthread_cond_broadcast(condVideo);
+    }
+
+    // Disable mutex lock
+    if (mutexVideo) pthread_mutex_unlock(mutexVideo);
+
+    av_frame_unref(pFrame);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Count a new frame as fetched. The caller holds the mutex.
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::fetchVideo(void)
+{
+    if (!newImage) return;
+
+    // From receiving to fetching
+    double latency = clock->now() - frameVideo.received();
+    statsVideo.fetched++;
+    statsVideo.latency += latency;
+    if (latency > statsVideo.latencyMax) statsVideo.latencyMax = latency;
+    newImage = false;
+}
+
 // --------------------------------------------------------------------------
 //! @brief   Get an image from the AR.Drone's camera.
+//! @note    The image is shared by all callers and overwritten by the next call,
+//!          getFrame() and waitForFrame() hand out a frame of their own.
 //! @return  An OpenCV image data (IplImage or cv::Mat)
 //! @retval  NULL Failure
 // --------------------------------------------------------------------------
@@ -209,33 +368,24 @@ ARDRONE_IMAGE ARDrone::getImage(void)
     // There is no image
     if (!img) return ARDRONE_IMAGE(NULL);
 
-    // Enable mutex lock
+    // Another reference to the latest frame, the decoder goes on meanwhile
+    ARDRONE_FRAME frame;
     if (mutexVideo) pthread_mutex_lock(mutexVideo);
+    frame = frameVideo;
+    fetchVideo();
+    if (mutexVideo) pthread_mutex_unlock(mutexVideo);
 
-    // AR.Drone 2.0
-    if (version.major == ARDRONE_VERSION_2) {
-        // Copy current frame to an IplImage
-        memcpy(img->imageData, pFrameBGR->data[0], pCodecCtx->width * ((pCodecCtx->height == 368) ? 360 : pCodecCtx->height) * sizeof(uint8_t) * 3);
-    }
-    // AR.Drone 1.0
-    else {
-        // If the sizes of the buffer and the IplImage are differnt
-        if (pCodecCtx->width != img->width || pCodecCtx->height != img->height) {
-            // Resize the image to 320x240
-            IplImage *small_img = cvCreateImageHeader(cvSize(pCodecCtx->width, pCodecCtx->height), IPL_DEPTH_8U, 3);
-            small_img->imageData = (char*)bufferBGR;
-            cvResize(small_img, img, CV_INTER_CUBIC);
-            cvReleaseImageHeader(&small_img);
-        }
-        // For 320x240 image, just copy it
-        else memcpy(img->imageData, bufferBGR, pCodecCtx->width * pCodecCtx->height * sizeof(uint8_t) * 3);
-    }
-    
-    // The latest image has been read, so change newImage accordingly
-    newImage = false;
+    // Enable mutex lock
+    if (mutexImage) pthread_mutex_lock(mutexImage);
+
+    // Convert the frame straight into the IplImage
+    cv::Mat image = cv::cvarrToMat(img);
+    if (frame.width() == img->width && frame.height() == img->height) frame.bgr(image);
+    // AR.Drone 1.0 may send smaller images, resize them to 320x240
+    else if (!frame.empty()) cv::resize(frame.bgr(), image, image.size(), 0, 0, cv::INTER_CUBIC);
 
     // Disable mutex lock
-    if (mutexVideo) pthread_mutex_unlock(mutexVideo);
+    if (mutexImage) pthread_mutex_unlock(mutexImage);
 
     return ARDRONE_IMAGE(img);
 }
@@ -267,26 +417,179 @@ bool ARDrone::willGetNewImage(void)
     return answer;
 }
 
+// --------------------------------------------------------------------------
+//! @brief   Get the time the latest image was received.
+//! @return  Time [s] of the clock of ARDrone, 0 if there was no image yet
+// --------------------------------------------------------------------------
+double ARDrone::getImageTime(void)
+{
+    // Enable mutex lock
+    if (mutexVideo) pthread_mutex_lock(mutexVideo);
+
+    double time = frameVideo.time();
+
+    // Disable mutex lock
+    if (mutexVideo) pthread_mutex_unlock(mutexVideo);
+
+    return time;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Get the latest frame. It shares the buffers of the decoder, nothing is copied
+//!          and it stays valid after the next frame was decoded.
+//! @param   frame The frame
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure (there was no frame yet)
+// --------------------------------------------------------------------------
+int ARDrone::getFrame(ARDRONE_FRAME *frame)
+{
+    if (!frame) return 0;
+
+    // Enable mutex lock
+    if (mutexVideo) pthread_mutex_lock(mutexVideo);
+
+    // Another reference to the latest frame
+    *frame = frameVideo;
+    fetchVideo();
+
+    // Disable mutex lock
+    if (mutexVideo) pthread_mutex_unlock(mutexVideo);
+
+    return !frame->empty();
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Wait for a frame newer than the given one and take a reference to it.
+//! @param   frame The frame, an empty one to get the latest frame
+//! @param   timeout Time to wait at most [s]
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure (timeout or the video was closed)
+// --------------------------------------------------------------------------
+int ARDrone::waitForFrame(ARDRONE_FRAME *frame, double timeout)
+{
+    if (!frame || !mutexVideo || !condVideo) return 0;
+
+    // Deadline on the clock of the condition variable
+    struct timespec deadline;
+    #ifdef _WIN32
+    timespec_get(&deadline, TIME_UTC);
+    #else
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    #endif
+    double sec = deadline.tv_sec + deadline.tv_nsec * 1e-9 + (timeout > 0.0 ? timeout : 0.0);
+    deadline.tv_sec  = (time_t)sec;
+    deadline.tv_nsec = (long)((sec - deadline.tv_sec) * 1e9);
+
+    // Enable mutex lock
+    pthread_mutex_lock(mutexVideo);
+
+    // Sleep until the decoder signals a newer frame
+    unsigned int sequence = frame->sequence();
+    waitingVideo++;
+    while (!closingVideo && (frameVideo.empty() || frameVideo.frameSequence == sequence)) {
+        if (pthread_cond_timedwait(condVideo, mutexVideo, &deadline) == ETIMEDOUT) break;
+    }
+    waitingVideo--;
+
+    // Take a reference to it
+    int result = 0;
+    if (!closingVideo && !frameVideo.empty() && frameVideo.frameSequence != sequence) {
+        *frame = frameVideo;
+        fetchVideo();
+        result = 1;
+    }
+
+    // finalizeVideo() waits until nobody waits any more
+    if (closingVideo) pthread_cond_broadcast(condVideo);
+
+    // Disable mutex lock
+    pthread_mutex_unlock(mutexVideo);
+
+    return result;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Get the statistics of the video since open().
+//! @param   stats The statistics
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure (no frame was decoded)
+// --------------------------------------------------------------------------
+int ARDrone::getVideoStats(ARDRONE_VIDEO_STATS *stats)
+{
+    if (!stats) return 0;
+
+    // Enable mutex lock
+    if (mutexVideo) pthread_mutex_lock(mutexVideo);
+
+    // The sums to means
+    *stats = statsVideo;
+    if (stats->decoded > 0) stats->decode  /= stats->decoded;
+    if (stats->fetched > 0) stats->latency /= stats->fetched;
+
+    // Disable mutex lock
+    if (mutexVideo) pthread_mutex_unlock(mutexVideo);
+
+    return stats->decoded > 0;
+}
+
 // --------------------------------------------------------------------------
 //! @brief   Finalize video.
 //! @return  None
 // --------------------------------------------------------------------------
 void ARDrone::finalizeVideo(void)
 {
-    // Destroy the thread
+    // Stop reading in the event loop, a frame being decoded is finished first
+    if (readerVideoSocket >= 0) {
+        loopEvents.remove(readerVideoSocket);
+        readerVideoSocket = -1;
+    }
+
+    // Stop the thread, it returns after the current frame or the timeout of the socket
     if (threadVideo) {
-        pthread_cancel(*threadVideo);
+        stopVideo = true;
         pthread_join(*threadVideo, NULL);
         delete threadVideo;
         threadVideo = NULL;
     }
 
-    // Delete the mutex
+    // Wake up the threads waiting for a frame and wait until they left
+    if (mutexVideo && condVideo) {
+        pthread_mutex_lock(mutexVideo);
+        closingVideo = true;
+        pthread_cond_broadcast(condVideo);
+        while (waitingVideo > 0) pthread_cond_wait(condVideo, mutexVideo);
+        pthread_mutex_unlock(mutexVideo);
+    }
+
+    // Report the latency
+    ARDRONE_VIDEO_STATS stats;
+    if (getVideoStats(&stats)) {
+        printf("Video: %u frames decoded in %.1f ms, %u skipped, %u dropped, %u fetched %.1f ms (at most %.1f ms) after they were received\n",
+               stats.decoded, stats.decode * 1000.0, stats.skipped, stats.dropped, stats.fetched, stats.latency * 1000.0, stats.latencyMax * 1000.0);
+    }
+    memset(&statsVideo, 0, sizeof(statsVideo));
+
+    // Delete the condition variable
+    if (condVideo) {
+        pthread_cond_destroy(condVideo);
+        delete condVideo;
+        condVideo = NULL;
+    }
+
+    // Delete the mutexes
     if (mutexVideo) {
         pthread_mutex_destroy(mutexVideo);
         delete mutexVideo;
         mutexVideo = NULL;
     }
+    if (mutexImage) {
+        pthread_mutex_destroy(mutexImage);
+        delete mutexImage;
+        mutexImage = NULL;
+    }
 
     // Release the IplImage
     if (img) {
@@ -294,51 +597,26 @@ void ARDrone::finalizeVideo(void)
         img = NULL;
     }
 
+    // Drop the latest frame, frames handed out keep their buffers
+    frameVideo.release();
+
     // AR.Drone 2.0
     if (version.major == ARDRONE_VERSION_2) {
         // Deallocate the frame
         if (pFrame) {
-            #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(55,28,1)
             av_frame_free(&pFrame);
-            #else
-            avcodec_free_frame(&pFrame);
-            #endif
             pFrame = NULL;
         }
 
-        // Deallocate the frame
-        if (pFrameBGR) {
-            #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(55,28,1)
-            av_frame_free(&pFrameBGR);
-            #else
-            avcodec_free_frame(&pFrameBGR);
-            #endif
-            pFrameBGR = NULL;
-        }
-
-        // Deallocate the buffer
-        if (bufferBGR) {
-            av_free(bufferBGR);
-            bufferBGR = NULL;
-        }
-
-        // Deallocate the convert context
-        if (pConvertCtx) {
-            sws_freeContext(pConvertCtx);
-            pConvertCtx = NULL;
-        }
-
         // Deallocate the codec
         if (pCodecCtx) {
             avcodec_close(pCodecCtx);
+            av_free(pCodecCtx);
             pCodecCtx = NULL;
         }
 
-        // Deallocate the format context
-        if (pFormatCtx) {
-            avformat_close_input(&pFormatCtx);
-            pFormatCtx = NULL;
-        }
+        // Close the socket
+        readerVideo.close();
     }
     // AR.Drone 1.0
     else {
@@ -6,13 +6,12 @@
  */
 
 #include "arucodrone.h"
+#include <thread>
+#include <math.h>
 
 using namespace std;
 
 // for readability
-using hr_clock = std::chrono::high_resolution_clock;
-using hr_time_point = hr_clock::time_point;
-using hr_duration = hr_clock::duration;
 using millisec = std::chrono::duration<double, std::milli>;
 
 // --------------------------------------------------------------------------
@@ -20,13 +19,28 @@ using millisec = std::chrono::duration<double, std::milli>;
 //! @return  None
 // --------------------------------------------------------------------------
 ArucoDrone::ArucoDrone() :
-	tick(0),
+	previous(0),
 	pid_x(0.001,0,0),
 	pid_y(0.001,0,0),
 	pid_z(0.000,0,0),
-	holdpos(0,0,-1),
 	reset(false),
-	client("10.0.1.17", 9876, "arucodrone.")
+	drone_yaw(0),
+	state_time(0),
+	speed_time(0),
+	capture_time(0),
+	measured_capture(0),
+	holdpos(0,0,-1),
+	feedforward(0.01),
+	mapping(false),
+	control_rate(100),
+	control_priority(0),
+	command_rate(ARDRONE_COMMAND_RATE),
+	driver_cpu(-1),
+	navdata_sequence(0),
+	navdata_time(-HUGE_VAL),
+	tick(0),
+	client("10.0.1.17", 9876, "arucodrone."),
+	control_running(false)
 	{}
 
 //// --------------------------------------------------------------------------
@@ -47,6 +61,13 @@ ArucoDrone::ArucoDrone() :
 void ArucoDrone::initialize_drone(){
 	cout << "Initializing drone" << endl;
     //log_file << "Initializing drone" << endl;
+    // Version and configurations of the drone are cached next to the settings
+    setCacheDirectory("../src/include");
+
+    // Only the navdata that is read: attitude, altitude and velocities for the estimator and
+    // the pose solver (demo) and the vertical speed (altitude), the state is always sent
+    subscribeNavdata(ARDRONE_NAVDATA_OPTION(ARDRONE_NAVDATA_DEMO_TAG) | ARDRONE_NAVDATA_OPTION(ARDRONE_NAVDATA_ALTITUDE_TAG));
+
     // Initialize
     if (!open()) {
         cout << "Failed to initialize." << endl;
@@ -69,7 +90,7 @@ void ArucoDrone::initialize_drone(){
     drone_location.z = -1;
     double m[3][3] = {{-1, 0, 0}, {0, 1, 0}, {0, 0, -1}};
 	camerarot = cv::Mat(3, 3, CV_64F, m).inv();
-	previous = hr_clock::now();
+	previous = clock->now();
     return;
 }
 
@@ -78,6 +99,8 @@ void ArucoDrone::initialize_drone(){
 //! @return  None
 // --------------------------------------------------------------------------
 ArucoDrone::~ArucoDrone() {
+	//the control thread sends commands, it is stopped before the driver is closed
+	finalize_control();
 	close();
 }
 
@@ -87,10 +110,10 @@ ArucoDrone::~ArucoDrone() {
 // --------------------------------------------------------------------------
 millisec ArucoDrone::timediff(){
     // get current time
-    hr_time_point current = hr_clock::now();
+    double current = clock->now();
 
     // get the time difference
-    millisec ms = std::chrono::duration_cast<millisec>(current - previous);
+    millisec ms((current - previous) * 1000);
 
     // store current time for next call
     previous = current;
@@ -100,25 +123,95 @@ millisec ArucoDrone::timediff(){
 }
 
 // --------------------------------------------------------------------------
-//! @brief the main loop function during the flight that executes all other functions
+//! @brief time of the drone clock used to timestamp navdata and camera frames
+//! @return the time in seconds
+// --------------------------------------------------------------------------
+double ArucoDrone::timestamp(){
+	return clock->now();
+}
+
+// --------------------------------------------------------------------------
+//! @brief sets the clock of the driver threads, the control thread and the PID controllers
+//! @param the clock, a virtual clock for replay and simulation
+//! @return None
+// --------------------------------------------------------------------------
+void ArucoDrone::setClock(Clock *clock){
+	ARDrone::setClock(clock);
+	pid_x.setClock(getClock());
+	pid_y.setClock(getClock());
+	pid_z.setClock(getClock());
+	previous = getClock()->now();
+}
+
+// --------------------------------------------------------------------------
+//! @brief runs in the navdata thread, predicts the state with every new navdata packet
+//! @return Result of ARDrone::getNavdata()
+// --------------------------------------------------------------------------
+int ArucoDrone::getNavdata(void){
+	int result = ARDrone::getNavdata();
+
+	// only new packets are used, this thread publishes them so it reads without the lock
+	unsigned int sequence = navdata.sequence;
+	if (sequence == navdata_sequence) return result;
+	navdata_sequence = sequence;
+
+	// a batch can hold several packets, each one is integrated at the time the drone measured it,
+	// the same clock the camera frames are stamped with
+	ARDRONE_NAVDATA_SAMPLE samples[ARDRONE_NAVDATA_HISTORY];
+	int n = getNavdataWindow(navdata_time, HUGE_VAL, samples, ARDRONE_NAVDATA_HISTORY);
+	for (int i = 0; i < n; i++) {
+		const ARDRONE_NAVDATA_SAMPLE &s = samples[i];
+		if (s.time <= navdata_time) continue;
+		navdata_time = s.time;
+
+		// velocities in m/s (forward, left, up), the world is in cm
+		estimator.predict(s.time, s.vx * 100, s.vy * 100, s.vz * 100, s.yaw, s.altitude * 100);
+	}
+	return result;
+}
+
+// --------------------------------------------------------------------------
+//! @brief the main loop function during the flight, detects the markers, the control thread flies with the result
 //! @return None
 // --------------------------------------------------------------------------
 void ArucoDrone::fly(){
-	// detect marker and updates the drone_location
+	// detect marker and correct the estimator with the vision pose
     detect();
 
-    client.gauge("position-x", (float) drone_location.x);
-    client.gauge("position-y", (float) drone_location.y);
-    client.gauge("position-z", (float) drone_location.z);
+    cv::Point3d location;
+    if (estimator.getState(&location)) {
+    	gauge("position-x", (float) location.x);
+    	gauge("position-y", (float) location.y);
+    	gauge("position-z", (float) location.z);
+    }
+}
 
-    //this will be the move function
-    move3D(speed.x, speed.y, speed.z, 0); //currently not able to rotate
+// --------------------------------------------------------------------------
+//! @brief one step of the control loop, runs at a fixed rate in the control thread
+//! @param the time since the last step in seconds
+//! @return None
+// --------------------------------------------------------------------------
+void ArucoDrone::control(double dt){
+	std::lock_guard<std::mutex> lock(state_mutex);
 
+    // use the fused state instead of the last vision pose
+    // and control on the position the drone will have when the command reaches it
+    cv::Point3d estimate, velocity;
+    if (estimator.getState(&estimate, &drone_yaw, &velocity, &state_time)){
+    	drone_location = estimate;
+    	predicted_location = predictor.predict(state_time, capture_time, estimate, velocity);
+    }
+    else{
+    	//no marker for too long, the position is unknown
+    	drone_location.z = -1;
+    	predicted_location = drone_location;
+    }
 
     //in the case, that the new speed isn't set
     speed.x = 0;
 	speed.y = 0;
 	speed.z = 0;
+	speed_time = 0;
 
 
     //move.cpp and this function will be removed in later versions
@@ -145,8 +238,17 @@ void ArucoDrone::fly(){
     		if(drone_location.z == -1){
     			command = off;
 				cout << "command changed to off" << endl;
+				break;
     		}
-        	if(holdpos.z > 0) flytocoords(holdpos);
+        	{
+        		// follow the waypoints, the reference velocity is fed forward
+        		cv::Point3d reference, velocity;
+        		if(trajectory.setpoint(timestamp(), holdpos.z > 0 ? holdpos : drone_location, &reference, &velocity)){
+        			holdpos = reference;
+        			flytocoords(holdpos, dt, velocity);
+        		}
+        		else if(holdpos.z > 0) flytocoords(holdpos, dt);
+        	}
         	break;
     	case land:
     		landing();
@@ -159,7 +261,7 @@ void ArucoDrone::fly(){
     		else{
     			if(drone_location.z == -1 && getAltitude() < 0.5){
     				//cout << "flying up, altitude = " << getAltitude() << endl;
-    				move3D(0, 0, 1, 0);
+    				speed.z = 1;
     			}
     			if(drone_location.z != -1){
     				holdpos = drone_location;
@@ -179,6 +281,17 @@ void ArucoDrone::fly(){
     //	reset = false;
     //}
 
+    //this will be the move function
+    move3D(speed.x, speed.y, speed.z, 0); //currently not able to rotate
+    double sent = timestamp();
+    predictor.command(sent, speed.x, speed.y, drone_yaw);
+    //the first command after a new frame measures the camera to command latency
+    if (speed_time > 0 && capture_time > measured_capture){
+    	predictor.measure(sent - capture_time);
+    	measured_capture = capture_time;
+    	gauge("latency", (float) (1000 * predictor.latency()));
+    }
+
     tick++;
 }
 
@@ -187,13 +300,27 @@ void ArucoDrone::fly(){
 //! @return None
 // --------------------------------------------------------------------------
 void ArucoDrone::initAll(){
+	double start = timestamp();
+
+	//Initialize the Camera and the marker detect function while the AR Drone connects,
+	//the settings of the driver are only stored and applied after both are done
+	//log_file << "initialize_detection();" << endl;
+	double detection_time = 0;
+	std::thread detection([this, &detection_time](){
+		double t = timestamp();
+		initialize_detection();
+		detection_time = timestamp() - t;
+	});
+
 	//Initialize the AR Drone
 	//log_file << "initialize_drone();" << endl;
 	initialize_drone();
+	double drone_time = timestamp() - start;
+	detection.join();
 
-	//Initialize the Camera and the marker detect function
-	//log_file << "initialize_drone();" << endl;
-	initialize_detection();
+	//Settings of the driver read by the detection
+	setCommandRate(command_rate);
+	setEventCPU(driver_cpu);
 
 	//Initialize PID clock
 	//log_file << "pid_x.initClock();" << endl;
@@ -207,6 +334,11 @@ void ArucoDrone::initAll(){
 	//log_file << "initialize_thread();" << endl;
 	initialize_thread();
 
+	//Initialize the fixed rate control thread
+	initialize_control();
+
+	cout << "Startup took " << timestamp() - start << " s (drone " << drone_time << " s, camera and detection " << detection_time << " s)" << endl;
+
 	cout << "PID settings:" << endl;
 	cout << "PID X: p = " << pid_x.kp() << " i = " << pid_x.ki() << " d = " << pid_x.kd() << endl;
 	cout << "PID Y: p = " << pid_y.kp() << " i = " << pid_y.ki() << " d = " << pid_y.kd() << endl;
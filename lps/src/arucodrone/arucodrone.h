@@ -11,6 +11,11 @@
 #include "../ar_drone/ardrone/ardrone.h"
 #include "../statsd-client-cpp/src/statsd_client.h"
 #include "pid.h"
+#include "undistort.h"
+#include "estimator.h"
+#include "predictor.h"
+#include "markermap.h"
+#include "trajectory.h"
 #include <aruco/aruco.h>
 #include <aruco/cvdrawingutils.h>
 #include <opencv2/highgui/highgui.hpp>
@@ -20,6 +25,10 @@
 
 #include <time.h>
 #include <chrono>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
 
 class ArucoDrone: public ARDrone {
 public:
@@ -31,8 +40,10 @@ public:
 	cv::Point3d get_GPS_position();
 
 
-	std::chrono::high_resolution_clock::time_point previous;
+	double previous;
 	std::chrono::duration<double, std::milli> timediff();
+	double timestamp();
+	virtual void setClock(Clock *clock);
 
 	//detect
 	void initialize_detection();
@@ -60,11 +71,21 @@ public:
 	bool reset;
 
 	cv::Point3d drone_location;
+	double drone_yaw; //yaw in world coordinates, only valid if the estimator is initialized
+	StateEstimator estimator;
+	cv::Point3d predicted_location; //where the drone is expected to be when the next command takes effect
+	LatencyPredictor predictor;
+	double state_time; //time of the estimate drone_location is taken from
+	double speed_time; //time of the estimate speed was calculated from, 0 if it was not calculated from an estimate
+	double capture_time; //capture time of the last frame a vision pose was taken from, 0 before the first
+	double measured_capture; //capture time of the frame the latency was last measured for
 	cv::Mat rot;
 	cv:: Mat camerarot; //rotation of camera
 	double TheMarkerSize;
 	cv::Point3d speed;
 	cv::Point3d holdpos;
+	Trajectory trajectory; //waypoints of the flyto command
+	double feedforward; //speed command per cm/s of reference velocity
 	int command;
 	int prev_command;
 	int Matwidth;
@@ -74,6 +95,12 @@ public:
 	vector<cv::Point2d> setPixelCoords(aruco::Marker m);
 	vector<cv::Point3d> setWorldCoords(cv::Point3d top_left, cv::Point3d top_right, cv::Point3d bottom_left, cv::Point3d bottom_right);
 	vector<cv::Point3d> setWorldCoords(int id);
+	std::map<int, vector<cv::Point3d> > marker_map; //corners of surveyed markers, used instead of the grid
+	string marker_map_file;
+
+	//markermap
+	MarkerMapper mapper;
+	std::atomic<bool> mapping; //survey mode, every keyframe is added to the mapper, toggled by the input thread
 	double distance(int id);
 	//to be removed in later versions
 	vector<cv::Point3d> setup(int id);
@@ -81,19 +108,41 @@ public:
 	//flyto
 	double distancetofly(cv::Point3d point);
 	cv::Point3d vectortofly(cv::Point3d point);
+	cv::Point3d rotatetodrone(cv::Point3d vec);
 	double getspeed(int x);
-	void flytocoords(cv::Point3d point);
-	void flyto(cv::Point3d vector);
+	void flytocoords(cv::Point3d point, double dt, cv::Point3d velocity = cv::Point3d());
+	void flyto(cv::Point3d vector, double dt);
 
 	//cameralocation
 	void setEulerAngles(cv::Mat &rotCamerMatrix,cv::Vec3d &eulerAngles);
-	void getLocation(aruco::Marker m, aruco::CameraParameters TheCameraParameters, cv::Point3d *position, cv::Mat *rotation, bool print);
+	void getLocation(int id, const vector<cv::Point2d> &corners, cv::Point3d *position, cv::Mat *rotation, bool print);
+	bool getLocationIMU(const vector<aruco::Marker> &markers, const vector< vector<cv::Point2d> > &corners, double roll, double pitch, double altitude, cv::Point3d *position, cv::Mat *rotation);
 
 	//commands
 	enum Command {off = -2, hold = -1, land = 0, start = 1};
 	void initialize_thread();
 
+	//control
+	void initialize_control();
+	void finalize_control();
+	void control(double dt);
+	double control_rate; //rate of the control loop in Hz
+	int control_priority; //SCHED_FIFO priority of the control thread, 0 for the normal scheduler
+	double command_rate; //rate the latest command is sent to the drone in Hz, applied once the drone is open
+	int driver_cpu; //CPU of the driver thread, -1 for any, applied once the drone is open
+	std::mutex state_mutex; //guards the state shared by the detection and the control thread
+
+protected:
+	//feeds every new navdata packet to the estimator
+	virtual int getNavdata(void);
+
 private:
+	void controlLoop();
+	void gauge(const string &key, float value);
+
+	unsigned int navdata_sequence;
+	double navdata_time; //time of the last navdata sample the estimator was predicted with
+
 	//move
 	double vx();
 	double vy();
@@ -102,6 +151,9 @@ private:
 	bool check();
 	int tick;
 	statsd::StatsdClient client;
+	std::mutex client_mutex; //the gauges are exported by the main and the control thread
+	std::thread control_thread;
+	std::atomic<bool> control_running; //cleared to stop the control thread
 };
 
 #endif /* ARUCODRONE_H_ */
@@ -41,18 +41,21 @@ void ArucoDrone::setEulerAngles(Mat &rotCamerMatrix,Vec3d &eulerAngles){
 
 // --------------------------------------------------------------------------
 //! @brief calculates the coordinates of the drone, may be used in future to calculate camera pose
-//! @param the aruco marker, the camera parametera, and an  optional boolean if the location should be printed
+//! @param the id of the aruco marker, its undistorted corners in normalised coordinates, and an  optional boolean if the location should be printed
 //! @return a Matrix of the drone location
 // --------------------------------------------------------------------------
-void ArucoDrone::getLocation(Marker m, CameraParameters TheCameraParameters, Point3d *position, Mat *rotation, bool print){
+void ArucoDrone::getLocation(int id, const vector<Point2d> &corners, Point3d *position, Mat *rotation, bool print){
     //bool debug = false;
-    if(print) cout << "Marker id: " << m.id << endl;
-    //if(print) log_file << "Marker id: " << m.id << endl;
+    if(print) cout << "Marker id: " << id << endl;
+    //if(print) log_file << "Marker id: " << id << endl;
     Mat rvec, tvec;
-    vector<Point3d> world_coords = setWorldCoords(m.id);
+    vector<Point3d> world_coords = setWorldCoords(id);
     
+    //the corners are already undistorted, so solvePnP works on an ideal pinhole camera
+    static const Mat pinhole = Mat::eye(3, 3, CV_64F);
+
     //solvePnP returns the rotation and the translation vectors
-    solvePnP(world_coords, setPixelCoords(m), TheCameraParameters.CameraMatrix, TheCameraParameters.Distorsion, rvec, tvec);
+    solvePnP(world_coords, corners, pinhole, noArray(), rvec, tvec);
     
     if(print)cout << "rvec: "<< rvec << endl << "tvec: " << tvec << endl;
     //if(print)log_file << "rvec: "<< rvec << endl << "tvec: " << tvec << endl;
@@ -80,3 +83,58 @@ void ArucoDrone::getLocation(Marker m, CameraParameters TheCameraParameters, Poi
     //if(print)log_file << "extrinsic_inv: "<< extrinsic_inv << endl;
     *position = cv::Point3d(extrinsic_inv.at<double>(0,3),extrinsic_inv.at<double>(1,3),extrinsic_inv.at<double>(2,3));
 }
+
+// --------------------------------------------------------------------------
+//! @brief calculates x, y and yaw of the drone in closed form when roll, pitch and altitude are known from the navdata
+//! @param the markers, their undistorted corners in normalised coordinates, roll and pitch [rad] and the altitude [cm] at capture time
+//! @return false if the corners can not be projected onto the ground, the full solver must be used then
+// --------------------------------------------------------------------------
+bool ArucoDrone::getLocationIMU(const vector<Marker> &markers, const vector< vector<Point2d> > &corners, double roll, double pitch, double altitude, Point3d *position, Mat *rotation){
+    //rotation from the body to the levelled frame (X front, Y left, Z up)
+    double cr = cos(roll), sr = sin(roll), cp = cos(pitch), sp = sin(pitch);
+    Matx33d Rx(1, 0, 0, 0, cr, -sr, 0, sr, cr);
+    Matx33d Ry(cp, 0, sp, 0, 1, 0, -sp, 0, cp);
+    Matx33d level = Ry * Rx;
+    //the camera points down, its x axis points to the back of the drone
+    Matx33d camera(-1, 0, 0, 0, 1, 0, 0, 0, -1);
+    Matx33d level_camera = level * camera;
+
+    //project every corner onto the ground and pair it with its world coordinates
+    vector<Point2d> ground, world;
+    for (size_t i = 0; i < markers.size(); i++) {
+        vector<Point3d> world_coords = setWorldCoords(markers[i].id);
+        for (size_t c = 0; c < corners[i].size() && c < world_coords.size(); c++) {
+            Vec3d ray = level_camera * Vec3d(corners[i][c].x, corners[i][c].y, 1);
+            if (ray[2] > -1e-3) return false; //ray does not hit the ground
+            double t = -altitude / ray[2];
+            //the world z axis points into the ground, so y is flipped to keep the frame right handed
+            ground.push_back(Point2d(t * ray[0], -t * ray[1]));
+            world.push_back(Point2d(world_coords[c].x, world_coords[c].y));
+        }
+    }
+    if (ground.size() < 2) return false;
+
+    //2D rigid alignment (procrustes): world = T + R(yaw) * ground
+    Point2d g(0, 0), w(0, 0);
+    for (size_t i = 0; i < ground.size(); i++) {
+        g = g + ground[i];
+        w = w + world[i];
+    }
+    g = g * (1.0 / ground.size());
+    w = w * (1.0 / world.size());
+    double a = 0, b = 0;
+    for (size_t i = 0; i < ground.size(); i++) {
+        Point2d q = ground[i] - g, p = world[i] - w;
+        a += q.x * p.x + q.y * p.y;
+        b += q.x * p.y - q.y * p.x;
+    }
+    double yaw = atan2(b, a);
+    double cy = cos(yaw), sy = sin(yaw);
+    *position = Point3d(w.x - (cy * g.x - sy * g.y), w.y - (sy * g.x + cy * g.y), altitude);
+
+    //rotation from the world into the camera, the same matrix solvePnP would give
+    Matx33d yaw_inv(cy, sy, 0, -sy, cy, 0, 0, 0, 1);
+    Matx33d flip(1, 0, 0, 0, -1, 0, 0, 0, -1);
+    *rotation = Mat(camera * level.t() * flip * yaw_inv);
+    return true;
+}
@@ -14,13 +14,19 @@ bool getinput;
 //! @brief parses the input from the terminal
 //! @return  an integer representing the command
 // --------------------------------------------------------------------------
-int parseinput(string terminal_input, cv::Point3d *holdpos, cv::Point3d *drone_location, int *command, cv::Point3d *speed, cv::Mat *rot, bool *reset){
-	if(terminal_input.compare("off") == 0) return -2;
+int parseinput(string terminal_input, cv::Point3d *holdpos, cv::Point3d *drone_location, int *command, cv::Point3d *speed, cv::Mat *rot, bool *reset, Trajectory *trajectory, MarkerMapper *mapper, std::atomic<bool> *mapping, string *map_file){
+	if(terminal_input.compare("off") == 0){
+		trajectory->clear();
+		return -2;
+	}
 	if(terminal_input.compare("hold") == 0){
 		*reset = true;
 		return -1;
 	}
-	if(terminal_input.compare("land") == 0) return 0;
+	if(terminal_input.compare("land") == 0){
+		trajectory->clear();
+		return 0;
+	}
 	if(terminal_input.compare("takeoff") == 0) return 1;
 	if(terminal_input.compare("start") == 0) return 1;
 	if(terminal_input.compare("getpos") == 0) {
@@ -35,6 +41,28 @@ int parseinput(string terminal_input, cv::Point3d *holdpos, cv::Point3d *drone_l
 				std::cout << "Drone angle is currently: " << *rot << std::endl;
 				return *command;
 	}
+	if(terminal_input.compare("map") == 0) {
+		//the detection reads the flag, the map is cleared before it is set
+		if(!*mapping){
+			mapper->clear();
+			*mapping = true;
+			std::cout << "Mapping started, the first marker seen is the anchor of the map" << std::endl;
+		}
+		else{
+			*mapping = false;
+			std::cout << "Mapping stopped with " << mapper->markers() << " markers in " << mapper->keyframes() << " keyframes" << std::endl;
+		}
+		return *command;
+	}
+	if(terminal_input.compare("savemap") == 0) {
+		if(map_file->empty()){
+			std::cout << "No TheMarkerMap file given in the settings" << std::endl;
+			return *command;
+		}
+		mapper->optimize();
+		if(mapper->save(*map_file)) std::cout << "The map is used after a restart" << std::endl;
+		return *command;
+	}
 	if(terminal_input.compare("flyto") == 0){
 		cv::Point3d point;
 		std::cout << std::endl << "Please enter the x coordinates: ";
@@ -43,10 +71,16 @@ int parseinput(string terminal_input, cv::Point3d *holdpos, cv::Point3d *drone_l
 		std::cin >> point.y;
 		std::cout << std::endl << "Please enter the z coordinates: ";
 		std::cin >> point.z;
-		*holdpos = point;
+		trajectory->add(point);
+		std::cout << trajectory->pending() << " waypoints queued" << std::endl;
 		*reset = true;
 		return -1;
 	}
+	if(terminal_input.compare("clear") == 0) {
+		trajectory->clear();
+		std::cout << "Waypoints cleared, holding the current setpoint" << std::endl;
+		return *command;
+	}
 	return *command;
 }
 
@@ -54,12 +88,12 @@ int parseinput(string terminal_input, cv::Point3d *holdpos, cv::Point3d *drone_l
 //! @brief waits for input from user, used by separate thread
 //! @return  None
 // --------------------------------------------------------------------------
-void input(int *command, cv::Point3d *holdpos, cv::Point3d *drone_location, int *prev_command, cv::Point3d *speed, cv::Mat *rot, bool *reset){
+void input(int *command, cv::Point3d *holdpos, cv::Point3d *drone_location, int *prev_command, cv::Point3d *speed, cv::Mat *rot, bool *reset, Trajectory *trajectory, MarkerMapper *mapper, std::atomic<bool> *mapping, string *map_file){
 	string terminal_input;
 	while(getinput){
 		std::getline(std::cin, terminal_input);
 		*prev_command = *command;
-		*command = parseinput(terminal_input, holdpos, drone_location, command, speed, rot, reset); //must be checked if it works
+		*command = parseinput(terminal_input, holdpos, drone_location, command, speed, rot, reset, trajectory, mapper, mapping, map_file); //must be checked if it works
 		if(*prev_command != *command)
 			cout << "command changed to " << *command << endl;
 	}
@@ -71,7 +105,7 @@ void input(int *command, cv::Point3d *holdpos, cv::Point3d *drone_location, int
 // --------------------------------------------------------------------------
 void ArucoDrone::initialize_thread(){
 	getinput = true;
-	std::thread t1(input, &command, &holdpos, &drone_location, &prev_command, &speed, &rot, &reset);
+	std::thread t1(input, &command, &holdpos, &drone_location, &prev_command, &speed, &rot, &reset, &trajectory, &mapper, &mapping, &marker_map_file);
 	t1.detach();
 }
 
@@ -0,0 +1,86 @@
+/*
+ * control.cpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "arucodrone.h"
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+// --------------------------------------------------------------------------
+//! @brief runs the control step on absolute deadlines, exports the wake up jitter and the overruns once per second
+//! @return None
+// --------------------------------------------------------------------------
+void ArucoDrone::controlLoop(){
+	if(control_priority > 0){
+		struct sched_param param;
+		param.sched_priority = control_priority;
+		int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		if(error) cerr << "Could not set SCHED_FIFO priority " << control_priority << ": " << strerror(error) << endl;
+	}
+
+	double period = 1.0 / control_rate;
+	double deadline = clock->now();
+	double last = deadline;
+
+	double jitter = 0; //largest wake up delay since the last export
+	int overruns = 0, steps = 0;
+	while(control_running){
+		deadline += period;
+		clock->sleepUntil(deadline);
+
+		double now = clock->now();
+		double late = now - deadline;
+		if(late > jitter) jitter = late;
+
+		control(now - last);
+		last = now;
+
+		//the step took longer than a period, the missed deadlines are skipped
+		now = clock->now();
+		if(now - deadline > period){
+			overruns++;
+			deadline = now;
+		}
+
+		if(++steps >= control_rate){
+			gauge("control-jitter", (float) (1000 * jitter));
+			gauge("control-overruns", (float) overruns);
+			jitter = 0;
+			overruns = 0;
+			steps = 0;
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+//! @brief starts the control thread
+//! @return None
+// --------------------------------------------------------------------------
+void ArucoDrone::initialize_control(){
+	cout << "Starting control loop at " << control_rate << " Hz" << endl;
+	control_running = true;
+	control_thread = std::thread(&ArucoDrone::controlLoop, this);
+}
+
+// --------------------------------------------------------------------------
+//! @brief stops the control thread and waits for its last step
+//! @return None
+// --------------------------------------------------------------------------
+void ArucoDrone::finalize_control(){
+	control_running = false;
+	if(control_thread.joinable()) control_thread.join();
+}
+
+// --------------------------------------------------------------------------
+//! @brief exports a gauge to statsd, the client is not thread safe
+//! @param the name and the value of the gauge
+//! @return None
+// --------------------------------------------------------------------------
+void ArucoDrone::gauge(const string &key, float value){
+	std::lock_guard<std::mutex> lock(client_mutex);
+	client.gauge(key, value);
+}
@@ -48,6 +48,8 @@ MarkerDetector MDetector;
 vector< Marker > TheMarkers;
 Mat TheInputImage, TheInputImageCopy;
 CameraParameters TheCameraParameters;
+UndistortLUT TheUndistortLUT; //maps marker corners to normalised pinhole coordinates
+vector< vector< Point2d > > TheCorners; //undistorted corners of TheMarkers
 void cvTackBarEvents(int pos, void *);
 bool readCameraParameters(string TheIntrinsicFile, CameraParameters &CP, Size size);
 
@@ -59,18 +61,32 @@ int waitTime = 0;
 //saves inputs form xml file
 class Settings{
 public:
-    Settings() : goodInput(false) {}
+    Settings() : goodInput(false), ControlRate(100), ControlPriority(0), CommandRate(ARDRONE_COMMAND_RATE), DriverCPU(-1), FlytoSpeed(20) {}
     bool goodInput;
     string TheIntrinsicFile;
+    string TheUndistortCache;
+    string TheMarkerMap;
     double TheMarkerSize;
     int Matwidth;
     Mat pid_matrix;
+    double ControlRate;
+    int ControlPriority;
+    double CommandRate;
+    int DriverCPU;
+    double FlytoSpeed;
     
     void read(const FileNode& node){
         node["TheIntrinsicFile"] >> TheIntrinsicFile;
+        node["TheUndistortCache"] >> TheUndistortCache;
+        node["TheMarkerMap"] >> TheMarkerMap;
         node["TheMarkerSize"] >> TheMarkerSize;
         node["Matwidth"] >> Matwidth;
         node["pid_matrix"] >> pid_matrix;
+        if (!node["ControlRate"].empty()) node["ControlRate"] >> ControlRate;
+        if (!node["ControlPriority"].empty()) node["ControlPriority"] >> ControlPriority;
+        if (!node["CommandRate"].empty()) node["CommandRate"] >> CommandRate;
+        if (!node["DriverCPU"].empty()) node["DriverCPU"] >> DriverCPU;
+        if (!node["FlytoSpeed"].empty()) node["FlytoSpeed"] >> FlytoSpeed;
         validate();
     }
     
@@ -91,6 +107,14 @@ public:
 			//log_file << "Mat width not provided" << endl;
 			goodInput = false;
 		}
+        if (ControlRate <= 0){
+			cerr << "Control rate must be positive" << endl;
+			goodInput = false;
+		}
+        if (FlytoSpeed <= 0){
+			cerr << "Flyto speed must be positive" << endl;
+			goodInput = false;
+		}
         if (pid_matrix.empty()){
 			cerr << "WARNING! No PID values where given" << endl;
 			//log_file << "WARNING! No PID values where given" << endl;
@@ -163,14 +187,34 @@ void ArucoDrone::initialize_detection(){
         if (s.TheIntrinsicFile != "") {
             TheCameraParameters.readFromXMLFile(s.TheIntrinsicFile);
             TheCameraParameters.resize(TheInputImage.size());
+
+            // the undistortion table is cached next to the calibration if no cache file is given
+            if (s.TheUndistortCache.empty()) s.TheUndistortCache = s.TheIntrinsicFile + ".lut";
+            if (!TheUndistortLUT.init(TheCameraParameters, s.TheUndistortCache))
+                cerr << "Could not build the undistortion table, positions will not be calculated" << endl;
         }
         TheMarkerSize = s.TheMarkerSize;
         Matwidth = s.Matwidth;
+        control_rate = s.ControlRate;
+        control_priority = s.ControlPriority;
+        // applied by initAll() once the drone is open, the driver threads are started meanwhile
+        command_rate = s.CommandRate;
+        driver_cpu = s.DriverCPU;
+        trajectory.setSpeed(s.FlytoSpeed);
+
+        // surveyed marker positions replace the grid
+        marker_map_file = s.TheMarkerMap;
+        if (!marker_map_file.empty() && MarkerMapper::load(marker_map_file, marker_map))
+            cout << "Marker map with " << marker_map.size() << " markers loaded from " << marker_map_file << endl;
 
-    	// PID controllers for X,Y and Z direction
-    	//pid_x.set(s.pid_matrix.at<double>(0,0), s.pid_matrix.at<double>(1,0), s.pid_matrix.at<double>(2,0));
-		//pid_y.set(s.pid_matrix.at<double>(0,1), s.pid_matrix.at<double>(1,1), s.pid_matrix.at<double>(2,1));
-		//pid_z.set(s.pid_matrix.at<double>(0,2), s.pid_matrix.at<double>(1,2), s.pid_matrix.at<double>(2,2));
+    	// PID controllers for X,Y and Z direction, rows are p, i and d (written by the pidtune tool)
+    	if (s.pid_matrix.rows == 3 && s.pid_matrix.cols == 3) {
+    		Mat gains;
+    		s.pid_matrix.convertTo(gains, CV_64F);
+    		pid_x.set(gains.at<double>(0,0), gains.at<double>(1,0), gains.at<double>(2,0));
+    		pid_y.set(gains.at<double>(0,1), gains.at<double>(1,1), gains.at<double>(2,1));
+    		pid_z.set(gains.at<double>(0,2), gains.at<double>(1,2), gains.at<double>(2,2));
+    	}
         
         //Calculates the speed at which the markers are detected
 			double tick = (double)getTickCount(); // for checking the speed
@@ -198,33 +242,67 @@ void ArucoDrone::initialize_detection(){
 void ArucoDrone::detect(){
     try {
         Camera.grab();
+        double capture = timestamp();
+
         Camera.retrieve (TheInputImage);
         timediff();
 
         // Detection of markers in the image passed
         MDetector.detect(TheInputImage, TheMarkers, TheCameraParameters, TheMarkerSize);
 
-        client.gauge("markers", (float) TheMarkers.size());
-        client.gauge("detect", (float) timediff().count());
-
-        if(TheMarkers.size()>0){
-        	Point3d position, position_tmp;
-        	Mat rotation, rotation_tmp;
-        	getLocation(TheMarkers[0], TheCameraParameters, &position, &rotation, false);
-            for (unsigned int i = 1; i < TheMarkers.size(); i++) {
-            	getLocation(TheMarkers[i], TheCameraParameters, &position_tmp, &rotation_tmp ,false);
-            	position += position_tmp;
-            	rotation += rotation_tmp;
-            }
-            drone_location.x = position.x / TheMarkers.size();
-            drone_location.y = position.y / TheMarkers.size();
-            drone_location.z = position.z / TheMarkers.size() * -1;
-            rot = rotation / TheMarkers.size();
+        // attitude and altitude interpolated at capture time, the navdata after it has arrived by now,
+        // only used if the navdata is recent
+        ARDRONE_NAVDATA_SAMPLE attitude;
+        bool imu = getNavdataAt(capture, &attitude) && capture - attitude.time < 0.1 && attitude.altitude * 100 > 20 && !onGround();
+        double roll = attitude.roll, pitch = attitude.pitch, altitude = attitude.altitude * 100;
+
+        gauge("markers", (float) TheMarkers.size());
+        gauge("detect", (float) timediff().count());
+
+        if(TheMarkers.size()>0 && TheUndistortLUT.isValid()){
+        	// undistort the corners of all markers at once
+        	TheUndistortLUT.undistort(TheMarkers, TheCorners);
+
+        	// survey, the first marker seen defines the world frame of the map
+        	if (mapping) {
+        		if (!mapper.hasAnchor()) mapper.setAnchor(TheMarkers[0].id, setWorldCoords(TheMarkers[0].id));
+        		if (mapper.addFrame(TheMarkers, TheCorners)) gauge("map-markers", (float) mapper.markers());
+        	}
+
+        	// roll, pitch and altitude are known, only x, y and yaw are solved
+        	Point3d location;
+        	Mat orientation;
+        	bool reduced = imu && getLocationIMU(TheMarkers, TheCorners, roll, pitch, altitude, &location, &orientation);
+        	gauge("imu-solver", reduced ? 1 : 0);
+
+        	// full 6 DOF pose for every marker
+        	if (!reduced) {
+        		Point3d position, position_tmp;
+        		Mat rotation, rotation_tmp;
+        		getLocation(TheMarkers[0].id, TheCorners[0], &position, &rotation, false);
+        		for (unsigned int i = 1; i < TheMarkers.size(); i++) {
+        			getLocation(TheMarkers[i].id, TheCorners[i], &position_tmp, &rotation_tmp ,false);
+        			position += position_tmp;
+        			rotation += rotation_tmp;
+        		}
+        		location.x = position.x / TheMarkers.size();
+        		location.y = position.y / TheMarkers.size();
+        		location.z = position.z / TheMarkers.size() * -1;
+        		orientation = rotation / TheMarkers.size();
+        	}
+
+            // the forward axis of the drone is the negative x axis of the camera
+            double yaw = atan2(-orientation.at<double>(0,1), -orientation.at<double>(0,0));
+            estimator.correct(capture, location, yaw);
+
+            // drone_location is set from the estimator by the control thread
+            std::lock_guard<std::mutex> lock(state_mutex);
+            rot = orientation;
+            capture_time = capture;
 
             //cout << "\rDrone position: x = " << drone_location.x << "\ty = " << drone_location.y << "\tz = " << drone_location.z; // "\e[A" to go up a line
         }else{
-        	//currently only GPS data works!
-        	//get IMU data
+        	//no marker visible, the estimator keeps predicting with the navdata
         }
     } catch (std::exception &ex){
     	cout << "Exception :" << ex.what() << endl;
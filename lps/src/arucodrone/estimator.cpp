@@ -0,0 +1,237 @@
+/*
+ * estimator.cpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "estimator.h"
+#include <math.h>
+#include <algorithm>
+
+using namespace cv;
+
+// process noise per second
+static const double q_xy  = 400;	// (cm/s)^2, error of the navdata velocities
+static const double q_z   = 100;	// (cm/s)^2
+static const double q_yaw = 0.01;	// (rad/s)^2, drift of the imu yaw
+
+// measurement noise
+static const double r_xy  = 4;		// cm^2, vision position
+static const double r_z   = 9;		// cm^2, vision height
+static const double r_yaw = 0.003;	// rad^2, vision yaw
+static const double r_alt = 25;		// cm^2, ultrasonic altitude
+
+// --------------------------------------------------------------------------
+//! @brief wraps an angle to [-pi, pi]
+//! @param the angle in rad
+//! @return the wrapped angle
+// --------------------------------------------------------------------------
+static double wrap(double a){
+	return atan2(sin(a), cos(a));
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Constructor of the state estimator
+//! @return  None
+// --------------------------------------------------------------------------
+StateEstimator::StateEstimator() :
+	_initialized(false),
+	_has_imu(false),
+	_imu_yaw(0),
+	_max_age(1.0), //200 navdata samples
+	_last_vision(0),
+	_max_coast(0.5) //the navdata velocities drift without bound
+	{ }
+
+// --------------------------------------------------------------------------
+//! @brief   Destructor of the state estimator
+//! @return  None
+// --------------------------------------------------------------------------
+StateEstimator::~StateEstimator() { }
+
+// --------------------------------------------------------------------------
+//! @brief forgets the state, the next vision pose initializes the filter again
+//! @return None
+// --------------------------------------------------------------------------
+void StateEstimator::reset(){
+	std::lock_guard<std::mutex> lock(_mutex);
+	_history.clear();
+	_initialized = false;
+}
+
+// --------------------------------------------------------------------------
+//! @brief checks if the filter has been initialized by a vision pose
+//! @return true if a state is available
+// --------------------------------------------------------------------------
+bool StateEstimator::initialized(){
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _initialized;
+}
+
+// --------------------------------------------------------------------------
+//! @brief propagates the state of prev to the time of s and applies the measurements of s
+//! @param the previous sample and the sample to be calculated
+//! @return None
+// --------------------------------------------------------------------------
+void StateEstimator::step(const Sample &prev, Sample &s){
+	double dt = s.t - prev.t;
+	if(dt < 0) dt = 0;
+
+	//the body velocities are rotated into the world with the estimated yaw
+	Vec4d x = prev.x;
+	double c = cos(x[3]), sn = sin(x[3]);
+	x[0] += dt * (s.vf * c + s.vl * sn);
+	x[1] += dt * (s.vf * sn - s.vl * c);
+	x[2] += dt * s.vz;
+	x[3] = wrap(x[3] + s.dyaw);
+
+	//jacobian of the motion model, only the yaw couples the axes
+	Matx44d F = Matx44d::eye();
+	F(0,3) = dt * (-s.vf * sn + s.vl * c);
+	F(1,3) = dt * ( s.vf * c  + s.vl * sn);
+
+	Matx44d Q = Matx44d::zeros();
+	Q(0,0) = q_xy * dt;
+	Q(1,1) = q_xy * dt;
+	Q(2,2) = q_z * dt;
+	Q(3,3) = q_yaw * dt;
+
+	s.x = x;
+	s.P = F * prev.P * F.t() + Q;
+
+	//ultrasonic altitude
+	if(s.altitude > 0){
+		double S = s.P(2,2) + r_alt;
+		Vec4d K(s.P(0,2) / S, s.P(1,2) / S, s.P(2,2) / S, s.P(3,2) / S);
+		double y = s.altitude - s.x[2];
+		Matx44d IKH = Matx44d::eye();
+		for(int i = 0; i < 4; i++){
+			s.x[i] += K[i] * y;
+			IKH(i,2) -= K[i];
+		}
+		s.P = IKH * s.P;
+	}
+
+	fuse(s);
+}
+
+// --------------------------------------------------------------------------
+//! @brief applies the vision pose of a sample
+//! @param the sample
+//! @return None
+// --------------------------------------------------------------------------
+void StateEstimator::fuse(Sample &s){
+	if(!s.vision) return;
+	Matx44d R = Matx44d::zeros();
+	R(0,0) = r_xy;
+	R(1,1) = r_xy;
+	R(2,2) = r_z;
+	R(3,3) = r_yaw;
+
+	Vec4d y = s.pose - s.x;
+	y[3] = wrap(y[3]);
+	Matx44d K = s.P * (s.P + R).inv();
+	s.x += K * y;
+	s.x[3] = wrap(s.x[3]);
+	s.P = (Matx44d::eye() - K) * s.P;
+}
+
+// --------------------------------------------------------------------------
+//! @brief prediction step, called for every navdata packet
+//! @param time of the sample [s], forward, left and upward velocity [cm/s], imu yaw [rad] and ultrasonic altitude [cm]
+//! @return None
+// --------------------------------------------------------------------------
+void StateEstimator::predict(double t, double vf, double vl, double vz, double imu_yaw, double altitude){
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	//the imu yaw has an arbitrary offset, only its changes are used
+	//it is counter clockwise seen from above while the world yaw is clockwise
+	double dyaw = _has_imu ? -wrap(imu_yaw - _imu_yaw) : 0;
+	_imu_yaw = imu_yaw;
+	_has_imu = true;
+
+	if(!_initialized) return;
+
+	Sample s;
+	s.t = std::max(t, _history.back().t);
+	s.vf = vf;
+	s.vl = vl;
+	s.vz = vz;
+	s.dyaw = dyaw;
+	s.altitude = altitude;
+	s.vision = false;
+	step(_history.back(), s);
+	_history.push_back(s);
+
+	while(_history.size() > 1 && _history.front().t < s.t - _max_age)
+		_history.pop_front();
+}
+
+// --------------------------------------------------------------------------
+//! @brief correction step with a vision pose, poses older than the newest navdata are inserted and the following samples replayed
+//! @param capture time of the frame [s], position [cm] and yaw [rad] calculated from the markers
+//! @return None
+// --------------------------------------------------------------------------
+void StateEstimator::correct(double t, const Point3d &position, double yaw){
+	std::lock_guard<std::mutex> lock(_mutex);
+	Sample s;
+	s.t = t;
+	s.dyaw = 0;
+	s.altitude = -1;
+	s.vision = true;
+	s.pose = Vec4d(position.x, position.y, position.z, yaw);
+
+	//the first pose initializes the filter
+	if(!_initialized){
+		s.vf = s.vl = s.vz = 0;
+		s.x = s.pose;
+		s.P = Matx44d::zeros();
+		s.P(0,0) = r_xy;
+		s.P(1,1) = r_xy;
+		s.P(2,2) = r_z;
+		s.P(3,3) = r_yaw;
+		_history.clear();
+		_history.push_back(s);
+		_initialized = true;
+		_last_vision = t;
+		return;
+	}
+
+	//too old, the navdata it would have to be inserted before is gone
+	if(t < _history.front().t) return;
+	_last_vision = std::max(_last_vision, t);
+
+	//find the first sample after the capture time
+	size_t i = _history.size();
+	while(i > 0 && _history[i-1].t > t) i--;
+
+	//the velocities hold until the next navdata sample
+	s.vf = _history[i-1].vf;
+	s.vl = _history[i-1].vl;
+	s.vz = _history[i-1].vz;
+	_history.insert(_history.begin() + i, s);
+
+	//replay everything from the inserted pose on
+	for(size_t k = i; k < _history.size(); k++)
+		step(_history[k-1], _history[k]);
+}
+
+// --------------------------------------------------------------------------
+//! @brief returns the latest estimate
+//! @param pointers to which the position [cm], yaw [rad], world velocity [cm/s] and the time of the estimate [s] are written
+//! @return false if the filter is not initialized yet or has only been predicted with the navdata for too long
+// --------------------------------------------------------------------------
+bool StateEstimator::getState(Point3d *position, double *yaw, Point3d *velocity, double *t){
+	std::lock_guard<std::mutex> lock(_mutex);
+	if(!_initialized) return false;
+	const Sample &s = _history.back();
+	if(s.t - _last_vision > _max_coast) return false;
+	if(position) *position = Point3d(s.x[0], s.x[1], s.x[2]);
+	if(yaw) *yaw = s.x[3];
+	if(velocity){
+		double c = cos(s.x[3]), sn = sin(s.x[3]);
+		*velocity = Point3d(s.vf * c + s.vl * sn, s.vf * sn - s.vl * c, s.vz);
+	}
+	if(t) *t = s.t;
+	return true;
+}
@@ -0,0 +1,52 @@
+/*
+ * estimator.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef ESTIMATOR_H_
+#define ESTIMATOR_H_
+
+#include <opencv2/core/core.hpp>
+#include <deque>
+#include <mutex>
+
+// extended Kalman filter for the state [x, y, z, yaw] in world coordinates (cm, rad)
+// predicted with the navdata at navdata rate and corrected with the vision poses
+class StateEstimator {
+public:
+	StateEstimator();
+	virtual ~StateEstimator();
+	void predict(double t, double vf, double vl, double vz, double imu_yaw, double altitude);
+	void correct(double t, const cv::Point3d &position, double yaw);
+	bool getState(cv::Point3d *position, double *yaw = NULL, cv::Point3d *velocity = NULL, double *t = NULL);
+	bool initialized();
+	void reset();
+
+private:
+	// one navdata step, kept so that late vision poses can be inserted and the steps replayed
+	struct Sample {
+		double t; 				// -  time of the navdata sample in seconds
+		double vf, vl, vz; 		// -  body velocities (forward, left, up) in cm/s
+		double dyaw; 			// -  change of yaw since the previous sample
+		double altitude; 		// -  ultrasonic altitude in cm, <= 0 if not available
+		bool vision; 			// -  a vision pose was fused at this sample
+		cv::Vec4d pose; 		// -  the vision pose [x, y, z, yaw]
+		cv::Vec4d x; 			// -  state after this sample
+		cv::Matx44d P; 			// -  covariance after this sample
+	};
+
+	std::deque<Sample> _history;
+	std::mutex _mutex;
+	bool _initialized;
+	bool _has_imu;
+	double _imu_yaw; 			// -  imu yaw of the previous navdata sample
+	double _max_age; 			// -  how far back vision poses are accepted in seconds
+	double _last_vision; 		// -  capture time of the newest vision pose in seconds
+	double _max_coast; 			// -  how long the state is given out without a vision pose in seconds
+
+	void step(const Sample &prev, Sample &s);
+	void fuse(Sample &s);
+};
+
+#endif /* ESTIMATOR_H_ */
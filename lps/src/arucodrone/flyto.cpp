@@ -23,18 +23,27 @@ double ArucoDrone::distancetofly(Point3d point){
 
 
 // --------------------------------------------------------------------------
-//! @brief calculate vector to point
+//! @brief calculate vector to point from the position predicted for the time the command takes effect
 //! @param a point in the realworld
 //! @return a vector that points to the point
 // --------------------------------------------------------------------------
 Point3d ArucoDrone::vectortofly(Point3d point){
-	Point3d vec((drone_location.x - point.x), (drone_location.y - point.y), (drone_location.z - point.z));
+	Point3d vec((predicted_location.x - point.x), (predicted_location.y - point.y), (predicted_location.z - point.z));
+	//cout << "flying to point: " << point << " from location: " << drone_location << endl;
+	return rotatetodrone(vec);
+}
+
+// --------------------------------------------------------------------------
+//! @brief rotates a vector from world coordinates into the coordinates of the drone
+//! @param a vector in the realworld
+//! @return the vector as seen by the drone
+// --------------------------------------------------------------------------
+Point3d ArucoDrone::rotatetodrone(Point3d vec){
 	Mat_<double> mat(3,1);
 	mat(0,0) = vec.x;
 	mat(1,0) = vec.y;
 	mat(2,0) = vec.z;
 	if(!rot.empty())mat = camerarot * (rot * mat); // must also calculate rotation of camera, this value is fixed
-	//cout << "flying to point: " << point << " with vector: " << mat << " from location: " << drone_location << endl;
 	return Point3d(mat);
 }
 
@@ -58,26 +67,32 @@ double ArucoDrone::getspeed(int x){
 
 // --------------------------------------------------------------------------
 //! @brief sets the speeds to fly to a point
-//! @param a point to which to fly
+//! @param a point to which to fly, the time since the last control step in seconds and the velocity of the point [cm/s]
 //! @return  None
 // --------------------------------------------------------------------------
-void ArucoDrone::flytocoords(Point3d point){
-	flyto(vectortofly(point));
+void ArucoDrone::flytocoords(Point3d point, double dt, Point3d velocity){
+	flyto(vectortofly(point), dt);
+	//the position error is location - point, so moving with the point is the negative direction
+	Point3d ff = rotatetodrone(velocity) * -feedforward;
+	speed.x += ff.x;
+	speed.y += ff.y;
+	speed.z += ff.z;
+	if(estimator.initialized()) speed_time = state_time;
 }
 
 
 // --------------------------------------------------------------------------
 //! @brief sets the speeds to fly along a vector
-//! @param a vector that should be flown
+//! @param a vector that should be flown and the time since the last control step in seconds
 //! @return  None
 // --------------------------------------------------------------------------
-void ArucoDrone::flyto(Point3d vector){
-	speed.x = pid_x.refresh((double) vector.x);
-	client.gauge("pid_x-error", (float) vector.x);
-	speed.y = pid_y.refresh((double) vector.y);
-	client.gauge("pid_y-error", (float) vector.y);
-	speed.z = pid_z.refresh((double) vector.z);
-	client.gauge("pid_z-error", (float) vector.z);
+void ArucoDrone::flyto(Point3d vector, double dt){
+	speed.x = pid_x.refresh((double) vector.x, dt);
+	gauge("pid_x-error", (float) vector.x);
+	speed.y = pid_y.refresh((double) vector.y, dt);
+	gauge("pid_y-error", (float) vector.y);
+	speed.z = pid_z.refresh((double) vector.z, dt);
+	gauge("pid_z-error", (float) vector.z);
 
 
 
@@ -20,10 +20,8 @@ using namespace cv;
 //! @return  2D coordinates of the location of the Marker on the Mat
 // --------------------------------------------------------------------------
 Point2d ArucoDrone::getWorldCoordsfromID(int id){
-    int x = (id-1)%Matwidth;
-    int y = (id-1)/Matwidth;
-    Point2d pos(x*16, y*16);
-    return pos;
+    Point3d topleft = MarkerMapper::gridCorners(id, Matwidth, 0)[0];
+    return Point2d(topleft.x, topleft.y);
 }
 
 // --------------------------------------------------------------------------
@@ -66,19 +64,14 @@ vector<Point3d> ArucoDrone::setWorldCoords(Point3d top_left, Point3d top_right,
 
 
 // --------------------------------------------------------------------------
-//! @brief sets the world coordinates of a marker according to its id
+//! @brief sets the world coordinates of a marker from the marker map or else according to its id
 //! @param the id of the aruco marker
-//! @return  a vector of the 3D coordinates of the marker corners with z = 0
+//! @return  a vector of the 3D coordinates of the marker corners (z = 0 on the grid)
 // --------------------------------------------------------------------------
 vector<Point3d> ArucoDrone::setWorldCoords(int id){
-    vector<Point3d> world_coords;
-    Point2d topleft = getWorldCoordsfromID(id);
-    double size = TheMarkerSize;
-    world_coords.push_back (Point3d(topleft.x, topleft.y, 0));
-    world_coords.push_back (Point3d(topleft.x+size, topleft.y, 0));
-    world_coords.push_back (Point3d (topleft.x+size, topleft.y+size, 0));
-    world_coords.push_back (Point3d(topleft.x, topleft.y+size, 0));
-    return world_coords;
+    std::map<int, vector<Point3d> >::const_iterator surveyed = marker_map.find(id);
+    if (surveyed != marker_map.end()) return surveyed->second;
+    return MarkerMapper::gridCorners(id, Matwidth, TheMarkerSize);
 }
 
 // --------------------------------------------------------------------------
@@ -87,7 +80,7 @@ vector<Point3d> ArucoDrone::setWorldCoords(int id){
 //! @return the distance of the marker to the drone (in cm)
 // --------------------------------------------------------------------------
 double ArucoDrone::distance(int id){
-    Point3d marker = convertCoords(getWorldCoordsfromID(id));
+    Point3d marker = setWorldCoords(id)[0];
     return sqrt(pow(marker.x - drone_location.x, 2) + pow(marker.y - drone_location.y, 2) + pow(marker.z - drone_location.z, 2));
 }
 
@@ -0,0 +1,561 @@
+/*
+ * markermap.cpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "markermap.h"
+#include <opencv2/calib3d/calib3d.hpp>
+#include <iostream>
+#include <algorithm>
+#include <math.h>
+
+using namespace cv;
+
+typedef Matx<double, 2, 6> Matx26d;
+
+// --------------------------------------------------------------------------
+//! @brief cross product matrix of a vector
+//! @param the vector
+//! @return the matrix [v]x
+// --------------------------------------------------------------------------
+static Matx33d skew(const Vec3d &v){
+	return Matx33d(0, -v[2], v[1], v[2], 0, -v[0], -v[1], v[0], 0);
+}
+
+// --------------------------------------------------------------------------
+//! @brief rotation matrix of a rotation vector (exponential map)
+//! @param the rotation vector
+//! @return the rotation matrix
+// --------------------------------------------------------------------------
+static Matx33d rotation(const Vec3d &w){
+	double theta = sqrt(w.dot(w));
+	Matx33d K = skew(w);
+	if(theta < 1e-12) return Matx33d::eye() + K;
+	return Matx33d::eye() + K * (sin(theta) / theta) + K * K * ((1 - cos(theta)) / (theta * theta));
+}
+
+// --------------------------------------------------------------------------
+//! @brief jacobian of a projection with respect to a rotation and a translation
+//! @param the jacobian of the projection and the jacobians of the point with respect to the rotation and the translation
+//! @return the 2x6 jacobian
+// --------------------------------------------------------------------------
+static Matx26d jacobian(const Matx23d &P, const Matx33d &A, const Matx33d &B){
+	Matx23d PA = P * A, PB = P * B;
+	Matx26d J;
+	for(int i = 0; i < 2; i++){
+		for(int j = 0; j < 3; j++){
+			J(i,j) = PA(i,j);
+			J(i,j+3) = PB(i,j);
+		}
+	}
+	return J;
+}
+
+// --------------------------------------------------------------------------
+//! @brief solves the reduced system with conjugate gradients, preconditioned with the inverse diagonal blocks
+//! @param the sparse symmetric block matrix (row -> column -> block), the right hand side and the vector the solution is written to
+//! @return None
+// --------------------------------------------------------------------------
+static void pcg(const std::vector< std::map<int, Matx66d> > &S, const std::vector<Vec6d> &g, std::vector<Vec6d> &x){
+	size_t n = S.size();
+	x.assign(n, Vec6d());
+	if(n == 0) return;
+
+	std::vector<Matx66d> M(n);
+	for(size_t i = 0; i < n; i++) M[i] = S[i].find(i)->second.inv(DECOMP_CHOLESKY);
+
+	std::vector<Vec6d> r(g), z(n), p(n), Ap(n);
+	double rz = 0, rr0 = 0;
+	for(size_t i = 0; i < n; i++){
+		z[i] = M[i] * r[i];
+		p[i] = z[i];
+		rz += r[i].dot(z[i]);
+		rr0 += r[i].dot(r[i]);
+	}
+	if(rr0 == 0) return;
+
+	for(size_t it = 0; it < 6 * n; it++){
+		double pAp = 0;
+		for(size_t i = 0; i < n; i++){
+			Ap[i] = Vec6d();
+			for(std::map<int, Matx66d>::const_iterator b = S[i].begin(); b != S[i].end(); ++b)
+				Ap[i] += b->second * p[b->first];
+			pAp += p[i].dot(Ap[i]);
+		}
+		if(pAp <= 0) break;
+
+		double alpha = rz / pAp, rr = 0;
+		for(size_t i = 0; i < n; i++){
+			x[i] += alpha * p[i];
+			r[i] -= alpha * Ap[i];
+			rr += r[i].dot(r[i]);
+		}
+		if(rr < 1e-12 * rr0) break;
+
+		double rz_new = 0;
+		for(size_t i = 0; i < n; i++){
+			z[i] = M[i] * r[i];
+			rz_new += r[i].dot(z[i]);
+		}
+		double beta = rz_new / rz;
+		rz = rz_new;
+		for(size_t i = 0; i < n; i++) p[i] = z[i] + beta * p[i];
+	}
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Constructor of the marker mapper
+//! @return  None
+// --------------------------------------------------------------------------
+MarkerMapper::MarkerMapper() :
+	_anchor(-1),
+	_size(0),
+	_window(10),
+	_baseline(10),
+	_huber(0.005) //about 2 pixels
+	{ }
+
+// --------------------------------------------------------------------------
+//! @brief   Destructor of the marker mapper
+//! @return  None
+// --------------------------------------------------------------------------
+MarkerMapper::~MarkerMapper() { }
+
+// --------------------------------------------------------------------------
+//! @brief forgets the map and the anchor
+//! @return None
+// --------------------------------------------------------------------------
+void MarkerMapper::clear(){
+	std::lock_guard<std::mutex> lock(_mutex);
+	_frames.clear();
+	_markers.clear();
+	_ids.clear();
+	_index.clear();
+	_observations.clear();
+	_frame_observations.clear();
+	_anchor = -1;
+}
+
+// --------------------------------------------------------------------------
+//! @brief starts a new map, the anchor marker is fixed at the given corners
+//! @param the id of the anchor and the world coordinates of its corners (same order as ArucoDrone::setWorldCoords)
+//! @return None
+// --------------------------------------------------------------------------
+void MarkerMapper::setAnchor(int id, const std::vector<Point3d> &corners){
+	clear();
+	if(corners.size() < 4) return;
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	Vec3d c0(corners[0]), x(Vec3d(corners[1]) - c0), y(Vec3d(corners[3]) - c0);
+	_size = sqrt(x.dot(x));
+	x = x * (1 / _size);
+	Vec3d z = x.cross(y);
+	z = z * (1 / sqrt(z.dot(z)));
+	y = z.cross(x);
+
+	Pose anchor;
+	anchor.R = Matx33d(x[0], y[0], z[0], x[1], y[1], z[1], x[2], y[2], z[2]);
+	anchor.t = c0;
+	_anchor = 0;
+	_markers.push_back(anchor);
+	_ids.push_back(id);
+	_index[id] = 0;
+}
+
+// --------------------------------------------------------------------------
+//! @brief checks if a map has been started
+//! @return true if the anchor is set
+// --------------------------------------------------------------------------
+bool MarkerMapper::hasAnchor(){
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _anchor >= 0;
+}
+
+// --------------------------------------------------------------------------
+//! @brief number of markers in the map
+//! @return the number of markers
+// --------------------------------------------------------------------------
+int MarkerMapper::markers(){
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _markers.size();
+}
+
+// --------------------------------------------------------------------------
+//! @brief number of keyframes in the map
+//! @return the number of keyframes
+// --------------------------------------------------------------------------
+int MarkerMapper::keyframes(){
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _frames.size();
+}
+
+// --------------------------------------------------------------------------
+//! @brief coordinates of a corner in the marker frame
+//! @param the corner (0 = top left, clockwise)
+//! @return the coordinates in cm
+// --------------------------------------------------------------------------
+Vec3d MarkerMapper::corner(int c) const{
+	switch(c){
+	case 1:
+		return Vec3d(_size, 0, 0);
+	case 2:
+		return Vec3d(_size, _size, 0);
+	case 3:
+		return Vec3d(0, _size, 0);
+	}
+	return Vec3d(0, 0, 0);
+}
+
+// --------------------------------------------------------------------------
+//! @brief reprojection error of a corner
+//! @param the observation, the corner and the vector to which the residual is written
+//! @return false if the corner is behind the camera
+// --------------------------------------------------------------------------
+bool MarkerMapper::residual(const Observation &o, int c, Vec2d *r) const{
+	const Pose &F = _frames[o.frame], &M = _markers[o.marker];
+	Vec3d X = F.R * (M.R * corner(c) + M.t) + F.t;
+	if(X[2] < 1e-6) return false;
+	*r = Vec2d(X[0] / X[2] - o.corners[c][0], X[1] / X[2] - o.corners[c][1]);
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//! @brief huber weight of a residual
+//! @param the residual
+//! @return the weight
+// --------------------------------------------------------------------------
+double MarkerMapper::weight(const Vec2d &r) const{
+	double n = sqrt(r.dot(r));
+	return n <= _huber ? 1 : _huber / n;
+}
+
+// --------------------------------------------------------------------------
+//! @brief robust cost of a set of observations
+//! @param the indices of the observations
+//! @return the cost
+// --------------------------------------------------------------------------
+double MarkerMapper::cost(const std::vector<int> &observations) const{
+	double sum = 0;
+	for(size_t i = 0; i < observations.size(); i++){
+		for(int c = 0; c < 4; c++){
+			Vec2d r;
+			if(!residual(_observations[observations[i]], c, &r)){
+				sum += 1; //far worse than any reprojection error
+				continue;
+			}
+			double n = sqrt(r.dot(r));
+			sum += n <= _huber ? n * n : 2 * _huber * n - _huber * _huber;
+		}
+	}
+	return sum;
+}
+
+// --------------------------------------------------------------------------
+//! @brief calculates the pose of the camera from the markers that are already in the map
+//! @param the markers, their undistorted corners and the pose to which the result is written
+//! @return false if no marker of the map is visible
+// --------------------------------------------------------------------------
+bool MarkerMapper::framePose(const std::vector<aruco::Marker> &markers, const std::vector< std::vector<Point2d> > &corners, Pose *pose){
+	std::vector<Point3d> world;
+	std::vector<Point2d> image;
+	for(size_t i = 0; i < markers.size(); i++){
+		std::map<int, int>::iterator it = _index.find(markers[i].id);
+		if(it == _index.end() || corners[i].size() != 4) continue;
+		const Pose &M = _markers[it->second];
+		for(int c = 0; c < 4; c++){
+			Vec3d X = M.R * corner(c) + M.t;
+			world.push_back(Point3d(X));
+			image.push_back(corners[i][c]);
+		}
+	}
+	if(world.empty()) return false;
+
+	static const Mat pinhole = Mat::eye(3, 3, CV_64F);
+	Mat rvec, tvec, R;
+	if(!solvePnP(world, image, pinhole, noArray(), rvec, tvec)) return false;
+	Rodrigues(rvec, R);
+	pose->R = Matx33d(R);
+	pose->t = Vec3d(tvec.at<double>(0), tvec.at<double>(1), tvec.at<double>(2));
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//! @brief adds a frame to the map if it is a keyframe and adjusts the newest keyframes
+//! @param the detected markers and their undistorted corners in normalised coordinates
+//! @return true if the frame was added as a keyframe
+// --------------------------------------------------------------------------
+bool MarkerMapper::addFrame(const std::vector<aruco::Marker> &markers, const std::vector< std::vector<Point2d> > &corners){
+	std::lock_guard<std::mutex> lock(_mutex);
+	if(_anchor < 0) return false;
+
+	Pose pose;
+	if(!framePose(markers, corners, &pose)) return false;
+
+	//a keyframe has to see a new marker or see several markers from a new position
+	bool unknown = false;
+	for(size_t i = 0; i < markers.size(); i++)
+		if(_index.find(markers[i].id) == _index.end()) unknown = true;
+	if(!unknown){
+		if(markers.size() < 2) return false;
+		if(!_frames.empty()){
+			const Pose &last = _frames.back();
+			Vec3d d = last.R.t() * last.t - pose.R.t() * pose.t;
+			if(sqrt(d.dot(d)) < _baseline) return false;
+		}
+	}
+
+	static const Mat pinhole = Mat::eye(3, 3, CV_64F);
+	int f = _frames.size();
+	_frames.push_back(pose);
+	_frame_observations.push_back(std::vector<int>());
+	for(size_t i = 0; i < markers.size(); i++){
+		if(corners[i].size() != 4) continue;
+		int m;
+		std::map<int, int>::iterator it = _index.find(markers[i].id);
+		if(it == _index.end()){
+			//new marker, its pose relative to the camera is moved into the world
+			std::vector<Point3d> local;
+			for(int c = 0; c < 4; c++) local.push_back(Point3d(corner(c)));
+			Mat rvec, tvec, R;
+			if(!solvePnP(local, corners[i], pinhole, noArray(), rvec, tvec)) continue;
+			Rodrigues(rvec, R);
+			Pose marker;
+			marker.R = pose.R.t() * Matx33d(R);
+			marker.t = pose.R.t() * (Vec3d(tvec.at<double>(0), tvec.at<double>(1), tvec.at<double>(2)) - pose.t);
+			m = _markers.size();
+			_markers.push_back(marker);
+			_ids.push_back(markers[i].id);
+			_index[markers[i].id] = m;
+		}
+		else m = it->second;
+
+		Observation o;
+		o.frame = f;
+		o.marker = m;
+		for(int c = 0; c < 4; c++) o.corners[c] = Vec2d(corners[i][c].x, corners[i][c].y);
+		_frame_observations[f].push_back(_observations.size());
+		_observations.push_back(o);
+	}
+
+	//local bundle adjustment, the older keyframes stay fixed
+	std::vector<int> window;
+	for(int i = std::max(0, f - _window + 1); i <= f; i++) window.push_back(i);
+	adjust(window, 5);
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//! @brief adjusts all keyframes and markers
+//! @param the maximal number of iterations
+//! @return the remaining robust cost
+// --------------------------------------------------------------------------
+double MarkerMapper::optimize(int iterations){
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::vector<int> frames;
+	for(size_t i = 0; i < _frames.size(); i++) frames.push_back(i);
+	double tick = (double)getTickCount();
+	double result = adjust(frames, iterations);
+	std::cout << "Marker map adjusted in " << 1000 * ((double)getTickCount() - tick) / getTickFrequency() << " milliseconds, "
+			<< _markers.size() << " markers, " << _frames.size() << " keyframes, cost = " << result << std::endl;
+	return result;
+}
+
+// --------------------------------------------------------------------------
+//! @brief sparse bundle adjustment (levenberg marquardt), the keyframes are eliminated with the schur complement
+//!        and the reduced marker system is solved with preconditioned conjugate gradients
+//! @param the keyframes to adjust, the markers they see are adjusted as well, and the maximal number of iterations
+//! @return the remaining robust cost
+// --------------------------------------------------------------------------
+double MarkerMapper::adjust(const std::vector<int> &frames, int iterations){
+	//slots of the adjusted keyframes and markers, -1 if fixed
+	std::vector<int> frame_slot(_frames.size(), -1), marker_slot(_markers.size(), -1);
+	int nf = 0, nm = 0;
+	for(size_t i = 0; i < frames.size(); i++) frame_slot[frames[i]] = nf++;
+	for(size_t i = 0; i < frames.size(); i++){
+		const std::vector<int> &obs = _frame_observations[frames[i]];
+		for(size_t k = 0; k < obs.size(); k++){
+			int m = _observations[obs[k]].marker;
+			if(m != _anchor && marker_slot[m] < 0) marker_slot[m] = nm++;
+		}
+	}
+
+	//every observation of an adjusted keyframe or marker
+	std::vector<int> obs;
+	for(size_t i = 0; i < _observations.size(); i++)
+		if(frame_slot[_observations[i].frame] >= 0 || marker_slot[_observations[i].marker] >= 0) obs.push_back(i);
+
+	double lambda = 1e-3;
+	double current = cost(obs);
+	for(int it = 0; it < iterations; it++){
+		//normal equations, U for the keyframes, V for the markers and W for the coupling of each observation
+		std::vector<Matx66d> U(nf), V(nm), W(obs.size());
+		std::vector<Vec6d> bf(nf), bm(nm);
+		for(size_t i = 0; i < obs.size(); i++){
+			const Observation &o = _observations[obs[i]];
+			int fs = frame_slot[o.frame], ms = marker_slot[o.marker];
+			const Pose &F = _frames[o.frame], &M = _markers[o.marker];
+			for(int c = 0; c < 4; c++){
+				Vec3d mc = M.R * corner(c);
+				Vec3d fc = F.R * (mc + M.t);
+				Vec3d X = fc + F.t;
+				if(X[2] < 1e-6) continue;
+				double iz = 1 / X[2];
+				Vec2d r(X[0] * iz - o.corners[c][0], X[1] * iz - o.corners[c][1]);
+				double w = weight(r);
+
+				//the rotations are perturbed from the left, R' = exp(d) * R
+				Matx23d P(iz, 0, -X[0] * iz * iz, 0, iz, -X[1] * iz * iz);
+				Matx26d Jf = jacobian(P, -skew(fc), Matx33d::eye());
+				Matx26d Jm = jacobian(P * F.R, -skew(mc), Matx33d::eye());
+				if(fs >= 0){
+					U[fs] += w * (Jf.t() * Jf);
+					bf[fs] -= w * (Jf.t() * r);
+				}
+				if(ms >= 0){
+					V[ms] += w * (Jm.t() * Jm);
+					bm[ms] -= w * (Jm.t() * r);
+				}
+				if(fs >= 0 && ms >= 0) W[i] += w * (Jf.t() * Jm);
+			}
+		}
+
+		for(int s = 0; s < nf; s++)
+			for(int d = 0; d < 6; d++) U[s](d,d) += lambda * U[s](d,d) + 1e-9;
+		for(int s = 0; s < nm; s++)
+			for(int d = 0; d < 6; d++) V[s](d,d) += lambda * V[s](d,d) + 1e-9;
+
+		//schur complement, the keyframes are eliminated and only the markers remain
+		std::vector<Matx66d> Uinv(nf);
+		for(int s = 0; s < nf; s++) Uinv[s] = U[s].inv(DECOMP_CHOLESKY);
+		std::vector< std::vector<int> > coupled(nf);
+		for(size_t i = 0; i < obs.size(); i++){
+			int fs = frame_slot[_observations[obs[i]].frame], ms = marker_slot[_observations[obs[i]].marker];
+			if(fs >= 0 && ms >= 0) coupled[fs].push_back(i);
+		}
+		std::vector< std::map<int, Matx66d> > S(nm);
+		std::vector<Vec6d> g(bm);
+		for(int s = 0; s < nm; s++) S[s][s] = V[s];
+		for(int s = 0; s < nf; s++){
+			for(size_t a = 0; a < coupled[s].size(); a++){
+				int ma = marker_slot[_observations[obs[coupled[s][a]]].marker];
+				Matx66d WU = W[coupled[s][a]].t() * Uinv[s];
+				g[ma] -= WU * bf[s];
+				for(size_t b = 0; b < coupled[s].size(); b++){
+					int mb = marker_slot[_observations[obs[coupled[s][b]]].marker];
+					S[ma][mb] -= WU * W[coupled[s][b]];
+				}
+			}
+		}
+
+		std::vector<Vec6d> dm;
+		pcg(S, g, dm);
+
+		//back substitution of the keyframes
+		std::vector<Vec6d> df(nf);
+		for(int s = 0; s < nf; s++){
+			Vec6d rhs = bf[s];
+			for(size_t a = 0; a < coupled[s].size(); a++)
+				rhs -= W[coupled[s][a]] * dm[marker_slot[_observations[obs[coupled[s][a]]].marker]];
+			df[s] = Uinv[s] * rhs;
+		}
+
+		//try the step, it is undone if the cost does not decrease
+		std::vector<Pose> frames_prev(_frames), markers_prev(_markers);
+		for(size_t i = 0; i < _frames.size(); i++){
+			int s = frame_slot[i];
+			if(s < 0) continue;
+			_frames[i].R = rotation(Vec3d(df[s][0], df[s][1], df[s][2])) * _frames[i].R;
+			_frames[i].t += Vec3d(df[s][3], df[s][4], df[s][5]);
+		}
+		for(size_t i = 0; i < _markers.size(); i++){
+			int s = marker_slot[i];
+			if(s < 0) continue;
+			_markers[i].R = rotation(Vec3d(dm[s][0], dm[s][1], dm[s][2])) * _markers[i].R;
+			_markers[i].t += Vec3d(dm[s][3], dm[s][4], dm[s][5]);
+		}
+
+		double updated = cost(obs);
+		if(updated < current){
+			bool converged = current - updated < 1e-6 * current;
+			current = updated;
+			lambda = std::max(lambda / 10, 1e-7);
+			if(converged) break;
+		}else{
+			_frames.swap(frames_prev);
+			_markers.swap(markers_prev);
+			lambda *= 10;
+			if(lambda > 1e4) break;
+		}
+	}
+	return current;
+}
+
+// --------------------------------------------------------------------------
+//! @brief writes the corners of every marker to a file that ArucoDrone::setWorldCoords uses instead of the grid
+//! @param the path of the file
+//! @return true if the file was written
+// --------------------------------------------------------------------------
+bool MarkerMapper::save(const std::string &file){
+	std::lock_guard<std::mutex> lock(_mutex);
+	FileStorage fs(file, FileStorage::WRITE);
+	if(!fs.isOpened()){
+		std::cerr << "MarkerMapper: could not write " << file << std::endl;
+		return false;
+	}
+	fs << "MarkerSize" << _size;
+	fs << "markers" << "[";
+	for(std::map<int, int>::iterator it = _index.begin(); it != _index.end(); ++it){
+		const Pose &M = _markers[it->second];
+		Mat corners(4, 3, CV_64F);
+		for(int c = 0; c < 4; c++){
+			Vec3d X = M.R * corner(c) + M.t;
+			for(int k = 0; k < 3; k++) corners.at<double>(c, k) = X[k];
+		}
+		fs << "{" << "id" << it->first << "corners" << corners << "}";
+	}
+	fs << "]";
+	fs.release();
+	std::cout << "Marker map with " << _index.size() << " markers written to " << file << std::endl;
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//! @brief reads a marker map written by save()
+//! @param the path of the file and the map (id -> corners) to which the markers are written
+//! @return false if the file could not be read or contains no markers
+// --------------------------------------------------------------------------
+bool MarkerMapper::load(const std::string &file, std::map<int, std::vector<Point3d> > &corners){
+	FileStorage fs(file, FileStorage::READ);
+	if(!fs.isOpened()) return false;
+	FileNode markers = fs["markers"];
+	if(markers.empty()) return false;
+	corners.clear();
+	for(FileNodeIterator it = markers.begin(); it != markers.end(); ++it){
+		int id;
+		Mat c;
+		(*it)["id"] >> id;
+		(*it)["corners"] >> c;
+		if(c.rows != 4 || c.cols != 3) continue;
+		std::vector<Point3d> &marker = corners[id];
+		marker.clear();
+		for(int k = 0; k < 4; k++) marker.push_back(Point3d(c.at<double>(k, 0), c.at<double>(k, 1), c.at<double>(k, 2)));
+	}
+	return !corners.empty();
+}
+
+// --------------------------------------------------------------------------
+//! @brief corners of a marker at its place on the printed mat, the markers are 16 cm apart and numbered row by row from 1
+//! @param the id of the marker, the number of markers in a row and the size of the markers in cm
+//! @return the world coordinates of the corners
+// --------------------------------------------------------------------------
+std::vector<Point3d> MarkerMapper::gridCorners(int id, int matwidth, double size){
+	double x = ((id - 1) % matwidth) * 16;
+	double y = ((id - 1) / matwidth) * 16;
+	std::vector<Point3d> corners;
+	corners.push_back(Point3d(x, y, 0));
+	corners.push_back(Point3d(x + size, y, 0));
+	corners.push_back(Point3d(x + size, y + size, 0));
+	corners.push_back(Point3d(x, y + size, 0));
+	return corners;
+}
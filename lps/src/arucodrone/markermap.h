@@ -0,0 +1,70 @@
+/*
+ * markermap.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef MARKERMAP_H_
+#define MARKERMAP_H_
+
+#include <opencv2/core/core.hpp>
+#include <aruco/aruco.h>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <string>
+
+// estimates the 6 DOF pose of every marker from co-visible observations (survey flight or video)
+// every keyframe is added with a local bundle adjustment, optimize() adjusts the whole map
+// the anchor marker is fixed to its known world pose and defines the world frame
+class MarkerMapper {
+public:
+	MarkerMapper();
+	virtual ~MarkerMapper();
+	void setAnchor(int id, const std::vector<cv::Point3d> &corners);
+	bool hasAnchor();
+	bool addFrame(const std::vector<aruco::Marker> &markers, const std::vector< std::vector<cv::Point2d> > &corners);
+	double optimize(int iterations = 20);
+	bool save(const std::string &file);
+	void clear();
+	int markers();
+	int keyframes();
+
+	static bool load(const std::string &file, std::map<int, std::vector<cv::Point3d> > &corners);
+	static std::vector<cv::Point3d> gridCorners(int id, int matwidth, double size);
+
+private:
+	// rigid transformation, x' = R * x + t
+	struct Pose {
+		cv::Matx33d R;
+		cv::Vec3d t;
+	};
+	// the four corners of one marker seen in one keyframe
+	struct Observation {
+		int frame; 				// -  index of the keyframe
+		int marker; 			// -  index of the marker
+		cv::Vec2d corners[4]; 	// -  normalised pinhole coordinates
+	};
+
+	std::vector<Pose> _frames; 			// -  world to camera of every keyframe
+	std::vector<Pose> _markers; 		// -  marker to world of every marker
+	std::vector<int> _ids; 				// -  aruco id of every marker
+	std::map<int, int> _index; 			// -  aruco id -> marker index
+	std::vector<Observation> _observations;
+	std::vector< std::vector<int> > _frame_observations; // -  observations of every keyframe
+	std::mutex _mutex;
+	int _anchor; 						// -  marker index of the anchor, -1 if not set
+	double _size; 						// -  side length of the markers in cm
+	int _window; 						// -  keyframes adjusted after adding a keyframe
+	double _baseline; 					// -  distance in cm the camera has to move for a new keyframe
+	double _huber; 						// -  reprojection error in normalised coordinates above which observations are down weighted
+
+	cv::Vec3d corner(int c) const;
+	bool residual(const Observation &o, int c, cv::Vec2d *r) const;
+	double weight(const cv::Vec2d &r) const;
+	bool framePose(const std::vector<aruco::Marker> &markers, const std::vector< std::vector<cv::Point2d> > &corners, Pose *pose);
+	double cost(const std::vector<int> &observations) const;
+	double adjust(const std::vector<int> &frames, int iterations);
+};
+
+#endif /* MARKERMAP_H_ */
@@ -10,9 +10,6 @@
 #include <iostream>
 
 // for readability
-using hr_clock = std::chrono::high_resolution_clock;
-using hr_time_point = hr_clock::time_point;
-using hr_duration = hr_clock::duration;
 using millisec = std::chrono::duration<double, std::milli>;
 
 // --------------------------------------------------------------------------
@@ -34,15 +31,17 @@ double PID::kd(){
 //! @brief   Constructor of the PID controller class
 //! @return  None
 // --------------------------------------------------------------------------
-PID::PID(double kp, double ki, double kd):
+PID::PID(double kp, double ki, double kd, Clock *clock):
 	_kp(kp),
 	_ki(ki),
 	_kd(kd),
 	_dt(0),
 	_max(1.0), //the maximum speed is 5
 	_min(-1.0), //the minimum speed (opposite direction)
+	_pre_error(0),
 	_integral(0), //the integral starts at 0
-	_pre_error(0)
+	_clock(clock),
+	previous(0)
 	{ }
 
 // --------------------------------------------------------------------------
@@ -57,10 +56,10 @@ PID::~PID() { }
 // --------------------------------------------------------------------------
 millisec PID::timediff(){
     // get current time
-    hr_time_point current = hr_clock::now();
+    double current = _clock->now();
 
     // get the time difference
-    millisec ms = std::chrono::duration_cast<millisec>(current - previous);
+    millisec ms((current - previous) * 1000);
 
     // store current time for next call
     previous = current;
@@ -80,10 +79,20 @@ void PID::initClock(){
 	//clock_gettime(CLOCK_REALTIME, &last);
 
 	// save time between function call
-	    previous = hr_clock::now();
+	    previous = _clock->now();
 	//prog_start = hr_clock::now();
 }
 
+// --------------------------------------------------------------------------
+//! @brief sets the clock the loop interval time is measured with
+//! @param the clock, a virtual clock makes the controller deterministic
+//! @return  None
+// --------------------------------------------------------------------------
+void PID::setClock(Clock *clock){
+	_clock = clock;
+	previous = _clock->now();
+}
+
 void PID::set(double kp, double ki, double kd){
 	_kp = kp;
 	_ki = ki;
@@ -100,7 +109,7 @@ void PID::reset(){
 }
 
 // --------------------------------------------------------------------------
-//! @brief calculates the speed according to the distance to fly
+//! @brief calculates the speed according to the distance to fly, the time since the last call is measured
 //! @param the distance to fly
 //! @return the speed from -5 (backwards) to 5 (forwards)
 // --------------------------------------------------------------------------
@@ -110,8 +119,17 @@ double PID::refresh(double error){
 		// find the duration
 		//d = hr_clock::now() - prog_start;
 
-		// cast the duration to milliseconds
-	_dt =  timediff().count();
+		// cast the duration to seconds
+	return refresh(error, timediff().count() / 1000);
+}
+
+// --------------------------------------------------------------------------
+//! @brief calculates the speed according to the distance to fly
+//! @param the distance to fly and the time since the last call in seconds
+//! @return the speed from -5 (backwards) to 5 (forwards)
+// --------------------------------------------------------------------------
+double PID::refresh(double error, double dt){
+	_dt = dt;
 	//std::cout << "dt: " << _dt << std::endl;
 //	clock_gettime(CLOCK_REALTIME, &now);
 //	clock_gettime(CLOCK_REALTIME, &gettime_now);
@@ -127,12 +145,15 @@ double PID::refresh(double error){
 	double p = error * _kp; //accounts for present values of the error.
 
 	//Integral
-	_integral = _integral + error;
+	_integral = _integral + error * _dt;
 	double i = _integral * _ki; //accounts for past values of the error.
 
 	//Derivative
-	double derivative = (error - _pre_error) / _dt;
-	double d = derivative * _kd; //accounts for possible future values of the error, based on its current rate of change.
+	double d = 0;
+	if(_dt > 0){
+		double derivative = (error - _pre_error) / _dt;
+		d = derivative * _kd; //accounts for possible future values of the error, based on its current rate of change.
+	}
 	if(std::isnan(d)){
 		std::cerr << "Error in PID::refresh, cannot except d, NaN" << std::endl;
 		d  = 0;
@@ -10,13 +10,16 @@
 
 #include <time.h>
 #include <chrono>
+#include "../ar_drone/ardrone/clock.h"
 
 class PID {
 public:
-	PID(double kp, double ki, double kd);
+	PID(double kp, double ki, double kd, Clock *clock = Clock::monotonic());
 	virtual ~PID();
 	double refresh(double error);
+	double refresh(double error, double dt);
 	void initClock();
+	void setClock(Clock *clock);
 	void set(double _kp, double _ki, double _kd);
 	double kp();
 	double ki();
@@ -26,13 +29,14 @@ private:
 	double _kp; 		// -  proportional gain
 	double _ki; 		// -  Integral gain
 	double _kd; 		// -  derivative gain
-	double _dt; 		// -  loop interval time in milliseconds
+	double _dt; 		// -  loop interval time in seconds
 	double _max; 		// - maximum value of manipulated variable
 	double _min; 		// - minimum value of manipulated variable
     double _pre_error; 	//the previous error.
     double _integral; 	//the integral error.
 
-    std::chrono::high_resolution_clock::time_point previous;
+    Clock *_clock; 		// -  source of the loop interval time
+    double previous; 	// -  time of the last call in seconds
     std::chrono::duration<double, std::milli> timediff();
 
 
@@ -0,0 +1,107 @@
+/*
+ * predictor.cpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "predictor.h"
+#include <math.h>
+#include <algorithm>
+
+using namespace cv;
+
+static const double gravity = 981; // cm/s^2
+
+// --------------------------------------------------------------------------
+//! @brief   Constructor of the latency predictor
+//! @return  None
+// --------------------------------------------------------------------------
+LatencyPredictor::LatencyPredictor() :
+	_latency(0.05), //until the first measurement
+	_alpha(0.05),
+	_link(0.01),
+	_tilt(12.0 * M_PI / 180) //as set in ARDrone::initCommand
+	{ }
+
+// --------------------------------------------------------------------------
+//! @brief   Destructor of the latency predictor
+//! @return  None
+// --------------------------------------------------------------------------
+LatencyPredictor::~LatencyPredictor() { }
+
+// --------------------------------------------------------------------------
+//! @brief records a command that was sent to the drone
+//! @param time the command was sent [s], the speeds passed to move3D and the yaw of the drone [rad]
+//! @return None
+// --------------------------------------------------------------------------
+void LatencyPredictor::command(double t, double vx, double vy, double yaw){
+	//move3D scales the speeds by 0.2 and clamps them to a full tilt
+	double pitch = std::max(-1.0, std::min(1.0, 0.2 * vx)) * _tilt;
+	double roll  = std::max(-1.0, std::min(1.0, 0.2 * vy)) * _tilt;
+	double af = gravity * tan(pitch);
+	double al = gravity * tan(roll);
+
+	Command c;
+	c.t = t;
+	c.ax = af * cos(yaw) + al * sin(yaw);
+	c.ay = af * sin(yaw) - al * cos(yaw);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_commands.push_back(c);
+	//one second is far more than any latency
+	while(_commands.size() > 1 && _commands.front().t < t - 1.0)
+		_commands.pop_front();
+}
+
+// --------------------------------------------------------------------------
+//! @brief adds a measurement of the time between capturing the frame a command was calculated from and sending the command
+//! @param the latency in seconds
+//! @return None
+// --------------------------------------------------------------------------
+void LatencyPredictor::measure(double latency){
+	if(latency < 0 || latency > 1.0) return;
+	std::lock_guard<std::mutex> lock(_mutex);
+	_latency += _alpha * (latency - _latency);
+}
+
+// --------------------------------------------------------------------------
+//! @brief returns the current latency estimate
+//! @return the latency in seconds
+// --------------------------------------------------------------------------
+double LatencyPredictor::latency(){
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _latency;
+}
+
+// --------------------------------------------------------------------------
+//! @brief predicts where the drone will be when the next command takes effect
+//! @param time of the state [s], capture time of the last frame it was corrected with [s], its position [cm] and velocity [cm/s]
+//! @return the predicted position
+// --------------------------------------------------------------------------
+Point3d LatencyPredictor::predict(double t, double capture, const Point3d &position, const Point3d &velocity){
+	std::lock_guard<std::mutex> lock(_mutex);
+	//the latency counts from the capture, the navdata has already moved the state past it
+	double end = std::max(t, capture + _latency) + _link;
+	Point3d p = position, v = velocity;
+
+	//integrate piecewise, every command acts from its arrival until the next one arrives
+	double now = t;
+	double ax = 0, ay = 0;
+	for(size_t i = 0; i <= _commands.size() && now < end; i++){
+		double until = (i < _commands.size()) ? std::min(end, _commands[i].t + _link) : end;
+		if(until > now){
+			double dt = until - now;
+			p.x += v.x * dt + 0.5 * ax * dt * dt;
+			p.y += v.y * dt + 0.5 * ay * dt * dt;
+			p.z += v.z * dt;
+			v.x += ax * dt;
+			v.y += ay * dt;
+			now = until;
+		}
+		if(i < _commands.size()){
+			ax = _commands[i].ax;
+			ay = _commands[i].ay;
+		}
+	}
+	return p;
+}
@@ -0,0 +1,37 @@
+/*
+ * predictor.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef PREDICTOR_H_
+#define PREDICTOR_H_
+
+#include <opencv2/core/core.hpp>
+#include <deque>
+#include <mutex>
+
+// forward-propagates the estimated state to the time the next command takes effect (smith predictor)
+// the commands that are already on their way are applied with a simple tilt -> acceleration model
+class LatencyPredictor {
+public:
+	LatencyPredictor();
+	virtual ~LatencyPredictor();
+	void command(double t, double vx, double vy, double yaw);
+	void measure(double latency);
+	cv::Point3d predict(double t, double capture, const cv::Point3d &position, const cv::Point3d &velocity);
+	double latency();
+private:
+	struct Command {
+		double t; 			// -  time the command was sent
+		double ax, ay; 		// -  resulting acceleration in world coordinates (cm/s^2)
+	};
+	std::deque<Command> _commands;
+	std::mutex _mutex;
+	double _latency; 		// -  measured frame capture to command latency in seconds (moving average)
+	double _alpha; 			// -  weight of a new latency measurement
+	double _link; 			// -  time from sending a command until the drone reacts in seconds
+	double _tilt; 			// -  tilt angle of a full command in rad (control:euler_angle_max)
+};
+
+#endif /* PREDICTOR_H_ */
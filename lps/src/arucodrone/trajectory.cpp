@@ -0,0 +1,108 @@
+/*
+ * trajectory.cpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "trajectory.h"
+#include <math.h>
+#include <algorithm>
+
+using namespace cv;
+
+// --------------------------------------------------------------------------
+//! @brief   Constructor of the trajectory generator
+//! @return  None
+// --------------------------------------------------------------------------
+Trajectory::Trajectory() :
+	_active(false),
+	_speed(20),
+	_min_duration(1.0)
+	{ }
+
+// --------------------------------------------------------------------------
+//! @brief   Destructor of the trajectory generator
+//! @return  None
+// --------------------------------------------------------------------------
+Trajectory::~Trajectory() { }
+
+// --------------------------------------------------------------------------
+//! @brief adds a waypoint to the end of the queue
+//! @param the waypoint in world coordinates
+//! @return None
+// --------------------------------------------------------------------------
+void Trajectory::add(const Point3d &waypoint){
+	std::lock_guard<std::mutex> lock(_mutex);
+	_waypoints.push_back(waypoint);
+}
+
+// --------------------------------------------------------------------------
+//! @brief stops the current segment and drops all waypoints
+//! @return None
+// --------------------------------------------------------------------------
+void Trajectory::clear(){
+	std::lock_guard<std::mutex> lock(_mutex);
+	_waypoints.clear();
+	_active = false;
+}
+
+// --------------------------------------------------------------------------
+//! @brief number of waypoints that have not been reached
+//! @return the number of waypoints including the one being flown to
+// --------------------------------------------------------------------------
+size_t Trajectory::pending(){
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _waypoints.size() + (_active ? 1 : 0);
+}
+
+// --------------------------------------------------------------------------
+//! @brief sets the peak speed of the following segments
+//! @param the speed in cm/s
+//! @return None
+// --------------------------------------------------------------------------
+void Trajectory::setSpeed(double speed){
+	std::lock_guard<std::mutex> lock(_mutex);
+	if(speed > 0) _speed = speed;
+}
+
+// --------------------------------------------------------------------------
+//! @brief position and velocity setpoint of a control tick
+//! @param the time [s], the position a segment starts from if none is being flown and the points to which the setpoints are written
+//! @return false if there is nothing to fly, the setpoints are not written then
+// --------------------------------------------------------------------------
+bool Trajectory::setpoint(double t, const Point3d &start, Point3d *position, Point3d *velocity){
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	//the next segment starts where the previous one ended
+	if(_active && t >= _segment.start + _segment.duration && !_waypoints.empty()){
+		_segment.from = _segment.from + _segment.delta;
+		_segment.start = t;
+		_active = false;
+	}
+	else if(!_active){
+		_segment.from = start;
+		_segment.start = t;
+	}
+
+	if(!_active && !_waypoints.empty()){
+		_segment.delta = _waypoints.front() - _segment.from;
+		_waypoints.pop_front();
+		//the peak speed of a minimum jerk segment is 1.875 * distance / duration
+		double distance = sqrt(_segment.delta.dot(_segment.delta));
+		_segment.duration = std::max(_min_duration, 1.875 * distance / _speed);
+		_active = true;
+	}
+	if(!_active) return false;
+
+	//s(u) = 10u^3 - 15u^4 + 6u^5, zero velocity and acceleration at both ends
+	double u = std::min(1.0, std::max(0.0, (t - _segment.start) / _segment.duration));
+	double u2 = u * u, u3 = u2 * u;
+	double s = u3 * (10 - 15 * u + 6 * u2);
+	double ds = 30 * u2 * (1 - 2 * u + u2) / _segment.duration;
+	*position = _segment.from + _segment.delta * s;
+	*velocity = _segment.delta * ds;
+
+	//the last segment is done once its end is returned, the caller holds it from then on
+	if(u >= 1.0 && _waypoints.empty()) _active = false;
+	return true;
+}
@@ -0,0 +1,40 @@
+/*
+ * trajectory.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef TRAJECTORY_H_
+#define TRAJECTORY_H_
+
+#include <opencv2/core/core.hpp>
+#include <deque>
+#include <mutex>
+
+// queue of waypoints flown along minimum jerk segments
+// every segment is precomputed when it starts, the setpoint of a tick is a closed form polynomial
+class Trajectory {
+public:
+	Trajectory();
+	virtual ~Trajectory();
+	void add(const cv::Point3d &waypoint);
+	void clear();
+	size_t pending();
+	bool setpoint(double t, const cv::Point3d &start, cv::Point3d *position, cv::Point3d *velocity);
+	void setSpeed(double speed);
+private:
+	struct Segment {
+		cv::Point3d from; 		// -  start of the segment
+		cv::Point3d delta; 		// -  end - start
+		double start; 			// -  time the segment started in seconds
+		double duration; 		// -  duration in seconds
+	};
+	std::deque<cv::Point3d> _waypoints;
+	std::mutex _mutex;
+	Segment _segment;
+	bool _active; 			// -  a segment is being flown
+	double _speed; 			// -  peak speed of a segment in cm/s
+	double _min_duration; 	// -  shortest segment in seconds
+};
+
+#endif /* TRAJECTORY_H_ */
@@ -0,0 +1,224 @@
+/*
+ * undistort.cpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "undistort.h"
+#include <opencv2/calib3d/calib3d.hpp>
+#include <fstream>
+#include <iostream>
+#include <string.h>
+#include <math.h>
+
+using namespace cv;
+
+static const char lut_magic[8] = {'L', 'P', 'S', 'L', 'U', 'T', '1', '\0'};
+
+struct LUTHeader {
+	char magic[8];
+	uint64_t key;
+	int32_t step;
+	int32_t cols;
+	int32_t rows;
+};
+
+// --------------------------------------------------------------------------
+//! @brief   Constructor of the undistortion lookup table
+//! @return  None
+// --------------------------------------------------------------------------
+UndistortLUT::UndistortLUT() :
+	_step(4),
+	_cols(0),
+	_rows(0),
+	_key(0),
+	_fx(0), _fy(0), _cx(0), _cy(0)
+	{
+	memset(_k, 0, sizeof(_k));
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Destructor of the undistortion lookup table
+//! @return  None
+// --------------------------------------------------------------------------
+UndistortLUT::~UndistortLUT() { }
+
+// --------------------------------------------------------------------------
+//! @brief loads the lookup table from the cache file or builds it from the calibration
+//! @param the camera parameters (already resized to the image size) and the path of the cache file
+//! @return true if the lookup table can be used
+// --------------------------------------------------------------------------
+bool UndistortLUT::init(const aruco::CameraParameters &cp, const std::string &cachefile){
+	_grid.clear();
+	if(cp.CameraMatrix.empty() || cp.CamSize.width <= 0 || cp.CamSize.height <= 0){
+		std::cerr << "UndistortLUT: no valid camera parameters" << std::endl;
+		return false;
+	}
+
+	//aruco stores the parameters as float, the grid is built in double precision
+	Mat K, D;
+	cp.CameraMatrix.convertTo(K, CV_64F);
+	if(!cp.Distorsion.empty()) cp.Distorsion.convertTo(D, CV_64F);
+	_fx = K.at<double>(0,0);
+	_fy = K.at<double>(1,1);
+	_cx = K.at<double>(0,2);
+	_cy = K.at<double>(1,2);
+	memset(_k, 0, sizeof(_k));
+	for(int i = 0; i < (int)D.total() && i < 5; i++) _k[i] = D.ptr<double>()[i];
+
+	_cols = (cp.CamSize.width - 1) / _step + 2;
+	_rows = (cp.CamSize.height - 1) / _step + 2;
+
+	//FNV-1a over everything the grid depends on
+	double params[] = {_fx, _fy, _cx, _cy, _k[0], _k[1], _k[2], _k[3], _k[4], (double)cp.CamSize.width, (double)cp.CamSize.height, (double)_step};
+	_key = 14695981039346656037ULL;
+	const unsigned char *bytes = (const unsigned char*)params;
+	for(size_t i = 0; i < sizeof(params); i++){
+		_key ^= bytes[i];
+		_key *= 1099511628211ULL;
+	}
+
+	if(!cachefile.empty() && load(cachefile)){
+		std::cout << "Undistortion table loaded from " << cachefile << std::endl;
+		return true;
+	}
+
+	double tick = (double)getTickCount();
+	build();
+	std::cout << "Undistortion table built in " << 1000 * ((double)getTickCount() - tick) / getTickFrequency() << " milliseconds" << std::endl;
+	if(!cachefile.empty() && !save(cachefile))
+		std::cerr << "UndistortLUT: could not write cache file " << cachefile << std::endl;
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//! @brief checks if the table has been built
+//! @return true if the table can be used
+// --------------------------------------------------------------------------
+bool UndistortLUT::isValid() const{
+	return !_grid.empty();
+}
+
+// --------------------------------------------------------------------------
+//! @brief applies the camera model (the same model solvePnP uses) to a normalised point
+//! @param the normalised pinhole coordinates
+//! @return the distorted pixel coordinates
+// --------------------------------------------------------------------------
+Point2d UndistortLUT::distort(double x, double y) const{
+	double r2 = x*x + y*y;
+	double radial = 1 + _k[0]*r2 + _k[1]*r2*r2 + _k[4]*r2*r2*r2;
+	double xd = x*radial + 2*_k[2]*x*y + _k[3]*(r2 + 2*x*x);
+	double yd = y*radial + _k[2]*(r2 + 2*y*y) + 2*_k[3]*x*y;
+	return Point2d(_fx*xd + _cx, _fy*yd + _cy);
+}
+
+// --------------------------------------------------------------------------
+//! @brief inverts the camera model for one pixel with Newton's method
+//! @param the distorted pixel coordinates
+//! @return the normalised pinhole coordinates
+// --------------------------------------------------------------------------
+Point2d UndistortLUT::invert(double u, double v) const{
+	const double h = 1e-7;
+	double x = (u - _cx) / _fx;
+	double y = (v - _cy) / _fy;
+	for(int i = 0; i < 20; i++){
+		Point2d p = distort(x, y);
+		double eu = p.x - u, ev = p.y - v;
+		if(eu*eu + ev*ev < 1e-12) break;
+		Point2d px = distort(x + h, y);
+		Point2d py = distort(x, y + h);
+		double a = (px.x - p.x) / h, b = (py.x - p.x) / h;
+		double c = (px.y - p.y) / h, d = (py.y - p.y) / h;
+		double det = a*d - b*c;
+		if(fabs(det) < 1e-12) break;
+		x -= ( d*eu - b*ev) / det;
+		y -= (-c*eu + a*ev) / det;
+	}
+	return Point2d(x, y);
+}
+
+// --------------------------------------------------------------------------
+//! @brief inverts the camera model for every grid node
+//! @return None
+// --------------------------------------------------------------------------
+void UndistortLUT::build(){
+	_grid.resize(_cols * _rows);
+	for(int j = 0; j < _rows; j++){
+		for(int i = 0; i < _cols; i++){
+			Point2d n = invert(i * _step, j * _step);
+			_grid[j * _cols + i] = Vec2f((float)n.x, (float)n.y);
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+//! @brief reads the grid from disk if it was built from the same calibration
+//! @param the path of the cache file
+//! @return true if the cache could be used
+// --------------------------------------------------------------------------
+bool UndistortLUT::load(const std::string &cachefile){
+	std::ifstream file(cachefile.c_str(), std::ios::binary);
+	if(!file) return false;
+	LUTHeader header;
+	if(!file.read((char*)&header, sizeof(header))) return false;
+	if(memcmp(header.magic, lut_magic, sizeof(lut_magic)) != 0 || header.key != _key
+			|| header.step != _step || header.cols != _cols || header.rows != _rows)
+		return false;
+	std::vector<Vec2f> grid(_cols * _rows);
+	if(!file.read((char*)&grid[0], grid.size() * sizeof(Vec2f))) return false;
+	_grid.swap(grid);
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//! @brief writes the grid to disk
+//! @param the path of the cache file
+//! @return true if the file was written
+// --------------------------------------------------------------------------
+bool UndistortLUT::save(const std::string &cachefile) const{
+	std::ofstream file(cachefile.c_str(), std::ios::binary | std::ios::trunc);
+	if(!file) return false;
+	LUTHeader header;
+	memcpy(header.magic, lut_magic, sizeof(lut_magic));
+	header.key = _key;
+	header.step = _step;
+	header.cols = _cols;
+	header.rows = _rows;
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)&_grid[0], _grid.size() * sizeof(Vec2f));
+	return (bool)file;
+}
+
+// --------------------------------------------------------------------------
+//! @brief converts a distorted pixel to normalised pinhole coordinates
+//! @param the pixel coordinates
+//! @return the normalised coordinates (x/z, y/z)
+// --------------------------------------------------------------------------
+Point2d UndistortLUT::undistort(const Point2f &pixel) const{
+	double gx = pixel.x / _step;
+	double gy = pixel.y / _step;
+	//points outside the image are extrapolated from the border cell
+	int i = std::min(std::max((int)floor(gx), 0), _cols - 2);
+	int j = std::min(std::max((int)floor(gy), 0), _rows - 2);
+	double a = gx - i, b = gy - j;
+	const Vec2f &n00 = _grid[j * _cols + i];
+	const Vec2f &n10 = _grid[j * _cols + i + 1];
+	const Vec2f &n01 = _grid[(j + 1) * _cols + i];
+	const Vec2f &n11 = _grid[(j + 1) * _cols + i + 1];
+	return Point2d((1-a)*(1-b)*n00[0] + a*(1-b)*n10[0] + (1-a)*b*n01[0] + a*b*n11[0],
+	               (1-a)*(1-b)*n00[1] + a*(1-b)*n10[1] + (1-a)*b*n01[1] + a*b*n11[1]);
+}
+
+// --------------------------------------------------------------------------
+//! @brief undistorts the corners of all markers of a frame in one pass
+//! @param the detected markers and the vector to which the normalised corners are written
+//! @return None
+// --------------------------------------------------------------------------
+void UndistortLUT::undistort(const std::vector<aruco::Marker> &markers, std::vector< std::vector<Point2d> > &corners) const{
+	corners.resize(markers.size());
+	for(size_t m = 0; m < markers.size(); m++){
+		corners[m].resize(markers[m].size());
+		for(size_t c = 0; c < markers[m].size(); c++)
+			corners[m][c] = undistort(markers[m][c]);
+	}
+}
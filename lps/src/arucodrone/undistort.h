@@ -0,0 +1,42 @@
+/*
+ * undistort.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef UNDISTORT_H_
+#define UNDISTORT_H_
+
+#include <aruco/aruco.h>
+#include <opencv2/core/core.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// maps distorted pixel coordinates to normalised pinhole coordinates (x/z, y/z)
+// through a grid that is sampled every _step pixels and bilinearly interpolated
+class UndistortLUT {
+public:
+	UndistortLUT();
+	virtual ~UndistortLUT();
+	bool init(const aruco::CameraParameters &cp, const std::string &cachefile);
+	bool isValid() const;
+	cv::Point2d undistort(const cv::Point2f &pixel) const;
+	void undistort(const std::vector<aruco::Marker> &markers, std::vector< std::vector<cv::Point2d> > &corners) const;
+private:
+	int _step; 					// -  distance between two grid nodes in pixels
+	int _cols; 					// -  number of grid nodes in x direction
+	int _rows; 					// -  number of grid nodes in y direction
+	uint64_t _key; 				// -  hash of the calibration the grid was built from
+	std::vector<cv::Vec2f> _grid; 	// -  normalised coordinates of every grid node
+
+	double _fx, _fy, _cx, _cy;
+	double _k[5]; 				// -  k1, k2, p1, p2, k3
+	cv::Point2d distort(double x, double y) const;
+	cv::Point2d invert(double u, double v) const;
+	void build();
+	bool load(const std::string &cachefile);
+	bool save(const std::string &cachefile) const;
+};
+
+#endif /* UNDISTORT_H_ */
@@ -0,0 +1,122 @@
+/*
+ * atbench.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  compares the AT command encoder with the printf based UDPSocket::sendf path
+ */
+
+#include <iostream>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include "../ar_drone/ardrone/atencoder.h"
+#include "../ar_drone/ardrone/clock.h"
+
+using namespace std;
+
+static volatile unsigned int sink; //keeps the compiler from dropping the work
+
+// --------------------------------------------------------------------------
+//! @brief formats like UDPSocket::sendf, without the sendto
+//! @param the buffer of 1024 bytes and the format
+//! @return the number of bytes sendf would send
+// --------------------------------------------------------------------------
+static int sendf(char *msg, const char *str, ...){
+	va_list arg;
+	va_start(arg, str);
+	vsnprintf(msg, 1024, str, arg);
+	va_end(arg);
+	return (int)strlen(msg) + 1;
+}
+
+// --------------------------------------------------------------------------
+//! @brief formats a command with the printf path
+//! @param the buffer, the type of command, the sequence number and the command values
+//! @return the size of the command
+// --------------------------------------------------------------------------
+static int printfCommand(char *msg, int type, unsigned int seq, const float *v){
+	switch(type){
+	case ARDRONE_AT_PCMD:
+		return sendf(msg, "AT*PCMD=%u,%d,%d,%d,%d,%d\r", seq, 1, *(int*)(&v[0]), *(int*)(&v[1]), *(int*)(&v[2]), *(int*)(&v[3]));
+	case ARDRONE_AT_REF:
+		return sendf(msg, "AT*REF=%u,290718208\r", seq);
+	case ARDRONE_AT_COMWDG:
+		return sendf(msg, "AT*COMWDG=%u\r", seq);
+	default:
+		return sendf(msg, "AT*CONFIG=%u,\"%s\",\"%d\"\r", seq, "control:altitude_max", 3000);
+	}
+}
+
+// --------------------------------------------------------------------------
+//! @brief formats a command with the encoder
+//! @param the encoder, the type of command, the sequence number and the command values
+//! @return the size of the command
+// --------------------------------------------------------------------------
+static int encodeCommand(ATEncoder &encoder, int type, unsigned int seq, const float *v){
+	encoder.clear();
+	switch(type){
+	case ARDRONE_AT_PCMD:
+		encoder.pcmd(seq, 1, v[0], v[1], v[2], v[3]);
+		break;
+	case ARDRONE_AT_REF:
+		encoder.ref(seq, 290718208);
+		break;
+	case ARDRONE_AT_COMWDG:
+		encoder.comwdg(seq);
+		break;
+	default:
+		encoder.config(seq, "control:altitude_max", "3000");
+		break;
+	}
+	return (int)encoder.size();
+}
+
+// --------------------------------------------------------------------------
+//! @brief checks both paths give the same bytes and times them
+//! @return 0 if the encoder matched the printf output
+// --------------------------------------------------------------------------
+int main(int argc, char **argv){
+	int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+	const int types[4] = {ARDRONE_AT_PCMD, ARDRONE_AT_REF, ARDRONE_AT_COMWDG, ARDRONE_AT_CONFIG};
+	const char *names[4] = {"PCMD", "REF", "COMWDG", "CONFIG"};
+	Clock *clock = Clock::monotonic();
+
+	char msg[1024], datagram[1024];
+	ATEncoder encoder(datagram, sizeof(datagram));
+	int result = 0;
+
+	for(int t = 0; t < 4; t++){
+		//the setpoints change every command like in flight
+		float v[4] = {-0.1f, 0.25f, 0.0f, -0.5f};
+
+		//same bytes, sendf also sends the terminating zero
+		for(unsigned int seq = 1; seq < 100000; seq = seq * 7 + 3){
+			v[0] = -0.001f * seq;
+			int n = printfCommand(msg, types[t], seq, v) - 1;
+			int m = encodeCommand(encoder, types[t], seq, v);
+			if(n != m || memcmp(msg, datagram, n) != 0){
+				cerr << names[t] << " differs: " << string(msg, n) << " / " << string(datagram, m) << endl;
+				result = 1;
+			}
+		}
+
+		double start = clock->now();
+		for(int i = 0; i < iterations; i++){
+			v[0] = 1e-6f * i;
+			sink += printfCommand(msg, types[t], i, v);
+		}
+		double printf_time = clock->now() - start;
+
+		start = clock->now();
+		for(int i = 0; i < iterations; i++){
+			v[0] = 1e-6f * i;
+			sink += encodeCommand(encoder, types[t], i, v);
+		}
+		double encoder_time = clock->now() - start;
+
+		printf("%-7s sendf %7.1f ns  encoder %6.1f ns  %5.1fx\n", names[t], 1e9 * printf_time / iterations, 1e9 * encoder_time / iterations, printf_time / encoder_time);
+	}
+	return result;
+}
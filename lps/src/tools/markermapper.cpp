@@ -0,0 +1,73 @@
+/*
+ * markermapper.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  builds a marker map from a recorded survey video
+ */
+
+#include <iostream>
+#include <stdlib.h>
+#include <aruco/aruco.h>
+#include <opencv2/highgui/highgui.hpp>
+#include "../arucodrone/markermap.h"
+#include "../arucodrone/undistort.h"
+
+using namespace std;
+using namespace cv;
+
+// --------------------------------------------------------------------------
+//! @brief detects the markers in every frame of the video and writes the adjusted map
+//! @return  0 if the map was written
+// --------------------------------------------------------------------------
+int main(int argc, char **argv){
+	if(argc < 7){
+		cerr << "usage: " << argv[0] << " <video> <camera calibration> <marker size> <mat width> <anchor id> <output file>" << endl;
+		cerr << "\tthe anchor marker keeps its grid position and must be visible in the first frames" << endl;
+		return 1;
+	}
+	double size = atof(argv[3]);
+	int matwidth = atoi(argv[4]);
+	int anchor = atoi(argv[5]);
+
+	VideoCapture video(argv[1]);
+	if(!video.isOpened()){
+		cerr << "Could not open " << argv[1] << endl;
+		return 1;
+	}
+	Mat image;
+	if(!video.read(image)){
+		cerr << "Could not read from " << argv[1] << endl;
+		return 1;
+	}
+
+	aruco::CameraParameters camera;
+	camera.readFromXMLFile(argv[2]);
+	camera.resize(image.size());
+	UndistortLUT lut;
+	if(!lut.init(camera, "")) return 1;
+
+	aruco::MarkerDetector detector;
+	MarkerMapper mapper;
+	mapper.setAnchor(anchor, MarkerMapper::gridCorners(anchor, matwidth, size));
+
+	vector<aruco::Marker> markers;
+	vector< vector<Point2d> > corners;
+	int frames = 0;
+	do{
+		detector.detect(image, markers, camera, size);
+		if(markers.empty()) continue;
+		lut.undistort(markers, corners);
+		mapper.addFrame(markers, corners);
+		if(++frames % 100 == 0)
+			cout << "\r" << frames << " frames, " << mapper.keyframes() << " keyframes, " << mapper.markers() << " markers" << flush;
+	}while(video.read(image));
+	cout << endl;
+
+	if(mapper.keyframes() == 0){
+		cerr << "Anchor marker " << anchor << " was never seen together with other markers" << endl;
+		return 1;
+	}
+	mapper.optimize(50);
+	return mapper.save(argv[6]) ? 0 : 1;
+}
@@ -0,0 +1,290 @@
+/*
+ * navbench.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  compares the indexed navdata decoder with the switch based parser it replaced
+ */
+
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "../ar_drone/ardrone/navdecoder.h"
+#include "../ar_drone/ardrone/clock.h"
+
+#ifndef MIN
+#define MIN(a, b)  ((a) > (b) ? (b) : (a))
+#endif
+
+using namespace std;
+
+static volatile unsigned int sink; //keeps the compiler from dropping the work
+
+// --------------------------------------------------------------------------
+//! @brief the parser of ARDrone::getNavdata before the decoder, including the cleared receive buffer
+//! @param the navdata to fill, the packet, its size and whether tag 27 is GPS
+//! @return None
+// --------------------------------------------------------------------------
+static void legacyParse(ARDRONE_NAVDATA &navdata, const unsigned char *packet, int size, bool gps){
+	char buf[4096] = {'\0'};
+	memcpy(buf, packet, size);
+
+	// Header
+	int index = 0;
+	memcpy((void*)&(navdata.header),         (const void*)(buf + index), 4); index += 4;
+	memcpy((void*)&(navdata.ardrone_state),  (const void*)(buf + index), 4); index += 4;
+	memcpy((void*)&(navdata.sequence),       (const void*)(buf + index), 4); index += 4;
+	memcpy((void*)&(navdata.vision_defined), (const void*)(buf + index), 4); index += 4;
+
+	// Parse navdata
+	while (index < size) {
+		// Tag and data size
+		unsigned short tmp_tag, tmp_size;
+		memcpy((void*)&tmp_tag,  (const void*)(buf + index), 2); index += 2;  // tag
+		memcpy((void*)&tmp_size, (const void*)(buf + index), 2); index += 2;  // size
+		index -= 4;
+
+		// Copy to NAVDATA structure
+	switch (tmp_tag) {
+		case ARDRONE_NAVDATA_DEMO_TAG:
+			memcpy((void*)&(navdata.demo),            (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.demo)));
+			break;
+		case ARDRONE_NAVDATA_TIME_TAG:
+			memcpy((void*)&(navdata.time),            (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.time)));
+			break;
+		case ARDRONE_NAVDATA_RAW_MEASURES_TAG:
+			memcpy((void*)&(navdata.raw_measures),    (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.raw_measures)));
+			break;
+		case ARDRONE_NAVDATA_PHYS_MEASURES_TAG:
+			memcpy((void*)&(navdata.phys_measures),   (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.phys_measures)));
+			break;
+		case ARDRONE_NAVDATA_GYROS_OFFSETS_TAG:
+			memcpy((void*)&(navdata.gyros_offsets),   (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.gyros_offsets)));
+			break;
+		case ARDRONE_NAVDATA_EULER_ANGLES_TAG:
+			memcpy((void*)&(navdata.euler_angles),    (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.euler_angles)));
+			break;
+		case ARDRONE_NAVDATA_REFERENCES_TAG:
+			memcpy((void*)&(navdata.references),      (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.references)));
+			break;
+		case ARDRONE_NAVDATA_TRIMS_TAG:
+			memcpy((void*)&(navdata.trims),           (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.trims)));
+			break;
+		case ARDRONE_NAVDATA_RC_REFERENCES_TAG:
+			memcpy((void*)&(navdata.rc_references),   (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.rc_references)));
+			break;
+		case ARDRONE_NAVDATA_PWM_TAG:
+			memcpy((void*)&(navdata.pwm),             (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.pwm)));
+			break;
+		case ARDRONE_NAVDATA_ALTITUDE_TAG:
+			memcpy((void*)&(navdata.altitude),        (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.altitude)));
+			break;
+		case ARDRONE_NAVDATA_VISION_RAW_TAG:
+			memcpy((void*)&(navdata.vision_raw),      (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.vision_raw)));
+			break;
+		case ARDRONE_NAVDATA_VISION_OF_TAG:
+			memcpy((void*)&(navdata.vision_of),       (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.vision_of)));
+			break;
+		case ARDRONE_NAVDATA_VISION_TAG:
+			memcpy((void*)&(navdata.vision),          (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.vision)));
+			break;
+		case ARDRONE_NAVDATA_VISION_PERF_TAG:
+			memcpy((void*)&(navdata.vision_perf),     (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.vision_perf)));
+			break;
+		case ARDRONE_NAVDATA_TRACKERS_SEND_TAG:
+			memcpy((void*)&(navdata.trackers_send),   (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.trackers_send)));
+			break;
+		case ARDRONE_NAVDATA_VISION_DETECT_TAG:
+			memcpy((void*)&(navdata.vision_detect),   (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.vision_detect)));
+			break;
+		case ARDRONE_NAVDATA_WATCHDOG_TAG:
+			memcpy((void*)&(navdata.watchdog),        (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.watchdog)));
+			break;
+		case ARDRONE_NAVDATA_ADC_DATA_FRAME_TAG:
+			memcpy((void*)&(navdata.adc_data_frame),  (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.adc_data_frame)));
+			break;
+		case ARDRONE_NAVDATA_VIDEO_STREAM_TAG:
+			memcpy((void*)&(navdata.video_stream),    (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.video_stream)));
+			break;
+		case ARDRONE_NAVDATA_GAME_TAG:
+			memcpy((void*)&(navdata.games),           (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.games)));
+			break;
+		case ARDRONE_NAVDATA_PRESSURE_RAW_TAG:
+			memcpy((void*)&(navdata.pressure_raw),    (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.pressure_raw)));
+			break;
+		case ARDRONE_NAVDATA_MAGNETO_TAG:
+			memcpy((void*)&(navdata.magneto),         (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.magneto)));
+			break;
+		case ARDRONE_NAVDATA_WIND_TAG:
+			memcpy((void*)&(navdata.wind),            (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.wind)));
+			break;
+		case ARDRONE_NAVDATA_KALMAN_PRESSURE_TAG:
+			memcpy((void*)&(navdata.kalman_pressure), (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.kalman_pressure)));
+			break;
+		case ARDRONE_NAVDATA_HDVIDEO_STREAM_TAG:
+			memcpy((void*)&(navdata.hdvideo_stream),  (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.hdvideo_stream)));
+			break;
+		case ARDRONE_NAVDATA_WIFI_TAG:
+			memcpy((void*)&(navdata.wifi),            (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.wifi)));
+			break;
+		case ARDRONE_NAVDATA_GPS_TAG:
+			if (gps) memcpy((void*)&(navdata.gps),        (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.gps)));
+			else                                          memcpy((void*)&(navdata.zimmu_3000), (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.zimmu_3000)));
+			break;
+		case 28:
+			break;
+		case 29:
+			break;
+		default:
+			memcpy((void*)&(navdata.cks),             (const void*)(buf + index), MIN(tmp_size, sizeof(navdata.cks)));
+			break;
+	}
+		index += tmp_size;
+	}
+}
+
+// --------------------------------------------------------------------------
+//! @brief appends an option of random bytes
+//! @param the packet, its current size, the tag and the size of the option
+//! @return the new size of the packet
+// --------------------------------------------------------------------------
+static unsigned int appendOption(unsigned char *packet, unsigned int size, unsigned short tag, unsigned short length){
+	memcpy(packet + size, &tag, 2);
+	memcpy(packet + size + 2, &length, 2);
+	for(unsigned int i = 4; i < length; i++) packet[size + i] = (unsigned char) rand();
+	return size + length;
+}
+
+// --------------------------------------------------------------------------
+//! @brief builds a packet like the drone sends with navdata_demo FALSE, the given options and the check sum
+//! @param the packet of ARDRONE_NAVDATA_SIZE bytes and the mask of the options (general:navdata_options)
+//! @return the size of the packet
+// --------------------------------------------------------------------------
+static unsigned int buildPacket(unsigned char *packet, unsigned int options){
+	ARDRONE_NAVDATA n;
+	const unsigned short sizes[ARDRONE_NAVDATA_NUM_TAGS] = {
+		sizeof(n.demo), sizeof(n.time), sizeof(n.raw_measures), sizeof(n.phys_measures), sizeof(n.gyros_offsets),
+		sizeof(n.euler_angles), sizeof(n.references), sizeof(n.trims), sizeof(n.rc_references), sizeof(n.pwm),
+		sizeof(n.altitude), sizeof(n.vision_raw), sizeof(n.vision_of), sizeof(n.vision), sizeof(n.vision_perf),
+		sizeof(n.trackers_send), sizeof(n.vision_detect), sizeof(n.watchdog), sizeof(n.adc_data_frame), sizeof(n.video_stream),
+		sizeof(n.games), sizeof(n.pressure_raw), sizeof(n.magneto), sizeof(n.wind), sizeof(n.kalman_pressure),
+		sizeof(n.hdvideo_stream), sizeof(n.wifi), sizeof(n.gps)};
+
+	unsigned int header[4] = {ARDRONE_NAVDATA_HEADER, 0x0F800CD4, 12345, 0};
+	memcpy(packet, header, sizeof(header));
+	unsigned int size = sizeof(header);
+	for(int tag = 0; tag < ARDRONE_NAVDATA_NUM_TAGS; tag++)
+		if(options & ARDRONE_NAVDATA_OPTION(tag)) size = appendOption(packet, size, tag, sizes[tag]);
+
+	unsigned int cks = navdataChecksum(packet, size);
+	size = appendOption(packet, size, ARDRONE_NAVDATA_CKS_TAG, 8);
+	memcpy(packet + size - 4, &cks, 4);
+	return size;
+}
+
+// --------------------------------------------------------------------------
+//! @brief checks the decoder against the old parser on a packet, that broken packets are dropped, and times both
+//! @param the name of the packet, the options it carries and the number of iterations
+//! @return 0 if the decoder matched the old parser
+// --------------------------------------------------------------------------
+static int bench(const char *name, unsigned int options, int iterations){
+	Clock *clock = Clock::monotonic();
+	int result = 0;
+
+	static unsigned char packet[ARDRONE_NAVDATA_SIZE];
+	static ARDRONE_NAVDATA_PACKET indexed;
+	static ARDRONE_NAVDATA legacy, decoded;
+	unsigned int size = buildPacket(packet, options);
+
+	//same values, the old parser also copied the check sum
+	memset(&legacy, 0, sizeof(legacy));
+	memset(&decoded, 0, sizeof(decoded));
+	legacyParse(legacy, packet, size, true);
+	memcpy(indexed.data, packet, size);
+	if(!navdataIndex(&indexed, size)){
+		cerr << name << ": valid packet dropped" << endl;
+		result = 1;
+	}
+	navdataDecode(&indexed, &decoded);
+	if(memcmp(&legacy, &decoded, offsetof(ARDRONE_NAVDATA, cks)) != 0){
+		cerr << name << ": decoded navdata differs" << endl;
+		result = 1;
+	}
+
+	//every flipped byte is caught, by the check sum or the option sizes
+	int missed = 0;
+	for(unsigned int i = 0; i < size; i++){
+		memcpy(indexed.data, packet, size);
+		indexed.data[i] ^= 0x10;
+		if(navdataIndex(&indexed, size)) missed++;
+	}
+	if(missed){
+		cerr << name << ": " << missed << " broken packets not dropped" << endl;
+		result = 1;
+	}
+
+	//the old parser, every option copied
+	double start = clock->now();
+	for(int i = 0; i < iterations; i++){
+		legacyParse(legacy, packet, size, true);
+		sink += legacy.sequence;
+	}
+	double legacy_time = clock->now() - start;
+
+	//index and check sum, then what lps reads: demo and altitude
+	ARDRONE_NAVDATA::NAVDATA_DEMO demo;
+	ARDRONE_NAVDATA::NAVDATA_ALTITUDE altitude;
+	start = clock->now();
+	for(int i = 0; i < iterations; i++){
+		memcpy(indexed.data, packet, size); //the socket writes the packet here
+		navdataIndex(&indexed, size);
+		navdataOption(&indexed, ARDRONE_NAVDATA_DEMO_TAG, &demo, sizeof(demo));
+		navdataOption(&indexed, ARDRONE_NAVDATA_ALTITUDE_TAG, &altitude, sizeof(altitude));
+		sink += demo.ctrl_state + altitude.altitude_vision;
+	}
+	double lazy_time = clock->now() - start;
+
+	//the check sum alone, the old parser did not verify it
+	static unsigned char copy[ARDRONE_NAVDATA_SIZE];
+	memcpy(copy, packet, size);
+	start = clock->now();
+	for(int i = 0; i < iterations; i++){
+		copy[i % (size - 8)]++; //the compiler must not keep the result
+		sink += navdataChecksum(copy, size - 8);
+	}
+	double checksum_time = clock->now() - start;
+
+	//index and check sum, then every option
+	start = clock->now();
+	for(int i = 0; i < iterations; i++){
+		memcpy(indexed.data, packet, size);
+		navdataIndex(&indexed, size);
+		navdataDecode(&indexed, &decoded);
+		sink += decoded.sequence;
+	}
+	double full_time = clock->now() - start;
+
+	int count = 0;
+	for(int tag = 0; tag < ARDRONE_NAVDATA_NUM_TAGS; tag++) if(options & ARDRONE_NAVDATA_OPTION(tag)) count++;
+	printf("%s: packet %u bytes, %d options\n", name, size, count);
+	printf("  switch parser         %7.1f ns\n", 1e9 * legacy_time / iterations);
+	printf("  index + demo/altitude %7.1f ns  %5.1fx\n", 1e9 * lazy_time / iterations, legacy_time / lazy_time);
+	printf("    of that check sum   %7.1f ns\n", 1e9 * checksum_time / iterations);
+	printf("  index + all options   %7.1f ns  %5.1fx\n", 1e9 * full_time / iterations, legacy_time / full_time);
+	return result;
+}
+
+// --------------------------------------------------------------------------
+//! @brief benchmarks every option (no subscription) and the options lps subscribes to, the driver adds the time
+//! @return 0 if the decoder matched the old parser on both packets
+// --------------------------------------------------------------------------
+int main(int argc, char **argv){
+	int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+	const unsigned int subscribed = ARDRONE_NAVDATA_OPTION(ARDRONE_NAVDATA_DEMO_TAG) |
+	                                ARDRONE_NAVDATA_OPTION(ARDRONE_NAVDATA_TIME_TAG) |
+	                                ARDRONE_NAVDATA_OPTION(ARDRONE_NAVDATA_ALTITUDE_TAG);
+	int result = bench("all options", ARDRONE_NAVDATA_ALL_OPTIONS, iterations);
+	result |= bench("demo, time and altitude", subscribed, iterations);
+	return result;
+}
@@ -0,0 +1,264 @@
+/*
+ * pidtune.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  sweeps the PID gains against a simple quadrotor model and writes the best ones into the settings
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include <stdlib.h>
+#include <math.h>
+#include "../arucodrone/pid.h"
+
+using namespace std;
+
+static const double control_dt = 0.01;		// control loop at 100 Hz
+static const double vision_period = 1.0 / 30;	// a vision pose every frame
+static const double vision_latency = 0.06;	// capture to estimate
+static const double vision_noise = 1.0;		// cm
+static const double link_delay = 0.02;		// command to motors
+static const double duration = 10;			// seconds per run
+
+// one axis of the drone, the command is a tilt (x, y) or a vertical speed (z) like in ARDrone::move3D
+struct Axis {
+	const char *name;
+	bool vertical;
+	double step[2]; 	// step sizes in cm the gains are scored on
+};
+
+struct Gains {
+	double kp, ki, kd;
+};
+
+struct Score {
+	double cost;
+	double settle; 		// -  seconds until the error stays below 5% of the step
+	double overshoot; 	// -  fraction of the step
+	double effort; 		// -  integral of the squared command
+};
+
+// --------------------------------------------------------------------------
+//! @brief simulates a step response of one axis in closed loop with the PID class
+//! @param the axis, the gains, the step in cm and the seed of the measurement noise
+//! @return the score of the run
+// --------------------------------------------------------------------------
+static Score simulate(const Axis &axis, const Gains &g, double step, unsigned int seed){
+	PID pid(g.kp, g.ki, g.kd);
+	mt19937 rng(seed);
+	normal_distribution<double> noise(0, vision_noise);
+
+	int steps = (int)(duration / control_dt);
+	int delay = (int)(link_delay / control_dt + 0.5);
+	int lag = (int)(vision_latency / control_dt + 0.5);
+	vector<double> commands(delay + 1, 0), positions(lag + 1, 0);
+
+	double pos = 0, vel = 0, measured = 0, next_frame = 0;
+	Score s = {0, 0, 0, 0};
+	for(int i = 0; i < steps; i++){
+		double t = i * control_dt;
+
+		//the estimate is the position of a frame captured vision_latency ago
+		positions[i % (lag + 1)] = pos;
+		if(t >= next_frame){
+			measured = positions[(i + 1) % (lag + 1)] + noise(rng);
+			next_frame += vision_period;
+		}
+
+		double u = pid.refresh(step - measured, control_dt);
+		commands[i % (delay + 1)] = u;
+		double applied = commands[(i + 1) % (delay + 1)];
+
+		if(axis.vertical){
+			//the drone follows the vertical speed with a first order lag, control_vz_max = 700 mm/s
+			vel += (70 * applied - vel) * control_dt / 0.3;
+		}else{
+			//move3D scales the command by 0.2 of euler_angle_max = 12 degrees, the air slows the drone down
+			double tilt = 0.2 * applied * 12.0 * M_PI / 180;
+			vel += (981 * tan(tilt) - 0.5 * vel) * control_dt;
+		}
+		pos += vel * control_dt;
+
+		double error = fabs(pos - step);
+		if(error > 0.05 * fabs(step)) s.settle = t + control_dt;
+		s.overshoot = max(s.overshoot, (pos - step) / step);
+		s.effort += u * u * control_dt;
+	}
+	//never settled
+	if(s.settle >= duration) s.settle = 2 * duration;
+	s.cost = s.settle + 10 * s.overshoot + 0.1 * s.effort;
+	return s;
+}
+
+// --------------------------------------------------------------------------
+//! @brief logarithmically spaced values, optionally starting with 0
+//! @param the smallest and largest value, the number of values and if 0 should be included
+//! @return the values
+// --------------------------------------------------------------------------
+static vector<double> logspace(double low, double high, int n, bool zero){
+	vector<double> v;
+	if(zero) v.push_back(0);
+	for(int i = 0; i < n; i++) v.push_back(low * pow(high / low, i / (double)(n - 1)));
+	return v;
+}
+
+// --------------------------------------------------------------------------
+//! @brief scores every combination of gains for an axis, one thread per core
+//! @param the axis and the number of threads
+//! @return the best gains
+// --------------------------------------------------------------------------
+static Gains sweep(const Axis &axis, int threads){
+	vector<double> kp = logspace(1e-3, 1, 40, false);
+	vector<double> ki = logspace(1e-4, 1e-1, 11, true);
+	vector<double> kd = logspace(1e-4, 1, 24, true);
+
+	vector<Gains> grid;
+	for(size_t p = 0; p < kp.size(); p++)
+		for(size_t i = 0; i < ki.size(); i++)
+			for(size_t d = 0; d < kd.size(); d++){
+				Gains g = {kp[p], ki[i], kd[d]};
+				grid.push_back(g);
+			}
+
+	vector<Score> scores(grid.size());
+	atomic<size_t> next(0);
+	vector<thread> workers;
+	for(int w = 0; w < threads; w++){
+		workers.push_back(thread([&](){
+			for(size_t k = next++; k < grid.size(); k = next++){
+				//the seed only depends on the candidate, so the result does not depend on the threads
+				Score a = simulate(axis, grid[k], axis.step[0], 2 * k + 1);
+				Score b = simulate(axis, grid[k], axis.step[1], 2 * k + 2);
+				scores[k].cost = a.cost + b.cost;
+				scores[k].settle = max(a.settle, b.settle);
+				scores[k].overshoot = max(a.overshoot, b.overshoot);
+				scores[k].effort = a.effort + b.effort;
+			}
+		}));
+	}
+	for(size_t w = 0; w < workers.size(); w++) workers[w].join();
+
+	size_t best = 0;
+	for(size_t k = 1; k < grid.size(); k++)
+		if(scores[k].cost < scores[best].cost) best = k;
+	cout << axis.name << ": " << grid.size() << " candidates, best p = " << grid[best].kp << " i = " << grid[best].ki << " d = " << grid[best].kd
+			<< " (settle " << scores[best].settle << " s, overshoot " << 100 * scores[best].overshoot << " %, effort " << scores[best].effort << ")" << endl;
+	return grid[best];
+}
+
+// --------------------------------------------------------------------------
+//! @brief replaces the pid_matrix of the settings file, the rest of the file is kept
+//! @param the path of the settings file and the gains of the x, y and z controller
+//! @return true if the file was written
+// --------------------------------------------------------------------------
+static bool writeSettings(const string &file, const Gains &x, const Gains &y, const Gains &z){
+	ifstream in(file.c_str());
+	if(!in) return false;
+	stringstream buffer;
+	buffer << in.rdbuf();
+	in.close();
+	string settings = buffer.str();
+
+	const string close = "</pid_matrix>";
+	size_t begin = settings.find("<pid_matrix");
+	size_t end = settings.find(close);
+	if(begin == string::npos || end == string::npos || end < begin) return false;
+
+	//rows are p, i and d, columns are the x, y and z controller
+	stringstream matrix;
+	matrix << "<pid_matrix type_id=\"opencv-matrix\">\n  <rows>3</rows>\n  <cols>3</cols>\n  <dt>d</dt>\n  <data>\n    "
+			<< x.kp << " " << y.kp << " " << z.kp << "\n    "
+			<< x.ki << " " << y.ki << " " << z.ki << "\n    "
+			<< x.kd << " " << y.kd << " " << z.kd << "</data>" << close;
+	settings.replace(begin, end + close.size() - begin, matrix.str());
+
+	ofstream out(file.c_str(), ios::trunc);
+	out << settings;
+	return (bool)out;
+}
+
+// --------------------------------------------------------------------------
+//! @brief checks that the settings file can be read and written and has a pid_matrix, before the sweep
+//! @param the path of the settings file
+//! @return true if writeSettings() can replace the pid_matrix
+// --------------------------------------------------------------------------
+static bool checkSettings(const string &file){
+	ifstream in(file.c_str());
+	if(!in){
+		cerr << "Could not read " << file << endl;
+		return false;
+	}
+	stringstream buffer;
+	buffer << in.rdbuf();
+	if(buffer.str().find("<pid_matrix") == string::npos || buffer.str().find("</pid_matrix>") == string::npos){
+		cerr << file << " has no pid_matrix" << endl;
+		return false;
+	}
+	//appending nothing leaves the file as it is
+	ofstream out(file.c_str(), ios::app);
+	if(!out){
+		cerr << "Could not write " << file << endl;
+		return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//! @brief prints how the tool is called
+//! @param the name of the program
+//! @return None
+// --------------------------------------------------------------------------
+static void usage(const char *program){
+	cerr << "usage: " << program << " <settings file> [threads]" << endl;
+	cerr << "\tsweeps the PID gains against a model of the drone and writes the best ones into the pid_matrix of the settings file" << endl;
+	cerr << "\tthreads defaults to the number of cores" << endl;
+}
+
+// --------------------------------------------------------------------------
+//! @brief sweeps the gains of the horizontal and the vertical axis
+//! @return  0 if the settings were written
+// --------------------------------------------------------------------------
+int main(int argc, char **argv){
+	if(argc > 1 && (string(argv[1]) == "-h" || string(argv[1]) == "--help")){
+		usage(argv[0]);
+		return 0;
+	}
+	if(argc < 2 || argc > 3 || argv[1][0] == '-'){
+		usage(argv[0]);
+		return 1;
+	}
+	int threads = (int)thread::hardware_concurrency();
+	if(argc > 2){
+		char *end;
+		threads = (int)strtol(argv[2], &end, 10);
+		if(*end != '\0' || threads <= 0){
+			cerr << "threads must be a positive number" << endl;
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if(threads <= 0) threads = 1;
+	if(!checkSettings(argv[1])) return 1;
+
+	Axis horizontal = {"x/y", false, {20, 100}};
+	Axis vertical = {"z", true, {20, 50}};
+
+	double tick = clock();
+	Gains xy = sweep(horizontal, threads);
+	Gains z = sweep(vertical, threads);
+	cout << "Sweep finished in " << (clock() - tick) / CLOCKS_PER_SEC << " s of cpu time on " << threads << " threads" << endl;
+
+	if(!writeSettings(argv[1], xy, xy, z)){
+		cerr << "Could not write the pid_matrix of " << argv[1] << endl;
+		return 1;
+	}
+	cout << "Gains written to " << argv[1] << endl;
+	return 0;
+}